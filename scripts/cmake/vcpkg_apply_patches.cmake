@@ -33,6 +33,9 @@
 
 function(vcpkg_apply_patches)
     cmake_parse_arguments(_ap "QUIET" "SOURCE_PATH" "PATCHES" ${ARGN})
+    if(_VCPKG_DOWNLOAD_MODE)
+        return()
+    endif()
 
     find_program(GIT NAMES git git.cmd)
     set(PATCHNUM 0)
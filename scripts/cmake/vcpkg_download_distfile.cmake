@@ -36,6 +36,9 @@
 ## ## Notes
 ## The helper [`vcpkg_from_github`](vcpkg_from_github.md) should be used for downloading from GitHub projects.
 ##
+## Files with a SHA512 are first looked up by hash in the asset sources given by the `VCPKG_ASSET_SOURCES` environment
+## variable, and stored to the writable ones after a verified download.
+##
 ## ## Examples
 ##
 ## * [apr](https://github.com/Microsoft/vcpkg/blob/master/ports/apr/portfile.cmake)
@@ -66,14 +69,12 @@ function(vcpkg_download_distfile VAR)
     endif()
 
     set(downloaded_file_path ${DOWNLOADS}/${vcpkg_download_distfile_FILENAME})
-    set(download_file_path_part "${DOWNLOADS}/temp/${vcpkg_download_distfile_FILENAME}")
-
-    # Works around issue #3399
-    if(IS_DIRECTORY "${DOWNLOADS}/temp")
-        file(REMOVE_RECURSE "${DOWNLOADS}/temp0")
-        file(RENAME "${DOWNLOADS}/temp" "${DOWNLOADS}/temp0")
-        file(REMOVE_RECURSE "${DOWNLOADS}/temp0")
-    endif()
+    # The partial download is named per process: with --prefetch-sources the same file may be downloaded for several
+    # triplets at once, or by a build and the prefetch for another triplet.
+    string(RANDOM LENGTH 8 download_nonce)
+    set(download_file_name_part "${vcpkg_download_distfile_FILENAME}.${TARGET_TRIPLET}.${download_nonce}.part")
+    set(download_file_path_part "${DOWNLOADS}/temp/${download_file_name_part}")
+    set(download_log_prefix "${DOWNLOADS}/download-${vcpkg_download_distfile_FILENAME}-${download_nonce}")
     file(MAKE_DIRECTORY "${DOWNLOADS}/temp")
 
     function(test_hash FILE_PATH FILE_KIND CUSTOM_ERROR_ADVICE)
@@ -97,6 +98,90 @@ function(vcpkg_download_distfile VAR)
         endif()
     endfunction()
 
+    # The asset sources come from VCPKG_ASSET_SOURCES, checked by vcpkg and passed on with explicit access, as
+    # "<files|http>,<directory or URL prefix>,<read|write|readwrite>" entries. Files are named by their SHA512.
+    function(fetch_from_asset_sources OUT_VAR)
+        set(${OUT_VAR} 0 PARENT_SCOPE)
+        foreach(source IN LISTS _VCPKG_ASSET_SOURCES)
+            string(REPLACE "," ";" fields "${source}")
+            list(GET fields 0 kind)
+            list(GET fields 1 location)
+            list(GET fields 2 access)
+            if(access STREQUAL "write")
+                continue()
+            endif()
+
+            if(kind STREQUAL "files")
+                file(TO_CMAKE_PATH "${location}" location)
+                if(NOT EXISTS "${location}/${vcpkg_download_distfile_SHA512}")
+                    continue()
+                endif()
+                execute_process(
+                    COMMAND ${CMAKE_COMMAND} -E copy "${location}/${vcpkg_download_distfile_SHA512}" "${download_file_path_part}"
+                    RESULT_VARIABLE error_code
+                )
+            else()
+                file(DOWNLOAD "${location}/${vcpkg_download_distfile_SHA512}" "${download_file_path_part}" STATUS download_status)
+                list(GET download_status 0 error_code)
+            endif()
+
+            if(EXISTS "${download_file_path_part}" AND "${error_code}" STREQUAL "0")
+                file(SHA512 "${download_file_path_part}" FILE_HASH)
+                if(FILE_HASH STREQUAL vcpkg_download_distfile_SHA512)
+                    message(STATUS "Using cached asset: ${location}/${vcpkg_download_distfile_SHA512}")
+                    set(${OUT_VAR} 1 PARENT_SCOPE)
+                    return()
+                endif()
+            endif()
+            file(REMOVE "${download_file_path_part}")
+        endforeach()
+    endfunction()
+
+    function(store_to_asset_sources FILE_PATH)
+        foreach(source IN LISTS _VCPKG_ASSET_SOURCES)
+            string(REPLACE "," ";" fields "${source}")
+            list(GET fields 0 kind)
+            list(GET fields 1 location)
+            list(GET fields 2 access)
+            if(access STREQUAL "read")
+                continue()
+            endif()
+
+            if(kind STREQUAL "files")
+                file(TO_CMAKE_PATH "${location}" location)
+                if(EXISTS "${location}/${vcpkg_download_distfile_SHA512}")
+                    continue()
+                endif()
+                # Copy under a temporary name first, so that readers never see a partial file.
+                string(RANDOM LENGTH 8 nonce)
+                set(temp_path "${location}/${vcpkg_download_distfile_SHA512}.${nonce}.tmp")
+                file(MAKE_DIRECTORY "${location}")
+                execute_process(
+                    COMMAND ${CMAKE_COMMAND} -E copy "${FILE_PATH}" "${temp_path}"
+                    RESULT_VARIABLE error_code
+                )
+                if("${error_code}" STREQUAL "0")
+                    file(RENAME "${temp_path}" "${location}/${vcpkg_download_distfile_SHA512}")
+                else()
+                    file(REMOVE "${temp_path}")
+                endif()
+            else()
+                file(UPLOAD "${FILE_PATH}" "${location}/${vcpkg_download_distfile_SHA512}" STATUS upload_status)
+                list(GET upload_status 0 error_code)
+            endif()
+
+            if(NOT "${error_code}" STREQUAL "0")
+                message(STATUS "Storing ${FILE_PATH} to ${location}/${vcpkg_download_distfile_SHA512}... Failed.")
+            endif()
+        endforeach()
+    endfunction()
+
+    # Without a SHA512 to verify against, the asset sources are neither used nor populated.
+    set(use_asset_sources 0)
+    if(_VCPKG_ASSET_SOURCES AND NOT _VCPKG_INTERNAL_NO_HASH_CHECK AND NOT vcpkg_download_distfile_SKIP_SHA512)
+        set(use_asset_sources 1)
+    endif()
+
     if(EXISTS "${downloaded_file_path}")
         message(STATUS "Using cached ${downloaded_file_path}")
         test_hash("${downloaded_file_path}" "cached file" "Please delete the file and retry if this file should be downloaded again.")
@@ -106,16 +191,22 @@ function(vcpkg_download_distfile VAR)
         endif()
 
         # Tries to download the file.
+        set(from_asset_source 0)
+        if(use_asset_sources)
+            fetch_from_asset_sources(from_asset_source)
+        endif()
         list(GET vcpkg_download_distfile_URLS 0 SAMPLE_URL)
-        if(_VCPKG_DOWNLOAD_TOOL STREQUAL "ARIA2" AND NOT SAMPLE_URL MATCHES "aria2")
+        if(from_asset_source)
+            set(download_success 1)
+        elseif(_VCPKG_DOWNLOAD_TOOL STREQUAL "ARIA2" AND NOT SAMPLE_URL MATCHES "aria2")
             vcpkg_find_acquire_program("ARIA2")
             message(STATUS "Downloading ${vcpkg_download_distfile_FILENAME}...")
             execute_process(
                 COMMAND ${ARIA2} ${vcpkg_download_distfile_URLS}
-                -o temp/${vcpkg_download_distfile_FILENAME}
-                -l download-${vcpkg_download_distfile_FILENAME}-detailed.log
-                OUTPUT_FILE download-${vcpkg_download_distfile_FILENAME}-out.log
-                ERROR_FILE download-${vcpkg_download_distfile_FILENAME}-err.log
+                -o temp/${download_file_name_part}
+                -l ${download_log_prefix}-detailed.log
+                OUTPUT_FILE ${download_log_prefix}-out.log
+                ERROR_FILE ${download_log_prefix}-err.log
                 RESULT_VARIABLE error_code
                 WORKING_DIRECTORY ${DOWNLOADS}
             )
@@ -124,16 +215,16 @@ function(vcpkg_download_distfile VAR)
                     "Downloading ${vcpkg_download_distfile_FILENAME}... Failed.\n"
                     "    Exit Code: ${error_code}\n"
                     "    See logs for more information:\n"
-                    "        ${DOWNLOADS}/download-${vcpkg_download_distfile_FILENAME}-out.log\n"
-                    "        ${DOWNLOADS}/download-${vcpkg_download_distfile_FILENAME}-err.log\n"
-                    "        ${DOWNLOADS}/download-${vcpkg_download_distfile_FILENAME}-detailed.log\n"
+                    "        ${download_log_prefix}-out.log\n"
+                    "        ${download_log_prefix}-err.log\n"
+                    "        ${download_log_prefix}-detailed.log\n"
                 )
                 set(download_success 0)
             else()
                 file(REMOVE
-                    ${DOWNLOADS}/download-${vcpkg_download_distfile_FILENAME}-out.log
-                    ${DOWNLOADS}/download-${vcpkg_download_distfile_FILENAME}-err.log
-                    ${DOWNLOADS}/download-${vcpkg_download_distfile_FILENAME}-detailed.log
+                    ${download_log_prefix}-out.log
+                    ${download_log_prefix}-err.log
+                    ${download_log_prefix}-detailed.log
                 )
                 set(download_success 1)
             endif()
@@ -153,6 +244,7 @@ function(vcpkg_download_distfile VAR)
         endif()
 
         if (NOT download_success)
+            file(REMOVE "${download_file_path_part}")
             message(FATAL_ERROR
             "    \n"
             "    Failed to download file.\n"
@@ -164,6 +256,9 @@ function(vcpkg_download_distfile VAR)
             get_filename_component(downloaded_file_dir "${downloaded_file_path}" DIRECTORY)
             file(MAKE_DIRECTORY "${downloaded_file_dir}")
             file(RENAME ${download_file_path_part} ${downloaded_file_path})
+            if(use_asset_sources AND NOT from_asset_source)
+                store_to_asset_sources("${downloaded_file_path}")
+            endif()
         endif()
     endif()
     set(${VAR} ${downloaded_file_path} PARENT_SCOPE)
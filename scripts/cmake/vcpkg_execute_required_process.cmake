@@ -8,9 +8,15 @@
 ##     COMMAND <${PERL}> [<arguments>...]
 ##     WORKING_DIRECTORY <${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-dbg>
 ##     LOGNAME <build-${TARGET_TRIPLET}-dbg>
+##     [ALLOW_IN_DOWNLOAD_MODE]
 ## )
 ## ```
 ## ## Parameters
+## ### ALLOW_IN_DOWNLOAD_MODE
+## Run the command even when vcpkg only evaluates the portfile to fetch its sources (`install --prefetch-sources`).
+##
+## Commands are otherwise skipped in that mode. Only pass this for commands that download sources.
+##
 ## ### COMMAND
 ## The command to be executed, along with its arguments.
 ##
@@ -29,7 +35,10 @@
 ## * [boost](https://github.com/Microsoft/vcpkg/blob/master/ports/boost/portfile.cmake)
 ## * [qt5](https://github.com/Microsoft/vcpkg/blob/master/ports/qt5/portfile.cmake)
 function(vcpkg_execute_required_process)
-    cmake_parse_arguments(vcpkg_execute_required_process "" "WORKING_DIRECTORY;LOGNAME" "COMMAND" ${ARGN})
+    cmake_parse_arguments(vcpkg_execute_required_process "ALLOW_IN_DOWNLOAD_MODE" "WORKING_DIRECTORY;LOGNAME" "COMMAND" ${ARGN})
+    if(_VCPKG_DOWNLOAD_MODE AND NOT vcpkg_execute_required_process_ALLOW_IN_DOWNLOAD_MODE)
+        return()
+    endif()
     set(LOG_OUT "${CURRENT_BUILDTREES_DIR}/${vcpkg_execute_required_process_LOGNAME}-out.log")
     set(LOG_ERR "${CURRENT_BUILDTREES_DIR}/${vcpkg_execute_required_process_LOGNAME}-err.log")
     execute_process(
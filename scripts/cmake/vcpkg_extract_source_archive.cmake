@@ -30,6 +30,10 @@
 include(vcpkg_execute_required_process)
 
 function(vcpkg_extract_source_archive ARCHIVE)
+    if(_VCPKG_DOWNLOAD_MODE)
+        return()
+    endif()
+
     if(NOT ARGC EQUAL 2)
         set(WORKING_DIRECTORY "${CURRENT_BUILDTREES_DIR}/src")
     else()
@@ -64,6 +68,12 @@ function(vcpkg_extract_source_archive_ex)
         set(_vesae_WORKING_DIRECTORY ${CURRENT_BUILDTREES_DIR}/src)
     endif()
 
+    # Only the archive is wanted in download mode; the rest of the portfile must not rely on the sources.
+    if(_VCPKG_DOWNLOAD_MODE)
+        set(${_vesae_OUT_SOURCE_PATH} "${_vesae_WORKING_DIRECTORY}" PARENT_SCOPE)
+        return()
+    endif()
+
     if(NOT DEFINED _vesae_REF)
         get_filename_component(_vesae_REF ${_vesae_ARCHIVE} NAME_WE)
     endif()
@@ -66,7 +66,11 @@ function(vcpkg_from_git)
   endif()
 
   string(REPLACE "/" "-" SANITIZED_REF "${_vdud_REF}")
-  set(TEMP_ARCHIVE "${DOWNLOADS}/temp/${PORT}-${SANITIZED_REF}.zip")
+  # The scratch repository and archive are named per process: with --prefetch-sources the same port may be fetched
+  # for several triplets at once, or by a build and the prefetch for another triplet.
+  string(RANDOM LENGTH 8 NONCE)
+  set(TEMP_NAME "${PORT}-${TARGET_TRIPLET}-${NONCE}")
+  set(TEMP_ARCHIVE "${DOWNLOADS}/temp/${TEMP_NAME}.zip")
   set(ARCHIVE "${DOWNLOADS}/${PORT}-${SANITIZED_REF}.zip")
   set(TEMP_SOURCE_PATH "${CURRENT_BUILDTREES_DIR}/src/${SANITIZED_REF}")
 
@@ -88,23 +92,27 @@ function(vcpkg_from_git)
     endif()
     message(STATUS "Fetching ${_vdud_URL}...")
     find_program(GIT NAMES git git.cmd)
-    # Note: git init is safe to run multiple times
+    # Each fetch has its own repository, since FETCH_HEAD would be shared by fetches running at the same time.
     vcpkg_execute_required_process(
-      COMMAND ${GIT} init git-tmp
+      COMMAND ${GIT} init git-tmp/${TEMP_NAME}
       WORKING_DIRECTORY ${DOWNLOADS}
       LOGNAME git-init
+      ALLOW_IN_DOWNLOAD_MODE
     )
     vcpkg_execute_required_process(
       COMMAND ${GIT} fetch ${_vdud_URL} ${_vdud_REF} --depth 1 -n
-      WORKING_DIRECTORY ${DOWNLOADS}/git-tmp
+      WORKING_DIRECTORY ${DOWNLOADS}/git-tmp/${TEMP_NAME}
       LOGNAME git-fetch
+      ALLOW_IN_DOWNLOAD_MODE
     )
     file(MAKE_DIRECTORY "${DOWNLOADS}/temp")
     vcpkg_execute_required_process(
       COMMAND ${GIT} archive FETCH_HEAD -o "${TEMP_ARCHIVE}"
-      WORKING_DIRECTORY ${DOWNLOADS}/git-tmp
+      WORKING_DIRECTORY ${DOWNLOADS}/git-tmp/${TEMP_NAME}
       LOGNAME git-archive
+      ALLOW_IN_DOWNLOAD_MODE
     )
+    file(REMOVE_RECURSE "${DOWNLOADS}/git-tmp/${TEMP_NAME}")
     test_hash("${TEMP_ARCHIVE}" "downloaded repo" "")
     get_filename_component(downloaded_file_dir "${ARCHIVE}" DIRECTORY)
     file(MAKE_DIRECTORY "${downloaded_file_dir}")
@@ -17,6 +17,9 @@
 ##
 function(vcpkg_test_cmake)
     cmake_parse_arguments(_tc "MODULE" "PACKAGE_NAME" "" ${ARGN})
+    if(_VCPKG_DOWNLOAD_MODE)
+        return()
+    endif()
 
     if(NOT DEFINED _tc_PACKAGE_NAME)
       message(FATAL_ERROR "PACKAGE_NAME must be specified")
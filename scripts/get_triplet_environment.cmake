@@ -1,4 +1,13 @@
+# Records every file the triplet includes, directly or not, so that vcpkg can tell when a saved capture is stale.
+macro(include)
+    _include(${ARGV} RESULT_VARIABLE _VCPKG_INCLUDED_FILE)
+    if(_VCPKG_INCLUDED_FILE)
+        set_property(GLOBAL APPEND PROPERTY VCPKG_TRIPLET_INCLUDES "${_VCPKG_INCLUDED_FILE}")
+    endif()
+endmacro()
+
 include(${CMAKE_TRIPLET_FILE})
+get_property(_VCPKG_TRIPLET_INCLUDES GLOBAL PROPERTY VCPKG_TRIPLET_INCLUDES)
 
 # GUID used as a flag - "cut here line"
 message("c35112b6-d1ba-415b-aa5d-81de856ef8eb")
@@ -9,3 +18,6 @@ message("VCPKG_PLATFORM_TOOLSET=${VCPKG_PLATFORM_TOOLSET}")
 message("VCPKG_VISUAL_STUDIO_PATH=${VCPKG_VISUAL_STUDIO_PATH}")
 message("VCPKG_CHAINLOAD_TOOLCHAIN_FILE=${VCPKG_CHAINLOAD_TOOLCHAIN_FILE}")
 message("VCPKG_BUILD_TYPE=${VCPKG_BUILD_TYPE}")
+foreach(_VCPKG_INCLUDED_FILE IN LISTS _VCPKG_TRIPLET_INCLUDES)
+    message("VCPKG_TRIPLET_INCLUDE=${_VCPKG_INCLUDED_FILE}")
+endforeach()
@@ -31,7 +31,7 @@ if(PORT)
 endif()
 
 
-if(CMD MATCHES "^BUILD$")
+if(CMD MATCHES "^(BUILD|DOWNLOAD)$")
     set(CMAKE_TRIPLET_FILE ${VCPKG_ROOT_DIR}/triplets/${TARGET_TRIPLET}.cmake)
     if(NOT EXISTS ${CMAKE_TRIPLET_FILE})
         message(FATAL_ERROR "Unsupported target triplet. Triplet file does not exist: ${CMAKE_TRIPLET_FILE}")
@@ -51,6 +51,14 @@ if(CMD MATCHES "^BUILD$")
         message(FATAL_ERROR "Port is missing control file: ${CURRENT_PORT_DIR}/CONTROL")
     endif()
 
+    if(CMD MATCHES "^DOWNLOAD$")
+        # Evaluate the portfile only for the sources it downloads: the helpers skip extracting, patching and running
+        # processes, and anything else the portfile writes goes to a scratch directory that vcpkg removes afterwards.
+        set(_VCPKG_DOWNLOAD_MODE ON)
+        set(CURRENT_BUILDTREES_DIR ${BUILDTREES_DIR}/${PORT}/download-${TARGET_TRIPLET})
+        set(CURRENT_PACKAGES_DIR ${CURRENT_BUILDTREES_DIR}/packages)
+    endif()
+
     unset(PACKAGES_DIR)
     unset(BUILDTREES_DIR)
 
@@ -69,6 +77,9 @@ if(CMD MATCHES "^BUILD$")
     include(${CMAKE_TRIPLET_FILE})
     set(TRIPLET_SYSTEM_ARCH ${VCPKG_TARGET_ARCHITECTURE})
     include(${CURRENT_PORT_DIR}/portfile.cmake)
+    if(_VCPKG_DOWNLOAD_MODE)
+        return()
+    endif()
 
     set(BUILD_INFO_FILE_PATH ${CURRENT_PACKAGES_DIR}/BUILD_INFO)
     file(WRITE  ${BUILD_INFO_FILE_PATH} "CRTLinkage: ${VCPKG_CRT_LINKAGE}\n")
@@ -24,6 +24,7 @@
 #include <cctype>
 #include <chrono>
 #include <codecvt>
+#include <condition_variable>
 #include <cstdarg>
 #include <cstddef>
 #include <cstdint>
@@ -33,6 +34,7 @@
 #include <experimental/filesystem>
 #endif
 #include <cstring>
+#include <deque>
 #include <fstream>
 #include <functional>
 #include <iomanip>
@@ -6,4 +6,20 @@
 namespace vcpkg::Archives
 {
     void extract_archive(const VcpkgPaths& paths, const fs::path& archive, const fs::path& to_path);
+
+    /// <summary>
+    /// Writes the contents of `source_dir` to a new zip archive. Files are compressed concurrently.
+    /// </summary>
+    void compress_directory_to_zip(Files::Filesystem& fs, const fs::path& source_dir, const fs::path& archive_path);
+
+    /// <summary>
+    /// Extracts a zip archive (stored or deflated entries, including zip64) into `to_path`.
+    /// Entries are decompressed concurrently.
+    /// </summary>
+    void extract_zip(Files::Filesystem& fs, const fs::path& archive_path, const fs::path& to_path);
+
+    /// <summary>
+    /// Extracts a gzip-compressed ustar/GNU/pax tarball into `to_path`.
+    /// </summary>
+    void extract_tar_gz(Files::Filesystem& fs, const fs::path& archive_path, const fs::path& to_path);
 }
@@ -8,6 +8,36 @@ namespace vcpkg::Checks
 {
     void register_console_ctrl_handler();
 
+    /// <summary>
+    /// Thrown instead of exiting the tool on a thread with a ThrowOnExit in scope.
+    /// </summary>
+    struct ExitRequested
+    {
+        int exit_code;
+    };
+
+    /// <summary>
+    /// While alive, makes the functions below throw ExitRequested on the current thread instead of exiting, so that a
+    /// worker thread can hand a failure back to the thread that owns the process rather than exit under the threads
+    /// still writing to the installed tree.
+    /// </summary>
+    struct ThrowOnExit
+    {
+        ThrowOnExit();
+        ThrowOnExit(const ThrowOnExit&) = delete;
+        ThrowOnExit& operator=(const ThrowOnExit&) = delete;
+        ~ThrowOnExit();
+
+    private:
+        bool previous;
+    };
+
+    /// <summary>
+    /// Registers a function to run, in registration order, when the tool exits through the functions below. Hooks run
+    /// before the trace, stats and metrics are flushed.
+    /// </summary>
+    void register_exit_hook(void (*hook)());
+
     // Indicate that an internal error has occurred and exit the tool. This should be used when invariants have been
     // broken.
     [[noreturn]] void unreachable(const LineInfo& line_info);
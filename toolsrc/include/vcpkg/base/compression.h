@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vcpkg/base/expected.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace vcpkg::Compression
+{
+    /// <summary>
+    /// Updates a running CRC-32 (as used by zip and gzip) with `size` bytes. Start with a crc of 0.
+    /// </summary>
+    uint32_t crc32(uint32_t crc, const unsigned char* data, size_t size) noexcept;
+
+    /// <summary>
+    /// Fills `buffer` with up to `size` bytes of input and returns the number written; 0 ends the input.
+    /// </summary>
+    using ByteSource = std::function<size_t(unsigned char* buffer, size_t size)>;
+
+    /// <summary>
+    /// Receives the next piece of output.
+    /// </summary>
+    using ByteSink = std::function<void(const unsigned char* data, size_t size)>;
+
+    /// <summary>
+    /// Compresses a buffer into a raw DEFLATE stream (RFC 1951), favoring speed over ratio.
+    /// </summary>
+    std::vector<unsigned char> deflate(const unsigned char* data, size_t size);
+
+    /// <summary>
+    /// Compresses everything `source` supplies into a raw DEFLATE stream, passed to `sink` as it is produced.
+    /// Memory use is bounded regardless of the input size.
+    /// </summary>
+    void deflate_stream(const ByteSource& source, const ByteSink& sink);
+
+    /// <summary>
+    /// Decompresses a raw DEFLATE stream (RFC 1951). `size_hint` is used to reserve the output buffer.
+    /// </summary>
+    ExpectedT<std::vector<unsigned char>, std::string> inflate(const unsigned char* data,
+                                                               size_t size,
+                                                               size_t size_hint = 0);
+
+    /// <summary>
+    /// Decompresses a raw DEFLATE stream read from `source`, passing the output to `sink` in bounded pieces.
+    /// Input after the end of the stream may be read but is ignored. Returns the decompressed size.
+    /// </summary>
+    ExpectedT<uint64_t, std::string> inflate_stream(const ByteSource& source, const ByteSink& sink);
+}
@@ -1,14 +1,104 @@
 #pragma once
 
+#include <vcpkg/base/expected.h>
 #include <vcpkg/base/files.h>
+#include <vcpkg/base/optional.h>
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace vcpkg::Downloads
 {
+    struct RemoteFileInfo
+    {
+        Optional<std::uint64_t> size;
+        bool accepts_ranges = false;
+
+        /// <summary>
+        /// Whether the response is a 206 Partial Content with a Content-Range, i.e. the answer to a range request.
+        /// </summary>
+        bool is_partial = false;
+    };
+
+    /// <summary>
+    /// Reads the size and range support of a file from the output of `curl -I -L`, which holds the headers of every
+    /// response along the redirect chain. Only the final response counts.
+    /// </summary>
+    RemoteFileInfo parse_response_headers(const std::string& headers);
+
+    /// <summary>
+    /// Splits a download of `size` bytes into the inclusive byte ranges fetched in parallel. Small files get a single
+    /// range.
+    /// </summary>
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> split_into_segments(std::uint64_t size);
+
+    /// <summary>
+    /// A content-addressed store of downloaded files, each named by its SHA512: `<dir>/<sha512>` for a directory,
+    /// `<url_prefix>/<sha512>` for an HTTP server answering GET and PUT. Downloads are looked up there before going
+    /// upstream, and verified downloads are stored back, so the store can be shared across vcpkg roots and machines.
+    /// </summary>
+    struct AssetSource
+    {
+        enum class Kind
+        {
+            FILES,
+            HTTP,
+        };
+
+        Kind kind;
+        std::string location;
+        bool can_read;
+        bool can_write;
+
+        /// <summary>
+        /// The path or URL of the file with hash `sha512`.
+        /// </summary>
+        std::string location_of(const std::string& sha512) const;
+
+        /// <summary>
+        /// Formats the source the way parse_asset_sources reads it, with the access always spelled out.
+        /// </summary>
+        std::string to_string() const;
+    };
+
+    /// <summary>
+    /// Parses a list of asset sources separated by ';'. Each source is one of:
+    ///   files,path[,access]          a directory
+    ///   http,url_prefix[,access]     an HTTP server
+    /// where access is one of read, write or readwrite, and defaults to read.
+    /// </summary>
+    ExpectedT<std::vector<AssetSource>, std::string> parse_asset_sources(const std::string& sources);
+
+    /// <summary>
+    /// Returns the asset sources configured by the VCPKG_ASSET_SOURCES environment variable, parsed on first use.
+    /// </summary>
+    const std::vector<AssetSource>& get_asset_sources();
+
+    /// <summary>
+    /// Copies the file with hash `sha512` from the first readable asset source that has it to `path`. Returns the
+    /// location it came from; a copy with the wrong contents is discarded.
+    /// </summary>
+    Optional<std::string> fetch_from_asset_sources(Files::Filesystem& fs,
+                                                   const std::string& sha512,
+                                                   const fs::path& path);
+
+    /// <summary>
+    /// Stores the verified file at `path` in every writable asset source that does not have it yet.
+    /// </summary>
+    void store_to_asset_sources(Files::Filesystem& fs, const std::string& sha512, const fs::path& path);
+
     void verify_downloaded_file_hash(const Files::Filesystem& fs,
                                      const std::string& url,
                                      const fs::path& path,
                                      const std::string& sha512);
 
+    /// <summary>
+    /// Downloads `url` to `download_path` and checks its SHA512, trying the asset sources first. Outside Windows, the
+    /// data is hashed as it is written, an interrupted download resumes from the `.part` file it left behind, and
+    /// large files are fetched in parallel byte ranges when the server supports them.
+    /// </summary>
     void download_file(Files::Filesystem& fs,
                        const std::string& url,
                        const fs::path& download_path,
@@ -25,6 +25,23 @@ namespace fs
 
 namespace vcpkg::Files
 {
+    /// <summary>
+    /// The size, modification time and identity of a file, which change whenever its contents may have.
+    /// </summary>
+    struct FileStamp
+    {
+        std::uintmax_t size;
+        /// <summary>Nanoseconds since the epoch of fs::stdfs::file_time_type::clock.</summary>
+        std::int64_t mtime;
+        /// <summary>The inode number, or 0 where there is none.</summary>
+        std::uint64_t inode;
+
+        bool operator==(const FileStamp& other) const
+        {
+            return size == other.size && mtime == other.mtime && inode == other.inode;
+        }
+    };
+
     struct Filesystem
     {
         virtual Expected<std::string> read_contents(const fs::path& file_path) const = 0;
@@ -35,6 +52,7 @@ namespace vcpkg::Files
 
         virtual void write_lines(const fs::path& file_path, const std::vector<std::string>& lines) = 0;
         virtual void write_contents(const fs::path& file_path, const std::string& data, std::error_code& ec) = 0;
+        virtual void append_contents(const fs::path& file_path, const std::string& data, std::error_code& ec) = 0;
         virtual void rename(const fs::path& oldpath, const fs::path& newpath) = 0;
         virtual void rename(const fs::path& oldpath, const fs::path& newpath, std::error_code& ec) = 0;
         virtual void rename_or_copy(const fs::path& oldpath,
@@ -58,14 +76,22 @@ namespace vcpkg::Files
         virtual void copy_symlink(const fs::path& oldpath, const fs::path& newpath, std::error_code& ec) = 0;
         virtual fs::file_status status(const fs::path& path, std::error_code& ec) const = 0;
         virtual fs::file_status symlink_status(const fs::path& path, std::error_code& ec) const = 0;
+        virtual FileStamp stamp(const fs::path& path, std::error_code& ec) const = 0;
 
         virtual std::vector<fs::path> find_from_PATH(const std::string& name) const = 0;
 
         void write_contents(const fs::path& file_path, const std::string& data);
+        void append_contents(const fs::path& file_path, const std::string& data);
     };
 
     Filesystem& get_real_filesystem();
 
+    /// <summary>
+    /// A path next to `destination` that no other thread or process writes to, for writing a file that is then
+    /// renamed into place.
+    /// </summary>
+    fs::path unique_temporary_path(const fs::path& destination);
+
     static constexpr const char* FILESYSTEM_INVALID_CHARACTERS = R"(\/:*?"<>|)";
 
     bool has_invalid_chars_for_filesystem(const std::string& s);
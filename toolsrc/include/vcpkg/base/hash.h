@@ -2,10 +2,48 @@
 
 #include <vcpkg/base/files.h>
 
+#include <memory>
 #include <string>
 
 namespace vcpkg::Hash
 {
+    enum class Algorithm
+    {
+        SHA1,
+        SHA256,
+        SHA384,
+        SHA512,
+    };
+
+    /// <summary>
+    /// Parses a hash name such as "SHA512" (case-insensitive). Exits on an unsupported algorithm.
+    /// </summary>
+    Algorithm algorithm_from_string(const std::string& hash_type);
+
+    /// <summary>
+    /// Incremental hasher; feed it data with add_bytes() and read the lowercase hex digest with get_hash().
+    /// </summary>
+    struct Hasher
+    {
+        virtual void add_bytes(const void* start, const void* end) noexcept = 0;
+
+        // Returns the hash of all bytes added since the last clear(), and resets the hasher.
+        virtual std::string get_hash() noexcept = 0;
+        virtual void clear() noexcept = 0;
+
+        virtual ~Hasher() = default;
+    };
+
+    std::unique_ptr<Hasher> get_hasher_for(Algorithm algo);
+
+    std::string get_bytes_hash(const void* first, const void* last, Algorithm algo);
     std::string get_string_hash(const std::string& s, const std::string& hash_type);
     std::string get_file_hash(const Files::Filesystem& fs, const fs::path& path, const std::string& hash_type);
+
+    /// <summary>
+    /// Makes get_file_hash() remember digests in `cache_file`, keyed by the file's absolute path, size, modification
+    /// time and (where available) inode. A file is only hashed again once one of those changes. Files modified in the
+    /// last few seconds are not cached, since a later write within the same timestamp tick would go unnoticed.
+    /// </summary>
+    void enable_file_hash_cache(Files::Filesystem& fs, const fs::path& cache_file);
 }
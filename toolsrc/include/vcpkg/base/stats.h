@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace vcpkg::Stats
+{
+    enum class Counter
+    {
+        FILES_READ,
+        BYTES_READ,
+        FILES_WRITTEN,
+        BYTES_WRITTEN,
+        FILES_COPIED,
+        DIRECTORIES_LISTED,
+        PARAGRAPH_PARSES,
+        HASHES_COMPUTED,
+        BYTES_HASHED,
+        SOURCE_PREFETCH_FAILURES,
+
+        COUNT
+    };
+
+    /// <summary>
+    /// Adds to a process-wide counter. Counting is always on; `--x-stats` only controls printing.
+    /// </summary>
+    void add(const Counter counter, const std::uint64_t amount = 1);
+
+    /// <summary>
+    /// Counts a started process under the file name of `program`.
+    /// </summary>
+    void add_process(const std::string& program);
+
+    /// <summary>
+    /// Counts a process started through the shell under the program named by the first word of `command_line`.
+    /// </summary>
+    void add_command_line(const std::string& command_line);
+
+    void set_enabled(const bool enabled);
+
+    bool is_enabled();
+
+    /// <summary>
+    /// Prints the counters and the peak resident memory of vcpkg itself, if enabled. Called on exit.
+    /// </summary>
+    void print();
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
 #include <unordered_map>
 
 #include <vcpkg/base/files.h>
@@ -16,13 +18,28 @@ namespace vcpkg::System
         CMakeVariable(const CStringView varname, const std::string& varvalue);
         CMakeVariable(const CStringView varname, const fs::path& path);
 
+        /// <summary>
+        /// The `-D<name>=<value>` argument, quoted for a command line.
+        /// </summary>
         std::string s;
+
+        /// <summary>
+        /// The `-D<name>=<value>` argument as is, for `spawn`.
+        /// </summary>
+        std::string argument;
     };
 
     std::string make_cmake_cmd(const fs::path& cmake_exe,
                                const fs::path& cmake_script,
                                const std::vector<CMakeVariable>& pass_variables);
 
+    /// <summary>
+    /// Same as `make_cmake_cmd`, as an argument vector for `spawn`.
+    /// </summary>
+    std::vector<std::string> make_cmake_argv(const fs::path& cmake_exe,
+                                             const fs::path& cmake_script,
+                                             const std::vector<CMakeVariable>& pass_variables);
+
     struct ExitCodeAndOutput
     {
         int exit_code;
@@ -40,6 +57,114 @@ namespace vcpkg::System
 
     ExitCodeAndOutput cmd_execute_and_capture_output(const CStringView cmd_line) noexcept;
 
+    /// <summary>
+    /// Resources used by a child process together with the descendants it waited for.
+    /// </summary>
+    struct ResourceUsage
+    {
+        std::uint64_t user_microseconds = 0;
+        std::uint64_t system_microseconds = 0;
+
+        /// <summary>
+        /// The largest resident set of any single process in the tree.
+        /// </summary>
+        std::uint64_t peak_rss_bytes = 0;
+
+        /// <summary>
+        /// Bytes read from and written to storage. Reads served from the page cache do not count.
+        /// </summary>
+        std::uint64_t read_bytes = 0;
+        std::uint64_t written_bytes = 0;
+    };
+
+#if !defined(_WIN32)
+    enum class ProcessOutput
+    {
+        INHERIT,
+        CAPTURE,
+        DISCARD,
+    };
+
+    struct ProcessOptions
+    {
+        /// <summary>
+        /// Variables set for the child on top of the current environment.
+        /// </summary>
+        std::unordered_map<std::string, std::string> extra_env;
+
+        /// <summary>
+        /// Where standard output goes. Captured output is collected in ExitCodeAndOutput::output.
+        /// </summary>
+        ProcessOutput output = ProcessOutput::INHERIT;
+
+        /// <summary>
+        /// Whether standard error goes wherever standard output goes, like `2>&1`. Otherwise it is inherited.
+        /// </summary>
+        bool redirect_errors = false;
+
+        /// <summary>
+        /// If set, receives captured output as it arrives instead of it being collected. Called from whichever thread
+        /// waits for the process.
+        /// </summary>
+        std::function<void(const char* data, size_t size)> on_output;
+    };
+
+    /// <summary>
+    /// A child process started by `spawn`. Either block in `wait`, or poll `try_wait` until it returns true and then
+    /// call `wait` for the result. A process not waited for is waited for on destruction.
+    /// </summary>
+    struct Process
+    {
+        Process(Process&& other) noexcept;
+        Process& operator=(Process&&) = delete;
+        ~Process();
+
+        /// <summary>
+        /// Waits for the process to exit and returns its exit code, or 128 plus the signal number if it was killed,
+        /// along with the captured output.
+        /// </summary>
+        ExitCodeAndOutput wait();
+
+        /// <summary>
+        /// Collects the output available so far and returns whether the process has exited, without blocking.
+        /// </summary>
+        bool try_wait();
+
+        /// <summary>
+        /// What the process used, as reported by wait4. Filled in once `wait` or `try_wait` has seen it exit.
+        /// </summary>
+        const ResourceUsage& resource_usage() const { return m_resource_usage; }
+
+    private:
+        friend Process spawn(const std::vector<std::string>& argv, const ProcessOptions& options);
+        Process() = default;
+
+        bool read_output(bool block);
+        bool reap(bool block);
+
+        int m_pid = -1;
+        int m_output_fd = -1;
+        bool m_exited = false;
+        ExitCodeAndOutput m_result{0, {}};
+        ResourceUsage m_resource_usage;
+        std::function<void(const char* data, size_t size)> m_on_output;
+    };
+
+    /// <summary>
+    /// Starts `argv[0]`, searched for in PATH, with the arguments `argv` directly, without a shell in between, so
+    /// nothing needs quoting. If the program cannot be started, the returned process has already exited with code 127,
+    /// as it would from a shell.
+    /// </summary>
+    Process spawn(const std::vector<std::string>& argv, const ProcessOptions& options = {});
+#endif
+
+    /// <summary>
+    /// Runs `argv` and captures its standard output and error, like `cmd_execute_and_capture_output`. Outside Windows
+    /// it is started with `spawn`, without a shell; on Windows the arguments are quoted into a command line
+    /// the way CommandLineToArgvW splits it.
+    /// </summary>
+    ExitCodeAndOutput spawn_and_capture_output(const std::vector<std::string>& argv);
+
     enum class Color
     {
         success = 10,
@@ -77,6 +202,34 @@ namespace vcpkg::System
         return System::println(c, Strings::format(message_template, message_arg1, message_args...));
     }
 
+    /// <summary>
+    /// While alive, collects what print and println write on the current thread instead of writing it to the console,
+    /// so that the output of jobs running concurrently does not interleave. Colors are dropped.
+    /// </summary>
+    struct OutputBuffer
+    {
+        OutputBuffer();
+        OutputBuffer(const OutputBuffer&) = delete;
+        OutputBuffer& operator=(const OutputBuffer&) = delete;
+        ~OutputBuffer();
+
+        /// <summary>
+        /// The buffer of the current thread, or nullptr if its output goes to the console.
+        /// </summary>
+        static OutputBuffer* current();
+
+        void append(const char* data, size_t size) { text.append(data, size); }
+
+        /// <summary>
+        /// Returns what was collected so far and empties the buffer.
+        /// </summary>
+        std::string take() { return std::move(text); }
+
+    private:
+        std::string text;
+        OutputBuffer* previous;
+    };
+
     Optional<std::string> get_environment_variable(const CStringView varname) noexcept;
 
     Optional<std::string> get_registry_string(void* base_hkey, const CStringView subkey, const CStringView valuename);
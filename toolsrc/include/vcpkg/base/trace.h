@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vcpkg/base/cstringview.h>
+#include <vcpkg/base/files.h>
+
+#include <chrono>
+#include <string>
+
+namespace vcpkg::Trace
+{
+    /// <summary>
+    /// Starts recording spans, to be written to `path` in the Chrome trace event format when vcpkg exits. The file
+    /// opens in chrome://tracing and https://ui.perfetto.dev, with one track per thread.
+    /// </summary>
+    void start(const fs::path& path);
+
+    bool is_enabled();
+
+    /// <summary>
+    /// Writes the spans recorded so far. Called on exit.
+    /// </summary>
+    void flush();
+
+    /// <summary>
+    /// Records the time from construction to destruction as a span on the current thread's track, named after
+    /// `category` and `detail`. Does nothing unless tracing was started.
+    /// </summary>
+    struct Span
+    {
+        explicit Span(const CStringView category, const std::string& detail = {});
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+        ~Span();
+
+    private:
+        const char* m_category;
+        std::string m_name;
+        std::chrono::steady_clock::time_point m_start;
+    };
+}
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <map>
 #include <mutex>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -214,6 +216,37 @@ namespace vcpkg::Util
         T& m_ptr;
     };
 
+    /// <summary>
+    /// Calls `f(i)` for every i in [0, count) from up to `max_threads` threads, including the calling thread.
+    /// A `max_threads` of 0 uses the hardware concurrency.
+    /// </summary>
+    template<class Func>
+    void parallel_for_each_n(const size_t count, Func&& f, size_t max_threads = 0)
+    {
+        if (max_threads == 0) max_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        const size_t thread_count = std::min(max_threads, count);
+        if (thread_count <= 1)
+        {
+            for (size_t i = 0; i < count; ++i)
+                f(i);
+            return;
+        }
+
+        std::atomic<size_t> next_index{0};
+        auto worker = [&]() {
+            for (size_t i = next_index++; i < count; i = next_index++)
+                f(i);
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(thread_count - 1);
+        for (size_t i = 1; i < thread_count; ++i)
+            threads.emplace_back(worker);
+        worker();
+        for (auto&& thread : threads)
+            thread.join();
+    }
+
     namespace Enum
     {
         template<class E>
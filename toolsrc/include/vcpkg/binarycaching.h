@@ -0,0 +1,209 @@
+#pragma once
+
+#include <vcpkg/base/expected.h>
+#include <vcpkg/base/files.h>
+#include <vcpkg/base/optional.h>
+#include <vcpkg/packagespec.h>
+#include <vcpkg/vcpkgpaths.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vcpkg::BinaryCaching
+{
+    enum class CacheStatus
+    {
+        MISSING,
+        AVAILABLE,
+        FAILED,
+    };
+
+    enum class Access
+    {
+        READ,
+        WRITE,
+        READ_WRITE,
+    };
+
+    /// <summary>
+    /// A store of built packages, as zip archives keyed by ABI tag, along with "tombstones" recording ABI tags whose
+    /// build failed. Implementations must be safe to call from several threads at once.
+    /// </summary>
+    struct BinaryProvider
+    {
+        explicit BinaryProvider(Access access) : access(access) {}
+        virtual ~BinaryProvider() = default;
+
+        /// <summary>
+        /// Describes where the archive for `abi` lives (a path or URL), for messages.
+        /// </summary>
+        virtual std::string location(const std::string& abi) const = 0;
+
+        virtual CacheStatus lookup(const std::string& abi) const = 0;
+
+        /// <summary>
+        /// Makes the archive for `abi` available locally and returns its path. Providers that do not keep archives
+        /// on the local file system download it to `scratch_path`.
+        /// </summary>
+        virtual Optional<fs::path> fetch(const std::string& abi, const fs::path& scratch_path) const = 0;
+
+        /// <summary>
+        /// Copies `archive_path` into the cache. The archive itself is left in place.
+        /// </summary>
+        virtual bool store(const std::string& abi, const fs::path& archive_path) const = 0;
+
+        virtual void store_failure(const std::string& abi) const = 0;
+        virtual void clear_failure(const std::string& abi) const = 0;
+
+        bool can_read() const { return access != Access::WRITE; }
+        bool can_write() const { return access != Access::READ; }
+
+    private:
+        Access access;
+    };
+
+    /// <summary>
+    /// Contents of a directory cache's `index.txt`, which records the status of every ABI in the cache so lookups do
+    /// not have to probe the (possibly remote) file system once per package. The file is a header line
+    /// `vcpkg-binary-index-1 <scan time>` followed by appended `<abi> <pass|fail|missing> <size> <time>` lines, times
+    /// in seconds since the epoch. Later lines override earlier ones; malformed lines are ignored.
+    /// </summary>
+    struct BinaryIndex
+    {
+        struct Entry
+        {
+            CacheStatus status;
+            std::uint64_t size;
+            std::int64_t time;
+        };
+
+        /// <summary>
+        /// When the cache directory was last scanned in full. Entries appended since keep the index current; archives
+        /// copied in by other tools are found by the stat made for any ABI not listed as available.
+        /// </summary>
+        std::int64_t scan_time = 0;
+        std::unordered_map<std::string, Entry> entries;
+
+        static Optional<BinaryIndex> parse(const std::string& text);
+        static std::string format_header(std::int64_t scan_time);
+        static std::string format_entry(const std::string& abi, const Entry& entry);
+    };
+
+    /// <summary>
+    /// Cache of archives in a directory, laid out as `<dir>/<first 2 chars of abi>/<abi>.zip`, with tombstones under
+    /// `<dir>/fail/`. This is both the local `archives` directory and the layout of shared directories.
+    /// Lookups are answered from `<dir>/index.txt` while it is less than a day old, with one stat of the archive for
+    /// ABIs it does not list as available; writable providers rescan the directory to rebuild it when it is missing or
+    /// older, read-only providers fall back to probing each archive.
+    /// </summary>
+    std::unique_ptr<BinaryProvider> make_directory_provider(Files::Filesystem& fs, const fs::path& dir, Access access);
+
+    /// <summary>
+    /// Cache behind an HTTP server that answers GET, HEAD, PUT and DELETE for `<url_prefix>/<abi>.zip`, with
+    /// tombstones at `<url_prefix>/fail/<abi>.zip`.
+    /// </summary>
+    std::unique_ptr<BinaryProvider> make_http_provider(const std::string& url_prefix, Access access);
+
+    /// <summary>
+    /// An ordered list of binary providers. Reads are answered by the first provider that has the archive; writes go
+    /// to every writable provider.
+    /// </summary>
+    struct BinaryProviders
+    {
+        std::vector<std::unique_ptr<BinaryProvider>> providers;
+
+        /// <summary>
+        /// Returns AVAILABLE if any readable provider has the archive, otherwise FAILED if any has a tombstone.
+        /// </summary>
+        CacheStatus lookup(const std::string& abi) const;
+
+        struct FetchResult
+        {
+            std::string location;
+            fs::path archive_path;
+        };
+
+        /// <summary>
+        /// Fetches the archive from the first provider that has it. Writable providers earlier in the list are
+        /// back-filled, so the next lookup is answered locally.
+        /// </summary>
+        Optional<FetchResult> fetch(const std::string& abi, const fs::path& scratch_path) const;
+
+        /// <summary>
+        /// Stores the archive in every writable provider and returns the locations it was stored to.
+        /// </summary>
+        std::vector<std::string> store(const std::string& abi, const fs::path& archive_path) const;
+
+        void store_failure(const std::string& abi) const;
+        void clear_failure(const std::string& abi) const;
+    };
+
+    /// <summary>
+    /// Parses a list of binary sources separated by ';'. Each source is one of:
+    ///   clear                        removes all sources configured before it, including the default
+    ///   default[,access]             the local archives directory (`default_dir`), read-write unless specified
+    ///   files,path[,access]          a shared directory, read-only unless specified
+    ///   http,url_prefix[,access]     an HTTP server, read-only unless specified
+    /// where access is one of read, write or readwrite. The default source comes first unless cleared.
+    /// </summary>
+    ExpectedT<BinaryProviders, std::string> parse_binary_sources(Files::Filesystem& fs,
+                                                                 const fs::path& default_dir,
+                                                                 const std::string& sources);
+
+    /// <summary>
+    /// Returns the providers configured by the VCPKG_BINARY_SOURCES environment variable, parsed on first use.
+    /// </summary>
+    const BinaryProviders& get_binary_providers(const VcpkgPaths& paths);
+
+    /// <summary>
+    /// Compresses `package_dir` into `tmp_archive_path` and stores it to the binary providers on a background
+    /// thread, so the next build can start right away. Only blocks while several stores are already waiting, which
+    /// bounds the package directories and archives kept alive for the queue.
+    /// </summary>
+    void enqueue_store(const VcpkgPaths& paths,
+                       const std::string& abi,
+                       const fs::path& package_dir,
+                       const fs::path& tmp_archive_path);
+
+    /// <summary>
+    /// Removes `package_dir`, or if a store of it is still pending, has the store remove it once compressed.
+    /// </summary>
+    void remove_package_dir(Files::Filesystem& fs, const fs::path& package_dir);
+
+    /// <summary>
+    /// Returns whether a store of `package_dir` has not finished compressing it yet.
+    /// </summary>
+    bool is_store_pending(const fs::path& package_dir);
+
+    struct PrefetchRequest
+    {
+        PackageSpec spec;
+
+        /// <summary>
+        /// Computes the ABI tag of the package, or returns an empty string if it is not known. Called on the prefetch
+        /// worker, right before fetching.
+        /// </summary>
+        std::function<std::string()> get_abi;
+    };
+
+    /// <summary>
+    /// Starts fetching and extracting the cached archives for `requests` on background threads, in order, into a
+    /// staging directory under `packages`. Anything left from an earlier prefetch is discarded.
+    /// </summary>
+    void start_prefetch(const VcpkgPaths& paths, std::vector<PrefetchRequest> requests);
+
+    /// <summary>
+    /// If the package for `spec` was prefetched with ABI tag `abi`, moves it into its package directory and returns
+    /// where the archive came from. Waits for a prefetch of `spec` in progress; one not yet started is cancelled.
+    /// </summary>
+    Optional<std::string> claim_prefetched_package(const VcpkgPaths& paths,
+                                                   const PackageSpec& spec,
+                                                   const std::string& abi);
+
+    /// <summary>
+    /// Cancels the prefetches not yet started, waits for the others and deletes whatever was not claimed.
+    /// </summary>
+    void finish_prefetch(const VcpkgPaths& paths);
+}
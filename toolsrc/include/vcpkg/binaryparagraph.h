@@ -3,8 +3,6 @@
 #include <vcpkg/packagespec.h>
 #include <vcpkg/sourceparagraph.h>
 
-#include <unordered_map>
-
 namespace vcpkg
 {
     /// <summary>
@@ -13,7 +11,7 @@ namespace vcpkg
     struct BinaryParagraph
     {
         BinaryParagraph();
-        explicit BinaryParagraph(std::unordered_map<std::string, std::string> fields);
+        explicit BinaryParagraph(Parse::ParagraphView fields);
         BinaryParagraph(const SourceParagraph& spgh, const Triplet& triplet, const std::string& abi_tag);
         BinaryParagraph(const SourceParagraph& spgh, const FeatureParagraph& fpgh, const Triplet& triplet);
 
@@ -9,6 +9,7 @@
 #include <vcpkg/base/cstringview.h>
 #include <vcpkg/base/files.h>
 #include <vcpkg/base/optional.h>
+#include <vcpkg/base/system.h>
 
 #include <array>
 #include <map>
@@ -116,7 +117,8 @@ namespace vcpkg::Build
     struct PreBuildInfo
     {
         /// <summary>
-        /// Runs the triplet file in a "capture" mode to create a PreBuildInfo
+        /// Runs the triplet file in a "capture" mode to create a PreBuildInfo. The result is cached for the lifetime
+        /// of the process, keyed by the contents of the triplet file.
         /// </summary>
         static PreBuildInfo from_triplet_file(const VcpkgPaths& paths, const Triplet& triplet);
 
@@ -141,6 +143,12 @@ namespace vcpkg::Build
         BuildResult code;
         std::vector<FeatureSpec> unmet_dependencies;
         std::unique_ptr<BinaryControlFile> binary_control_file;
+
+        /// <summary>
+        /// What the port's build used, when it was built rather than restored from the binary cache. Not measured on
+        /// Windows.
+        /// </summary>
+        Optional<System::ResourceUsage> resource_usage;
     };
 
     struct BuildPackageConfig
@@ -244,8 +252,55 @@ namespace vcpkg::Build
         fs::path tag_file;
     };
 
+    /// <summary>
+    /// Looks up the ABI tags of the installed dependencies of a package.
+    /// The dependency features which are not installed yet are returned as the error.
+    /// </summary>
+    ExpectedT<std::vector<AbiEntry>, std::vector<FeatureSpec>> compute_dependency_abis(
+        const BuildPackageConfig& config, const StatusParagraphs& status_db);
+
+    /// <summary>
+    /// Builds a package whose dependencies have already been resolved against the status database.
+    /// Does not read the status database, so independent packages may be built concurrently.
+    /// </summary>
+    ExtendedBuildResult build_package(const VcpkgPaths& paths,
+                                      const BuildPackageConfig& config,
+                                      const PreBuildInfo& pre_build_info,
+                                      Span<const AbiEntry> dependency_abis);
+
     Optional<AbiTagAndFile> compute_abi_tag(const VcpkgPaths& paths,
                                             const BuildPackageConfig& config,
                                             const PreBuildInfo& pre_build_info,
                                             Span<const AbiEntry> dependency_abis);
+
+    /// <summary>
+    /// Evaluates the portfile in download-only mode, which fetches its sources into `downloads` without extracting,
+    /// patching or building them. Returns whether the portfile ran to completion; the output is only shown when
+    /// debugging, since the build reports any download error again.
+    /// </summary>
+    bool download_sources(const VcpkgPaths& paths, const BuildPackageConfig& config);
+
+    struct SourcePrefetchRequest
+    {
+        BuildPackageConfig config;
+
+        /// <summary>
+        /// Computes the ABI tag of the package, or returns an empty string if it is not known. Called on the prefetch
+        /// worker; sources are not fetched for packages in the binary cache.
+        /// </summary>
+        std::function<std::string()> get_abi;
+    };
+
+    /// <summary>
+    /// Starts downloading the sources for `requests` on background threads, in order, so that downloads overlap with
+    /// building earlier packages. build_package waits for a download of its own sources in progress; one not yet
+    /// started is cancelled, as the build downloads the sources itself. A prefetch that fails is reported as a warning.
+    /// The configs must outlive the prefetch.
+    /// </summary>
+    void start_source_prefetch(const VcpkgPaths& paths, std::vector<SourcePrefetchRequest> requests);
+
+    /// <summary>
+    /// Cancels the source downloads not yet started and waits for the others.
+    /// </summary>
+    void finish_source_prefetch();
 }
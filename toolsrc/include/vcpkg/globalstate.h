@@ -15,6 +15,7 @@ namespace vcpkg
         static std::atomic<bool> debugging;
         static std::atomic<bool> feature_packages;
         static std::atomic<bool> g_binary_caching;
+        static std::atomic<bool> g_triplet_cache;
 
         static std::atomic<int> g_init_console_cp;
         static std::atomic<int> g_init_console_output_cp;
@@ -29,14 +30,10 @@ namespace vcpkg
             void transition_handle_ctrl_c() noexcept;
 
         private:
-            enum class CtrlCState
-            {
-                normal,
-                blocked_on_child,
-                exit_requested,
-            };
-
-            std::atomic<CtrlCState> m_state;
+            // Number of child processes currently being waited on, or EXIT_REQUESTED once Ctrl-C was hit.
+            static constexpr int EXIT_REQUESTED = -1;
+
+            std::atomic<int> m_children;
         };
 
         static CtrlCStateMachine g_ctrl_c_state;
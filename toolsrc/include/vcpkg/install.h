@@ -18,6 +18,27 @@ namespace vcpkg::Install
 
     inline KeepGoing to_keep_going(const bool value) { return value ? KeepGoing::YES : KeepGoing::NO; }
 
+    enum class PrefetchSources
+    {
+        NO = 0,
+        YES
+    };
+
+    inline PrefetchSources to_prefetch_sources(const bool value)
+    {
+        return value ? PrefetchSources::YES : PrefetchSources::NO;
+    }
+
+    /// <summary>
+    /// Whether installing a package may move its files out of the package directory instead of copying them. Only
+    /// worth it when the package directory is deleted afterwards.
+    /// </summary>
+    enum class MoveFiles
+    {
+        NO = 0,
+        YES
+    };
+
     struct SpecSummary
     {
         SpecSummary(const PackageSpec& spec, const Dependencies::AnyAction* action);
@@ -37,7 +58,13 @@ namespace vcpkg::Install
         std::string total_elapsed_time;
 
         void print() const;
-        static std::string xunit_result(const PackageSpec& spec, Chrono::ElapsedTime time, Build::BuildResult code);
+        /// <summary>
+        /// One `<test>` element. The resource usage of a build, if given, is recorded as traits.
+        /// </summary>
+        static std::string xunit_result(const PackageSpec& spec,
+                                        Chrono::ElapsedTime time,
+                                        Build::BuildResult code,
+                                        const Optional<System::ResourceUsage>& resource_usage = nullopt);
         std::string xunit_results() const;
     };
 
@@ -70,15 +97,32 @@ namespace vcpkg::Install
 
     std::vector<std::string> get_all_port_names(const VcpkgPaths& paths);
 
-    void install_files_and_write_listfile(Files::Filesystem& fs, const fs::path& source_dir, const InstallDir& dirs);
+    /// <summary>
+    /// Installs the files of `source_dir` into `dirs` and writes the listfile. With MoveFiles::YES, files and whole
+    /// directories are renamed into place where possible, leaving `source_dir` partly emptied; anything that cannot
+    /// be renamed, for example because it is on another file system, is copied. The listfile is the same either way.
+    /// Returns the lines of the listfile.
+    /// </summary>
+    std::vector<std::string> install_files_and_write_listfile(Files::Filesystem& fs,
+                                                              const fs::path& source_dir,
+                                                              const InstallDir& dirs,
+                                                              const MoveFiles move_files = MoveFiles::NO);
     InstallResult install_package(const VcpkgPaths& paths,
                                   const BinaryControlFile& binary_paragraph,
-                                  StatusParagraphs* status_db);
+                                  StatusParagraphs* status_db,
+                                  const MoveFiles move_files = MoveFiles::NO);
 
     InstallSummary perform(const std::vector<Dependencies::AnyAction>& action_plan,
                            const KeepGoing keep_going,
                            const VcpkgPaths& paths,
-                           StatusParagraphs& status_db);
+                           StatusParagraphs& status_db,
+                           const size_t jobs = 1,
+                           const PrefetchSources prefetch_sources = PrefetchSources::NO);
+
+    /// <summary>
+    /// Number of packages to build concurrently, as given by the `--jobs` setting. Defaults to 1.
+    /// </summary>
+    size_t parse_jobs_setting(const ParsedArguments& options);
 
     extern const CommandStructure COMMAND_STRUCTURE;
 
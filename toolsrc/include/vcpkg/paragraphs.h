@@ -9,6 +9,20 @@
 namespace vcpkg::Paragraphs
 {
     using RawParagraph = Parse::RawParagraph;
+    using ParagraphView = Parse::ParagraphView;
+
+    /// <summary>
+    /// Parses the paragraphs of `text` into views of it. Values that span several lines are normalized within `text`,
+    /// which must outlive the result.
+    /// </summary>
+    std::vector<ParagraphView> parse_paragraph_views(std::string& text);
+
+    /// <summary>
+    /// Reads a file into `text` and parses its paragraphs into views of it.
+    /// </summary>
+    Expected<std::vector<ParagraphView>> get_paragraph_views(const Files::Filesystem& fs,
+                                                             const fs::path& control_path,
+                                                             std::string& text);
 
     Expected<RawParagraph> get_single_paragraph(const Files::Filesystem& fs, const fs::path& control_path);
     Expected<std::vector<RawParagraph>> get_paragraphs(const Files::Filesystem& fs, const fs::path& control_path);
@@ -27,6 +41,14 @@ namespace vcpkg::Paragraphs
 
     LoadResults try_load_all_ports(const Files::Filesystem& fs, const fs::path& ports_dir);
 
+    /// <summary>
+    /// Loads every port in the ports tree, reusing the SourceControlFile cached in the ports snapshot for CONTROL files
+    /// whose size and last write time are unchanged. The snapshot is updated with any port that had to be parsed again.
+    /// </summary>
+    LoadResults try_load_all_ports(const VcpkgPaths& paths);
+
     std::vector<std::unique_ptr<SourceControlFile>> load_all_ports(const Files::Filesystem& fs,
                                                                    const fs::path& ports_dir);
+
+    std::vector<std::unique_ptr<SourceControlFile>> load_all_ports(const VcpkgPaths& paths);
 }
@@ -4,6 +4,7 @@
 #include <vcpkg/base/optional.h>
 
 #include <memory>
+#include <string_view>
 #include <unordered_map>
 
 namespace vcpkg::Parse
@@ -21,16 +22,29 @@ namespace vcpkg::Parse
 
     using RawParagraph = std::unordered_map<std::string, std::string>;
 
+    /// <summary>
+    /// The fields of one paragraph as (name, value) pairs in file order, referring into the text they were parsed from.
+    /// </summary>
+    using ParagraphView = std::vector<std::pair<std::string_view, std::string_view>>;
+
+    /// <summary>
+    /// Views of the fields of `fields`, which must outlive the result.
+    /// </summary>
+    ParagraphView to_paragraph_view(const RawParagraph& fields);
+
+    RawParagraph to_raw_paragraph(const ParagraphView& fields);
+
     struct ParagraphParser
     {
-        ParagraphParser(RawParagraph&& fields) : fields(std::move(fields)) {}
+        explicit ParagraphParser(ParagraphView fields) : fields(std::move(fields)) {}
+        explicit ParagraphParser(const RawParagraph& fields) : fields(to_paragraph_view(fields)) {}
 
         void required_field(const std::string& fieldname, std::string& out);
-        std::string optional_field(const std::string& fieldname) const;
+        std::string optional_field(const std::string& fieldname);
         std::unique_ptr<ParseControlErrorInfo> error_info(const std::string& name) const;
 
     private:
-        RawParagraph&& fields;
+        ParagraphView fields;
         std::vector<std::string> missing_fields;
     };
 
@@ -60,6 +60,8 @@ namespace vcpkg
     {
         static Parse::ParseExpected<SourceControlFile> parse_control_file(
             std::vector<Parse::RawParagraph>&& control_paragraphs);
+        static Parse::ParseExpected<SourceControlFile> parse_control_file(
+            const std::vector<Parse::ParagraphView>& control_paragraphs);
 
         std::unique_ptr<SourceParagraph> core_paragraph;
         std::vector<std::unique_ptr<FeatureParagraph>> feature_paragraphs;
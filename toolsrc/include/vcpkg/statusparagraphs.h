@@ -3,14 +3,43 @@
 
 #include <iterator>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 namespace vcpkg
 {
+    struct StatusParagraphs;
+    struct VcpkgPaths;
+
+    /// <summary>
+    /// Index of which package owns each installed file, keyed by listfile entry (e.g. "x64-windows/include/zlib.h").
+    /// Directories are not indexed.
+    /// </summary>
+    struct InstalledFileIndex
+    {
+        /// <summary>
+        /// Builds the index from the listfiles of all installed packages, unless that was already done.
+        /// </summary>
+        void ensure_loaded(const VcpkgPaths& paths, const StatusParagraphs& status_db);
+
+        const PackageSpec* find_owner(const std::string& file) const;
+
+        void add_package(const PackageSpec& spec, std::vector<std::string>&& files);
+        void remove_package(const PackageSpec& spec);
+
+    private:
+        bool m_loaded = false;
+        std::unordered_map<std::string, PackageSpec> m_owners;
+        std::unordered_map<PackageSpec, std::vector<std::string>> m_files;
+    };
+
     /// <summary>Status paragraphs</summary>
     ///
     /// Collection of <see cref="vcpkg::StatusParagraph"/>, e.g. contains the information
     /// about whether a package is installed or not.
     ///
+    /// Paragraphs are indexed by name and triplet, so lookups do not scan the whole collection.
+    ///
     struct StatusParagraphs
     {
         StatusParagraphs();
@@ -64,6 +93,12 @@ namespace vcpkg
 
         iterator insert(std::unique_ptr<StatusParagraph>);
 
+        /// <summary>
+        /// The owners of the files of the packages installed according to this database. Loaded from the listfiles on
+        /// first use; Install::install_package and Remove::remove_package keep it up to date.
+        /// </summary>
+        InstalledFileIndex& installed_file_index() { return file_index; }
+
         friend void serialize(const StatusParagraphs& pgh, std::string& out_str);
 
         iterator end() { return paragraphs.rend(); }
@@ -75,7 +110,31 @@ namespace vcpkg
         const_iterator begin() const { return paragraphs.rbegin(); }
 
     private:
+        struct IndexKey
+        {
+            std::string name;
+            Triplet triplet;
+
+            bool operator==(const IndexKey& other) const { return name == other.name && triplet == other.triplet; }
+        };
+
+        struct IndexKeyHash
+        {
+            size_t operator()(const IndexKey& key) const;
+        };
+
+        void index_paragraph(size_t position);
+        const std::vector<size_t>* find_positions(const std::string& name, const Triplet& triplet) const;
+        Optional<size_t> find_position(const std::string& name,
+                                       const Triplet& triplet,
+                                       const std::string& feature) const;
+
         std::vector<std::unique_ptr<StatusParagraph>> paragraphs;
+
+        /// <summary>Positions in `paragraphs` of every paragraph with a given name and triplet, in order.</summary>
+        std::unordered_map<IndexKey, std::vector<size_t>, IndexKeyHash> index;
+
+        InstalledFileIndex file_index;
     };
 
     void serialize(const StatusParagraphs& pgh, std::string& out_str);
@@ -74,9 +74,11 @@ namespace vcpkg
 
         std::unique_ptr<std::string> vcpkg_root_dir;
         std::unique_ptr<std::string> triplet;
+        std::unique_ptr<std::string> trace_file;
         Optional<bool> debug = nullopt;
         Optional<bool> sendmetrics = nullopt;
         Optional<bool> printmetrics = nullopt;
+        Optional<bool> stats = nullopt;
 
         // feature flags
         Optional<bool> featurepackages = nullopt;
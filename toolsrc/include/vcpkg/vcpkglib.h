@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vcpkg/base/sortedvector.h>
+#include <vcpkg/base/util.h>
 #include <vcpkg/statusparagraphs.h>
 #include <vcpkg/vcpkgpaths.h>
 
@@ -20,5 +21,10 @@ namespace vcpkg
     std::vector<StatusParagraphAndAssociatedFiles> get_installed_files(const VcpkgPaths& paths,
                                                                        const StatusParagraphs& status_db);
 
+    /// <summary>
+    /// Reads the file entries (excluding directories) of an installed package's listfile.
+    /// </summary>
+    std::vector<std::string> read_installed_files_of(const VcpkgPaths& paths, const StatusParagraph& pgh);
+
     std::string shorten_text(const std::string& desc, const size_t length);
 } // namespace vcpkg
@@ -62,7 +62,9 @@ namespace vcpkg
         fs::path packages;
         fs::path buildtrees;
         fs::path downloads;
+        fs::path file_hash_cache;
         fs::path ports;
+        fs::path ports_snapshot_file;
         fs::path installed;
         fs::path triplets;
         fs::path scripts;
@@ -73,6 +75,7 @@ namespace vcpkg
 
         fs::path vcpkg_dir;
         fs::path vcpkg_dir_status_file;
+        fs::path vcpkg_dir_status_journal;
         fs::path vcpkg_dir_info;
         fs::path vcpkg_dir_updates;
 
@@ -31,6 +31,22 @@ namespace UnitTest1
             Assert::IsTrue(v.printmetrics && *v.printmetrics.get());
         }
 
+        TEST_METHOD(create_from_arg_sequence_trace_file)
+        {
+            std::vector<std::string> t = {"--X-Trace-File=C:\\Temp\\Trace.json", "install"};
+            auto v = VcpkgCmdArguments::create_from_arg_sequence(t.data(), t.data() + t.size());
+            Assert::AreEqual("C:\\Temp\\Trace.json", v.trace_file.get()->c_str());
+            Assert::AreEqual("install", v.command.c_str());
+        }
+
+        TEST_METHOD(create_from_arg_sequence_stats)
+        {
+            std::vector<std::string> t = {"--X-STATS", "install"};
+            auto v = VcpkgCmdArguments::create_from_arg_sequence(t.data(), t.data() + t.size());
+            Assert::IsTrue(v.stats && *v.stats.get());
+            Assert::AreEqual("install", v.command.c_str());
+        }
+
         TEST_METHOD(create_from_arg_sequence_valued_options)
         {
             std::array<CommandSetting, 1> settings = { {{"--a", ""}} };
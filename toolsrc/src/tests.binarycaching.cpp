@@ -0,0 +1,294 @@
+#include "tests.pch.h"
+
+#include <vcpkg/binarycaching.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+using namespace vcpkg;
+using namespace vcpkg::BinaryCaching;
+
+namespace UnitTest1
+{
+    static const std::string ABI = "ab0123456789";
+
+    class BinaryCachingTests : public TestClass<BinaryCachingTests>
+    {
+        static ExpectedT<BinaryProviders, std::string> parse(const std::string& sources)
+        {
+            return parse_binary_sources(Files::get_real_filesystem(), fs::u8path("archives"), sources);
+        }
+
+        // A scratch directory holding an archive to store, removed again when the test ends.
+        struct TestDirectory
+        {
+            TestDirectory()
+                : fs(Files::get_real_filesystem())
+                , root(Files::unique_temporary_path(fs::stdfs::temp_directory_path() / "vcpkg-binarycaching"))
+            {
+                std::error_code ec;
+                fs.create_directories(root, ec);
+                fs.write_contents(archive(), "archive contents", ec);
+                Assert::IsFalse(static_cast<bool>(ec));
+            }
+
+            ~TestDirectory()
+            {
+                std::error_code ec;
+                fs.remove_all(root, ec);
+            }
+
+            fs::path archive() const { return root / "package.zip"; }
+
+            std::unique_ptr<BinaryProvider> provider(const std::string& name, Access access) const
+            {
+                return make_directory_provider(fs, root / name, access);
+            }
+
+            // curl serves and accepts uploads of file:// URLs, which stands in for an HTTP server.
+            std::unique_ptr<BinaryProvider> url_provider(const std::string& name, Access access) const
+            {
+                const auto path = (root / name).generic_u8string();
+                return make_http_provider((path.front() == '/' ? "file://" : "file:///") + path, access);
+            }
+
+            Files::Filesystem& fs;
+            fs::path root;
+        };
+
+        TEST_METHOD(default_sources)
+        {
+            auto maybe_providers = parse("");
+            Assert::IsTrue(maybe_providers.has_value());
+
+            auto& providers = maybe_providers.value_or_exit(VCPKG_LINE_INFO).providers;
+            Assert::AreEqual(size_t(1), providers.size());
+            Assert::IsTrue(providers[0]->can_read());
+            Assert::IsTrue(providers[0]->can_write());
+            Assert::AreEqual((fs::u8path("archives") / "ab" / "abcdef.zip").u8string(),
+                             providers[0]->location("abcdef"));
+        }
+
+        TEST_METHOD(clear_removes_default)
+        {
+            auto maybe_providers = parse("clear;http,https://example.com/cache/,readwrite");
+            Assert::IsTrue(maybe_providers.has_value());
+
+            auto& providers = maybe_providers.value_or_exit(VCPKG_LINE_INFO).providers;
+            Assert::AreEqual(size_t(1), providers.size());
+            Assert::IsTrue(providers[0]->can_read());
+            Assert::IsTrue(providers[0]->can_write());
+            Assert::AreEqual(std::string("https://example.com/cache/abcdef.zip"), providers[0]->location("abcdef"));
+        }
+
+        TEST_METHOD(sources_keep_order_and_access)
+        {
+            auto maybe_providers = parse("files,shared;http,https://example.com,write;;default,read");
+            Assert::IsTrue(maybe_providers.has_value());
+
+            auto& providers = maybe_providers.value_or_exit(VCPKG_LINE_INFO).providers;
+            Assert::AreEqual(size_t(4), providers.size());
+
+            Assert::AreEqual((fs::u8path("shared") / "ab" / "abcdef.zip").u8string(),
+                             providers[1]->location("abcdef"));
+            Assert::IsTrue(providers[1]->can_read());
+            Assert::IsFalse(providers[1]->can_write());
+
+            Assert::IsFalse(providers[2]->can_read());
+            Assert::IsTrue(providers[2]->can_write());
+
+            Assert::IsTrue(providers[3]->can_read());
+            Assert::IsFalse(providers[3]->can_write());
+        }
+
+        TEST_METHOD(invalid_sources)
+        {
+            Assert::IsFalse(parse("nuget,https://example.com").has_value());
+            Assert::IsFalse(parse("files").has_value());
+            Assert::IsFalse(parse("files,shared,readonly").has_value());
+            Assert::IsFalse(parse("files,shared,read,extra").has_value());
+            Assert::IsFalse(parse("default,read,extra").has_value());
+            Assert::IsFalse(parse("clear,now").has_value());
+        }
+
+        TEST_METHOD(index_later_entries_win)
+        {
+            const std::string text = BinaryIndex::format_header(100) +
+                                     BinaryIndex::format_entry("aa01", {CacheStatus::FAILED, 0, 101}) +
+                                     BinaryIndex::format_entry("bb02", {CacheStatus::AVAILABLE, 4096, 102}) +
+                                     BinaryIndex::format_entry("aa01", {CacheStatus::AVAILABLE, 2048, 103});
+
+            auto maybe_index = BinaryIndex::parse(text);
+            Assert::IsTrue(maybe_index.has_value());
+            auto& index = *maybe_index.get();
+
+            Assert::AreEqual(int64_t(100), index.scan_time);
+            Assert::AreEqual(size_t(2), index.entries.size());
+            Assert::IsTrue(index.entries.at("aa01").status == CacheStatus::AVAILABLE);
+            Assert::AreEqual(uint64_t(2048), index.entries.at("aa01").size);
+            Assert::AreEqual(int64_t(103), index.entries.at("aa01").time);
+        }
+
+        TEST_METHOD(index_skips_malformed_entries)
+        {
+            auto maybe_index = BinaryIndex::parse(BinaryIndex::format_header(100) + "aa01 pass 12\n" +
+                                                  "bb02 gone 12 101\n" + "cc03 pass 12 1cc03 fail 0 102\n" +
+                                                  BinaryIndex::format_entry("dd04", {CacheStatus::MISSING, 0, 103}));
+            Assert::IsTrue(maybe_index.has_value());
+
+            auto& entries = maybe_index.get()->entries;
+            Assert::AreEqual(size_t(1), entries.size());
+            Assert::IsTrue(entries.at("dd04").status == CacheStatus::MISSING);
+        }
+
+        TEST_METHOD(directory_missing)
+        {
+            TestDirectory dir;
+            const auto provider = dir.provider("cache", Access::READ_WRITE);
+
+            Assert::IsTrue(provider->lookup(ABI) == CacheStatus::MISSING);
+            Assert::IsFalse(provider->fetch(ABI, dir.root / "scratch.zip").has_value());
+        }
+
+        TEST_METHOD(directory_store_then_fetch)
+        {
+            TestDirectory dir;
+            const auto provider = dir.provider("cache", Access::READ_WRITE);
+
+            Assert::IsTrue(provider->store(ABI, dir.archive()));
+            Assert::IsTrue(dir.fs.exists(dir.archive()));
+            Assert::IsTrue(provider->lookup(ABI) == CacheStatus::AVAILABLE);
+
+            auto maybe_path = provider->fetch(ABI, dir.root / "scratch.zip");
+            Assert::IsTrue(maybe_path.has_value());
+            Assert::AreEqual(provider->location(ABI), maybe_path.get()->u8string());
+            Assert::AreEqual(std::string("archive contents"),
+                             dir.fs.read_contents(*maybe_path.get()).value_or_exit(VCPKG_LINE_INFO));
+        }
+
+        TEST_METHOD(directory_failure_round_trip)
+        {
+            TestDirectory dir;
+            const auto provider = dir.provider("cache", Access::READ_WRITE);
+
+            provider->store_failure(ABI);
+            Assert::IsTrue(provider->lookup(ABI) == CacheStatus::FAILED);
+            Assert::IsFalse(provider->fetch(ABI, dir.root / "scratch.zip").has_value());
+
+            provider->clear_failure(ABI);
+            Assert::IsTrue(provider->lookup(ABI) == CacheStatus::MISSING);
+        }
+
+        TEST_METHOD(directory_archive_wins_over_tombstone)
+        {
+            TestDirectory dir;
+            const auto provider = dir.provider("cache", Access::READ_WRITE);
+
+            provider->store_failure(ABI);
+            Assert::IsTrue(provider->store(ABI, dir.archive()));
+            Assert::IsTrue(provider->lookup(ABI) == CacheStatus::AVAILABLE);
+
+            provider->store_failure(ABI);
+            Assert::IsTrue(provider->lookup(ABI) == CacheStatus::AVAILABLE);
+        }
+
+        TEST_METHOD(directory_finds_archives_stored_by_others)
+        {
+            TestDirectory dir;
+            const auto reader = dir.provider("cache", Access::READ_WRITE);
+            const auto writer = dir.provider("cache", Access::READ_WRITE);
+
+            // The reader loads its index before the writer stores anything.
+            Assert::IsTrue(reader->lookup(ABI) == CacheStatus::MISSING);
+            Assert::IsTrue(writer->store(ABI, dir.archive()));
+
+            Assert::IsTrue(reader->lookup(ABI) == CacheStatus::AVAILABLE);
+            Assert::IsTrue(reader->fetch(ABI, dir.root / "scratch.zip").has_value());
+        }
+
+        TEST_METHOD(directory_read_only_writes_nothing)
+        {
+            TestDirectory dir;
+            Assert::IsTrue(dir.provider("cache", Access::READ_WRITE)->store(ABI, dir.archive()));
+
+            const auto provider = dir.provider("cache", Access::READ);
+            std::error_code ec;
+            dir.fs.remove(dir.root / "cache" / "index.txt", ec);
+
+            Assert::IsTrue(provider->lookup(ABI) == CacheStatus::AVAILABLE);
+            Assert::IsTrue(provider->lookup("cd" + ABI) == CacheStatus::MISSING);
+            Assert::IsFalse(dir.fs.exists(dir.root / "cache" / "index.txt"));
+        }
+
+        TEST_METHOD(fetch_copies_back_to_earlier_providers)
+        {
+            TestDirectory dir;
+            Assert::IsTrue(dir.provider("shared", Access::READ_WRITE)->store(ABI, dir.archive()));
+
+            BinaryProviders providers;
+            providers.providers.push_back(dir.provider("local", Access::READ_WRITE));
+            providers.providers.push_back(dir.provider("readonly", Access::READ));
+            providers.providers.push_back(dir.provider("shared", Access::READ));
+            providers.providers.push_back(dir.provider("later", Access::READ_WRITE));
+
+            Assert::IsTrue(providers.lookup(ABI) == CacheStatus::AVAILABLE);
+            auto maybe_result = providers.fetch(ABI, dir.root / "scratch.zip");
+            Assert::IsTrue(maybe_result.has_value());
+            Assert::AreEqual(providers.providers[2]->location(ABI), maybe_result.get()->location);
+
+            Assert::IsTrue(providers.providers[0]->lookup(ABI) == CacheStatus::AVAILABLE);
+            Assert::IsTrue(providers.providers[1]->lookup(ABI) == CacheStatus::MISSING);
+            Assert::IsTrue(providers.providers[3]->lookup(ABI) == CacheStatus::MISSING);
+
+            // The next fetch is answered by the local copy.
+            maybe_result = providers.fetch(ABI, dir.root / "scratch.zip");
+            Assert::IsTrue(maybe_result.has_value());
+            Assert::AreEqual(providers.providers[0]->location(ABI), maybe_result.get()->location);
+        }
+
+        TEST_METHOD(providers_store_to_every_writable_provider)
+        {
+            TestDirectory dir;
+            BinaryProviders providers;
+            providers.providers.push_back(dir.provider("local", Access::READ_WRITE));
+            providers.providers.push_back(dir.provider("readonly", Access::READ));
+            providers.providers.push_back(dir.provider("writeonly", Access::WRITE));
+
+            const auto locations = providers.store(ABI, dir.archive());
+            Assert::AreEqual(size_t(2), locations.size());
+            Assert::AreEqual(providers.providers[0]->location(ABI), locations[0]);
+            Assert::AreEqual(providers.providers[2]->location(ABI), locations[1]);
+
+            providers.store_failure("cd" + ABI);
+            Assert::IsTrue(providers.lookup("cd" + ABI) == CacheStatus::FAILED);
+            providers.clear_failure("cd" + ABI);
+            Assert::IsTrue(providers.lookup("cd" + ABI) == CacheStatus::MISSING);
+        }
+
+        TEST_METHOD(url_store_then_fetch)
+        {
+            TestDirectory dir;
+            const auto provider = dir.url_provider("remote", Access::READ_WRITE);
+            std::error_code ec;
+            dir.fs.create_directories(dir.root / "remote", ec);
+
+            Assert::IsTrue(provider->lookup(ABI) == CacheStatus::MISSING);
+            Assert::IsTrue(provider->store(ABI, dir.archive()));
+            Assert::IsTrue(provider->lookup(ABI) == CacheStatus::AVAILABLE);
+
+            const auto scratch = dir.root / "scratch" / "package.zip";
+            auto maybe_path = provider->fetch(ABI, scratch);
+            Assert::IsTrue(maybe_path.has_value());
+            Assert::AreEqual(scratch.u8string(), maybe_path.get()->u8string());
+            Assert::AreEqual(std::string("archive contents"),
+                             dir.fs.read_contents(scratch).value_or_exit(VCPKG_LINE_INFO));
+            Assert::IsFalse(provider->fetch("cd" + ABI, scratch).has_value());
+        }
+
+        TEST_METHOD(index_requires_header)
+        {
+            Assert::IsFalse(BinaryIndex::parse("").has_value());
+            Assert::IsFalse(BinaryIndex::parse("aa01 pass 12 101\n").has_value());
+            Assert::IsFalse(BinaryIndex::parse("vcpkg-binary-index-2 100\n").has_value());
+        }
+    };
+}
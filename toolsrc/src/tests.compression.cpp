@@ -0,0 +1,114 @@
+#include "tests.pch.h"
+
+#include <vcpkg/base/compression.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Compression = vcpkg::Compression;
+
+namespace UnitTest1
+{
+    class CompressionTests : public TestClass<CompressionTests>
+    {
+        static void check_round_trip(const std::string& input)
+        {
+            const auto data = reinterpret_cast<const unsigned char*>(input.data());
+            const auto compressed = Compression::deflate(data, input.size());
+            auto maybe_output = Compression::inflate(compressed.data(), compressed.size(), input.size());
+
+            Assert::IsTrue(maybe_output.has_value());
+            const auto& output = *maybe_output.get();
+            Assert::IsTrue(input == std::string(output.begin(), output.end()));
+        }
+
+        TEST_METHOD(crc32_check_value)
+        {
+            const std::string input = "123456789";
+            const auto crc = Compression::crc32(0, reinterpret_cast<const unsigned char*>(input.data()), input.size());
+
+            Assert::AreEqual(0xCBF43926u, crc);
+        }
+
+        TEST_METHOD(deflate_round_trip)
+        {
+            check_round_trip("");
+            check_round_trip("a");
+            check_round_trip(std::string(100000, 'x'));
+
+            std::string text;
+            for (int i = 0; i < 5000; ++i)
+                text += "Building package zlib[core]:x64-windows... " + std::to_string(i * 7919 % 1000) + "\n";
+            check_round_trip(text);
+
+            std::string noise;
+            uint32_t state = 1;
+            for (int i = 0; i < 200000; ++i)
+            {
+                state = state * 1103515245 + 12345;
+                noise.push_back(static_cast<char>(state >> 24));
+            }
+            check_round_trip(noise);
+        }
+
+        TEST_METHOD(stream_round_trip)
+        {
+            // Several MiB of alternating text and noise, so that both directions discard consumed input.
+            std::string input;
+            uint32_t state = 1;
+            for (int i = 0; input.size() < 6 * 1024 * 1024; ++i)
+            {
+                if (i % 2 == 0)
+                {
+                    for (int line = 0; line < 2000; ++line)
+                        input += "-- Installing: packages/zlib_x64-linux/include/zconf" + std::to_string(line % 97) +
+                                 ".h\n";
+                }
+                else
+                {
+                    for (int byte = 0; byte < 100000; ++byte)
+                    {
+                        state = state * 1103515245 + 12345;
+                        input.push_back(static_cast<char>(state >> 24));
+                    }
+                }
+            }
+
+            // Odd piece sizes, so matches and stored blocks straddle the pieces.
+            size_t offset = 0;
+            std::vector<unsigned char> compressed;
+            Compression::deflate_stream(
+                [&](unsigned char* buffer, size_t size) {
+                    const size_t length = std::min<size_t>({size, 9973, input.size() - offset});
+                    std::copy(input.begin() + offset, input.begin() + offset + length, buffer);
+                    offset += length;
+                    return length;
+                },
+                [&](const unsigned char* data, size_t size) { compressed.insert(compressed.end(), data, data + size); });
+            Assert::IsTrue(compressed.size() < input.size());
+
+            offset = 0;
+            std::string output;
+            auto maybe_size = Compression::inflate_stream(
+                [&](unsigned char* buffer, size_t size) {
+                    const size_t length = std::min<size_t>({size, 4099, compressed.size() - offset});
+                    std::copy(compressed.begin() + offset, compressed.begin() + offset + length, buffer);
+                    offset += length;
+                    return length;
+                },
+                [&](const unsigned char* data, size_t size) { output.append(reinterpret_cast<const char*>(data), size); });
+
+            Assert::IsTrue(maybe_size.has_value());
+            Assert::AreEqual<uint64_t>(input.size(), *maybe_size.get());
+            Assert::IsTrue(input == output);
+        }
+
+        TEST_METHOD(inflate_rejects_truncated_stream)
+        {
+            const std::string input(5000, 'z');
+            const auto compressed =
+                Compression::deflate(reinterpret_cast<const unsigned char*>(input.data()), input.size());
+
+            Assert::IsFalse(Compression::inflate(compressed.data(), compressed.size() / 2).has_value());
+        }
+    };
+}
@@ -0,0 +1,131 @@
+#include "tests.pch.h"
+
+#include <vcpkg/base/downloads.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+using namespace vcpkg;
+using namespace vcpkg::Downloads;
+
+namespace UnitTest1
+{
+    class DownloadsTests : public TestClass<DownloadsTests>
+    {
+        TEST_METHOD(response_headers_use_final_response)
+        {
+            const auto info = parse_response_headers("HTTP/1.1 302 Found\r\n"
+                                                     "Location: https://cdn.example.com/file.zip\r\n"
+                                                     "Content-Length: 0\r\n"
+                                                     "\r\n"
+                                                     "HTTP/2 200\r\n"
+                                                     "content-length: 104857600\r\n"
+                                                     "accept-ranges: bytes\r\n"
+                                                     "\r\n");
+            Assert::IsTrue(info.size.has_value());
+            Assert::AreEqual(std::uint64_t(104857600), *info.size.get());
+            Assert::IsTrue(info.accepts_ranges);
+        }
+
+        TEST_METHOD(response_headers_without_ranges)
+        {
+            const auto info = parse_response_headers("HTTP/1.1 200 OK\r\n"
+                                                     "Content-Length: 42\r\n"
+                                                     "Accept-Ranges: none\r\n");
+            Assert::AreEqual(std::uint64_t(42), *info.size.get());
+            Assert::IsFalse(info.accepts_ranges);
+        }
+
+        TEST_METHOD(partial_response_needs_content_range)
+        {
+            const auto partial = parse_response_headers("HTTP/1.1 206 Partial Content\r\n"
+                                                        "Content-Length: 100\r\n"
+                                                        "Content-Range: bytes 0-99/1000\r\n");
+            Assert::IsTrue(partial.is_partial);
+
+            const auto no_range = parse_response_headers("HTTP/1.1 206 Partial Content\r\n"
+                                                         "Content-Length: 100\r\n");
+            Assert::IsFalse(no_range.is_partial);
+
+            const auto whole = parse_response_headers("HTTP/1.1 200 OK\r\n"
+                                                      "Content-Length: 1000\r\n"
+                                                      "Content-Range: bytes 0-99/1000\r\n");
+            Assert::IsFalse(whole.is_partial);
+        }
+
+        TEST_METHOD(response_headers_of_error_are_ignored)
+        {
+            const auto info = parse_response_headers("HTTP/1.1 404 Not Found\r\n"
+                                                     "Content-Length: 9\r\n"
+                                                     "Accept-Ranges: bytes\r\n");
+            Assert::IsFalse(info.size.has_value());
+            Assert::IsFalse(info.accepts_ranges);
+        }
+
+        TEST_METHOD(small_files_are_not_split)
+        {
+            Assert::AreEqual(size_t(0), split_into_segments(0).size());
+
+            const auto segments = split_into_segments(1000);
+            Assert::AreEqual(size_t(1), segments.size());
+            Assert::AreEqual(std::uint64_t(0), segments[0].first);
+            Assert::AreEqual(std::uint64_t(999), segments[0].second);
+        }
+
+        TEST_METHOD(large_files_are_split_into_contiguous_ranges)
+        {
+            const std::uint64_t size = 1000 * 1024 * 1024 + 3;
+            const auto segments = split_into_segments(size);
+            Assert::AreEqual(size_t(4), segments.size());
+
+            std::uint64_t next = 0;
+            for (auto&& segment : segments)
+            {
+                Assert::AreEqual(next, segment.first);
+                Assert::IsTrue(segment.first <= segment.second);
+                next = segment.second + 1;
+            }
+            Assert::AreEqual(size, next);
+        }
+
+        TEST_METHOD(asset_sources_default_to_read)
+        {
+            auto maybe_sources = parse_asset_sources("files,mirror;;http,https://example.com/assets//,readwrite");
+            Assert::IsTrue(maybe_sources.has_value());
+
+            auto& sources = *maybe_sources.get();
+            Assert::AreEqual(size_t(2), sources.size());
+
+            Assert::IsTrue(sources[0].kind == AssetSource::Kind::FILES);
+            Assert::IsTrue(sources[0].can_read);
+            Assert::IsFalse(sources[0].can_write);
+            Assert::AreEqual((fs::u8path("mirror") / "abc").u8string(), sources[0].location_of("abc"));
+
+            Assert::IsTrue(sources[1].kind == AssetSource::Kind::HTTP);
+            Assert::IsTrue(sources[1].can_read);
+            Assert::IsTrue(sources[1].can_write);
+            Assert::AreEqual(std::string("https://example.com/assets/abc"), sources[1].location_of("abc"));
+        }
+
+        TEST_METHOD(asset_sources_round_trip)
+        {
+            const std::string text = "files,mirror,read;http,https://example.com,write;files,shared,readwrite";
+            auto maybe_sources = parse_asset_sources(text);
+            Assert::IsTrue(maybe_sources.has_value());
+
+            const auto formatted = Strings::join(
+                ";", *maybe_sources.get(), [](const AssetSource& source) { return source.to_string(); });
+            Assert::AreEqual(text, formatted);
+        }
+
+        TEST_METHOD(invalid_asset_sources)
+        {
+            Assert::IsFalse(parse_asset_sources("files").has_value());
+            Assert::IsFalse(parse_asset_sources("files,").has_value());
+            Assert::IsFalse(parse_asset_sources("http,/").has_value());
+            Assert::IsFalse(parse_asset_sources("http,//,read").has_value());
+            Assert::IsFalse(parse_asset_sources("ftp,example.com").has_value());
+            Assert::IsFalse(parse_asset_sources("files,mirror,readonly").has_value());
+            Assert::IsFalse(parse_asset_sources("files,mirror,read,extra").has_value());
+        }
+    };
+}
@@ -0,0 +1,95 @@
+#include "tests.pch.h"
+
+#include <vcpkg/base/hash.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Hash = vcpkg::Hash;
+
+namespace UnitTest1
+{
+    class HashTests : public TestClass<HashTests>
+    {
+        TEST_METHOD(sha_empty_string)
+        {
+            Assert::AreEqual("da39a3ee5e6b4b0d3255bfef95601890afd80709", Hash::get_string_hash("", "SHA1").c_str());
+            Assert::AreEqual("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",
+                             Hash::get_string_hash("", "SHA256").c_str());
+            Assert::AreEqual("cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce47d0d13c5d85f2b0ff8318d2877e"
+                             "ec2f63b931bd47417a81a538327af927da3e",
+                             Hash::get_string_hash("", "SHA512").c_str());
+        }
+
+        TEST_METHOD(sha_abc)
+        {
+            Assert::AreEqual("a9993e364706816aba3e25717850c26c9cd0d89d", Hash::get_string_hash("abc", "SHA1").c_str());
+            Assert::AreEqual("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+                             Hash::get_string_hash("abc", "sha256").c_str());
+            Assert::AreEqual("cb00753f45a35e8bb5a03d699ac65007272c32ab0eded1631a8b605a43ff5bed8086072ba1e7cc2358baeca134c8"
+                             "25a7",
+                             Hash::get_string_hash("abc", "SHA384").c_str());
+            Assert::AreEqual("ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a2192992a274fc1a836ba3c23a3fe"
+                             "ebbd454d4423643ce80e2a9ac94fa54ca49f",
+                             Hash::get_string_hash("abc", "SHA512").c_str());
+        }
+
+        TEST_METHOD(sha_448_bit_message)
+        {
+            // Two blocks for SHA-1/SHA-256 once padded, one for SHA-384/SHA-512.
+            const std::string input = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+
+            Assert::AreEqual("84983e441c3bd26ebaae4aa1f95129e5e54670f1", Hash::get_string_hash(input, "SHA1").c_str());
+            Assert::AreEqual("248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1",
+                             Hash::get_string_hash(input, "SHA256").c_str());
+            Assert::AreEqual("3391fdddfc8dc7393707a65b1b4709397cf8b1d162af05abfe8f450de5f36bc6b0455a8520bc4e6f5fe95b1fe3c8"
+                             "452b",
+                             Hash::get_string_hash(input, "SHA384").c_str());
+            Assert::AreEqual("204a8fc6dda82f0a0ced7beb8e08a41657c16ef468b228a8279be331a703c33596fd15c13b1b07f9aa1d3bea5778"
+                             "9ca031ad85c7a71dd70354ec631238ca3445",
+                             Hash::get_string_hash(input, "SHA512").c_str());
+        }
+
+        TEST_METHOD(sha_one_million_a)
+        {
+            // Fed in pieces that are not a multiple of the block size, so both the buffered and the bulk paths run.
+            const std::string piece(1000, 'a');
+            const std::pair<Hash::Algorithm, const char*> expected[] = {
+                {Hash::Algorithm::SHA1, "34aa973cd4c4daa4f61eeb2bdbad27316534016f"},
+                {Hash::Algorithm::SHA256, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"},
+                {Hash::Algorithm::SHA384,
+                 "9d0e1809716474cb086e834e310a4a1ced149e9c00f248527972cec5704c2a5b07b8b3dc38ecc4ebae97ddd87f3d8985"},
+                {Hash::Algorithm::SHA512,
+                 "e718483d0ce769644e2e42c7bc15b4638e1f98b13b2044285632a803afa973ebde0ff244877ea60a4cb0432ce577c31beb009c5c"
+                 "2c49aa2e4eadb217ad8cc09b"},
+            };
+
+            for (auto&& test : expected)
+            {
+                auto hasher = Hash::get_hasher_for(test.first);
+                for (int i = 0; i < 1000; ++i)
+                    hasher->add_bytes(piece.data(), piece.data() + piece.size());
+
+                Assert::AreEqual(test.second, hasher->get_hash().c_str());
+            }
+        }
+
+        TEST_METHOD(sha_incremental_matches_one_shot)
+        {
+            // Spans several blocks and leaves no room for the length trailer in the last SHA-1/SHA-256 block.
+            const std::string input(64 * 6 + 56, 'a');
+
+            for (auto algo : {Hash::Algorithm::SHA1, Hash::Algorithm::SHA256, Hash::Algorithm::SHA512})
+            {
+                auto hasher = Hash::get_hasher_for(algo);
+                for (size_t i = 0; i < input.size(); i += 13)
+                {
+                    const size_t last = std::min(i + 13, input.size());
+                    hasher->add_bytes(input.data() + i, input.data() + last);
+                }
+
+                Assert::AreEqual(Hash::get_bytes_hash(input.data(), input.data() + input.size(), algo).c_str(),
+                                 hasher->get_hash().c_str());
+            }
+        }
+    };
+}
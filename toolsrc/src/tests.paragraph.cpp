@@ -364,6 +364,27 @@ namespace UnitTest1
             Assert::AreEqual("v1", pghs[0]["f1"].c_str());
         }
 
+        TEST_METHOD(parse_paragraph_views_multiline_fields)
+        {
+            std::string text = "f2: first\r\n"
+                               " second\r\n"
+                               "  third\r\n"
+                               "f1: v1\r\n"
+                               "\r\n"
+                               "f3: v3";
+            auto pghs = vcpkg::Paragraphs::parse_paragraph_views(text);
+            Assert::AreEqual(size_t(2), pghs.size());
+            Assert::AreEqual(size_t(2), pghs[0].size());
+            Assert::AreEqual("f2", std::string(pghs[0][0].first).c_str());
+            Assert::AreEqual("first\n second\n  third", std::string(pghs[0][0].second).c_str());
+            Assert::AreEqual("f1", std::string(pghs[0][1].first).c_str());
+            Assert::AreEqual("v1", std::string(pghs[0][1].second).c_str());
+            Assert::AreEqual(size_t(1), pghs[1].size());
+            Assert::AreEqual("v3", std::string(pghs[1][0].second).c_str());
+            Assert::IsTrue(pghs[1][0].second.data() >= text.data() &&
+                           pghs[1][0].second.data() < text.data() + text.size());
+        }
+
         TEST_METHOD(BinaryParagraph_serialize_min)
         {
             vcpkg::BinaryParagraph pgh({
@@ -111,5 +111,51 @@ Status: install ok installed
             auto it = status_db.find_installed({unsafe_pspec("ffmpeg", Triplet::X64_WINDOWS), "openssl"});
             Assert::IsTrue(it != status_db.end());
         }
+        TEST_METHOD(insert_replaces_indexed_paragraph)
+        {
+            auto pghs = parse_paragraphs(R"(
+Package: ffmpeg
+Version: 3.3.3
+Architecture: x64-windows
+Multi-Arch: same
+Description:
+Status: install ok installed
+
+Package: zlib
+Version: 1.2.11
+Architecture: x64-windows
+Multi-Arch: same
+Description:
+Status: install ok installed
+)");
+            Assert::IsTrue(!!pghs);
+            if (!pghs) return;
+
+            StatusParagraphs status_db(Util::fmap(
+                *pghs.get(), [](RawParagraph& rpgh) { return std::make_unique<StatusParagraph>(std::move(rpgh)); }));
+
+            auto update = parse_single_paragraph(R"(
+Package: ffmpeg
+Version: 3.3.3
+Architecture: x64-windows
+Multi-Arch: same
+Description:
+Status: purge ok not-installed
+)");
+            Assert::IsTrue(!!update);
+            if (!update) return;
+
+            status_db.insert(std::make_unique<StatusParagraph>(std::move(*update.get())));
+
+            Assert::IsFalse(status_db.is_installed(unsafe_pspec("ffmpeg", Triplet::X64_WINDOWS)));
+            Assert::IsTrue(status_db.is_installed(unsafe_pspec("zlib", Triplet::X64_WINDOWS)));
+            Assert::IsTrue(status_db.find(unsafe_pspec("zlib", Triplet::X86_WINDOWS)) == status_db.end());
+
+            // Replacing a paragraph keeps its position; iteration is newest first.
+            Assert::AreEqual(size_t(2), size_t(std::distance(status_db.begin(), status_db.end())));
+            Assert::AreEqual("zlib", (*status_db.begin())->package.spec.name().c_str());
+            auto ffmpeg = status_db.find(unsafe_pspec("ffmpeg", Triplet::X64_WINDOWS));
+            Assert::IsTrue(ffmpeg == std::next(status_db.begin()));
+        }
     };
 }
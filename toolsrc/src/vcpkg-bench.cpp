@@ -0,0 +1,351 @@
+#include "pch.h"
+
+#include <vcpkg/base/chrono.h>
+#include <vcpkg/base/files.h>
+#include <vcpkg/base/graphs.h>
+#include <vcpkg/base/strings.h>
+#include <vcpkg/base/system.h>
+#include <vcpkg/dependencies.h>
+#include <vcpkg/install.h>
+#include <vcpkg/metrics.h>
+#include <vcpkg/paragraphs.h>
+#include <vcpkg/vcpkglib.h>
+#include <vcpkg/vcpkgpaths.h>
+
+#include <numeric>
+
+// Times the parts of vcpkg whose cost grows with the size of the ports tree and of the installed tree, against
+// generated trees of increasing size, and writes the results as JSON so that scaling regressions can be tracked.
+//
+// Usage: vcpkg-bench [--ports=1000,5000,20000] [--iterations=5] [--seed=1] [--work-dir=<dir>] [--output=<file>]
+
+using namespace vcpkg;
+
+namespace
+{
+    const char* const TRIPLET = "x64-linux";
+
+    struct Options
+    {
+        std::vector<size_t> port_counts = {1000, 5000, 20000};
+        size_t iterations = 5;
+        unsigned seed = 1;
+        fs::path work_dir = fs::stdfs::temp_directory_path() / "vcpkg-bench";
+        fs::path output = "vcpkg-bench.json";
+    };
+
+    Options parse_options(const int argc, const char* const* const argv)
+    {
+        Options options;
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string arg = argv[i];
+            const auto eq_pos = arg.find('=');
+            const std::string name = arg.substr(0, eq_pos);
+            const std::string value = eq_pos == std::string::npos ? std::string() : arg.substr(eq_pos + 1);
+            Checks::check_exit(VCPKG_LINE_INFO, !value.empty(), "Expected a value: %s", arg);
+
+            if (name == "--ports")
+                options.port_counts = Util::fmap(Strings::split(value, ","), [](const std::string& count) -> size_t {
+                    return std::stoul(count);
+                });
+            else if (name == "--iterations")
+                options.iterations = std::max<size_t>(1, std::stoul(value));
+            else if (name == "--seed")
+                options.seed = static_cast<unsigned>(std::stoul(value));
+            else if (name == "--work-dir")
+                options.work_dir = fs::u8path(value);
+            else if (name == "--output")
+                options.output = fs::u8path(value);
+            else
+                Checks::exit_with_message(VCPKG_LINE_INFO, "Unknown option: %s", arg);
+        }
+        return options;
+    }
+
+    // Ports only depend on ports generated before them, so the graph is acyclic and every prefix of the ports is
+    // closed under dependencies.
+    struct SyntheticPort
+    {
+        std::string name;
+        std::vector<size_t> depends;
+        std::vector<std::vector<size_t>> features;
+        bool default_feature;
+        size_t file_count;
+    };
+
+    std::vector<SyntheticPort> generate_ports(const size_t count, const unsigned seed)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        std::geometric_distribution<size_t> dependency_count(0.35);
+        std::discrete_distribution<size_t> feature_count({60, 25, 10, 5});
+        std::geometric_distribution<size_t> extra_files(0.03);
+        std::bernoulli_distribution has_default_feature(0.3);
+
+        // Squaring the uniform sample favors early ports, which become the widely used libraries (zlib and the like)
+        // that real trees have.
+        const auto pick_dependencies = [&](const size_t index, const size_t wanted) {
+            std::vector<size_t> picked;
+            for (size_t attempt = 0; index > 0 && picked.size() < std::min(wanted, index) && attempt < wanted * 4;
+                 ++attempt)
+            {
+                const double u = uniform(rng);
+                const auto dependency = static_cast<size_t>(static_cast<double>(index) * u * u);
+                if (std::find(picked.begin(), picked.end(), dependency) == picked.end()) picked.push_back(dependency);
+            }
+            return picked;
+        };
+
+        std::vector<SyntheticPort> ports(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            auto& port = ports[i];
+            port.name = Strings::format("port%05zu", i);
+            port.depends = pick_dependencies(i, std::min<size_t>(dependency_count(rng), 12));
+            port.features.resize(feature_count(rng));
+            for (auto&& feature : port.features)
+                feature = pick_dependencies(i, 1 + (uniform(rng) < 0.3 ? 1 : 0));
+            port.default_feature = !port.features.empty() && has_default_feature(rng);
+            port.file_count = 5 + std::min<size_t>(extra_files(rng), 400);
+        }
+        return ports;
+    }
+
+    std::string join_names(const std::vector<SyntheticPort>& ports, const std::vector<size_t>& indices)
+    {
+        return Strings::join(", ", indices, [&](const size_t index) { return ports[index].name; });
+    }
+
+    std::vector<std::string> make_listfile(const SyntheticPort& port)
+    {
+        const std::string include_dir = Strings::format("%s/include/%s/", TRIPLET, port.name);
+        std::vector<std::string> lines = {
+            Strings::format("%s/", TRIPLET), Strings::format("%s/include/", TRIPLET), include_dir};
+        for (size_t i = 0; i < port.file_count; ++i)
+            lines.push_back(Strings::format("%sh%zu.h", include_dir, i));
+        return lines;
+    }
+
+    void write_ports_tree(Files::Filesystem& fs, const VcpkgPaths& paths, const std::vector<SyntheticPort>& ports)
+    {
+        std::error_code ec;
+        for (auto&& port : ports)
+        {
+            std::string control = Strings::format(
+                "Source: %s\nVersion: 1.0\nDescription: Synthetic port %s\n", port.name, port.name);
+            if (!port.depends.empty()) control += "Build-Depends: " + join_names(ports, port.depends) + "\n";
+            if (port.default_feature) control += "Default-Features: f0\n";
+            for (size_t f = 0; f < port.features.size(); ++f)
+            {
+                control += Strings::format("\nFeature: f%zu\nDescription: Synthetic feature\n", f);
+                if (!port.features[f].empty())
+                    control += "Build-Depends: " + join_names(ports, port.features[f]) + "\n";
+            }
+
+            const fs::path port_dir = paths.ports / port.name;
+            fs.create_directories(port_dir, ec);
+            fs.write_contents(port_dir / "CONTROL", control);
+        }
+    }
+
+    // The first half of the ports are installed, with their default features. Their listfiles are written, but not
+    // the files themselves.
+    size_t write_installed_tree(Files::Filesystem& fs, const VcpkgPaths& paths, const std::vector<SyntheticPort>& ports)
+    {
+        std::error_code ec;
+        fs.create_directories(paths.vcpkg_dir_info, ec);
+
+        const size_t installed_count = ports.size() / 2;
+        std::string status;
+        for (size_t i = 0; i < installed_count; ++i)
+        {
+            const auto& port = ports[i];
+            status += Strings::format("Package: %s\nVersion: 1.0\nArchitecture: %s\nMulti-Arch: same\n"
+                                      "Description: Synthetic port %s\n",
+                                      port.name,
+                                      TRIPLET,
+                                      port.name);
+            if (!port.depends.empty()) status += "Depends: " + join_names(ports, port.depends) + "\n";
+            if (port.default_feature) status += "Default-Features: f0\n";
+            status += "Status: install ok installed\n\n";
+
+            if (port.default_feature)
+            {
+                status += Strings::format("Package: %s\nFeature: f0\nArchitecture: %s\nMulti-Arch: same\n"
+                                          "Description: Synthetic feature\n",
+                                          port.name,
+                                          TRIPLET);
+                if (!port.features[0].empty()) status += "Depends: " + join_names(ports, port.features[0]) + "\n";
+                status += "Status: install ok installed\n\n";
+            }
+
+            fs.write_lines(paths.vcpkg_dir_info / Strings::format("%s_1.0_%s.list", port.name, TRIPLET),
+                           make_listfile(port));
+        }
+        fs.write_contents(paths.vcpkg_dir_status_file, status);
+        return installed_count;
+    }
+
+    // A built package of the last port, which is not installed, with a header that the first port already installed.
+    PackageSpec write_conflicting_package(Files::Filesystem& fs,
+                                          const VcpkgPaths& paths,
+                                          const std::vector<SyntheticPort>& ports)
+    {
+        const auto& port = ports.back();
+        const PackageSpec spec =
+            PackageSpec::from_name_and_triplet(port.name, Triplet::from_canonical_name(TRIPLET))
+                .value_or_exit(VCPKG_LINE_INFO);
+        const fs::path package_dir = paths.package_dir(spec);
+
+        std::error_code ec;
+        fs.create_directories(package_dir / "include" / port.name, ec);
+        fs.create_directories(package_dir / "include" / ports.front().name, ec);
+        fs.write_contents(package_dir / "CONTROL",
+                          Strings::format("Package: %s\nVersion: 1.0\nArchitecture: %s\nMulti-Arch: same\n",
+                                          port.name,
+                                          TRIPLET));
+        for (size_t i = 0; i < port.file_count; ++i)
+            fs.write_contents(package_dir / "include" / port.name / Strings::format("h%zu.h", i), "");
+        fs.write_contents(package_dir / "include" / ports.front().name / "h0.h", "");
+        return spec;
+    }
+
+    struct PortIndexGraph final : Graphs::AdjacencyProvider<size_t, size_t>
+    {
+        explicit PortIndexGraph(const std::vector<SyntheticPort>& ports) : ports(ports) {}
+
+        std::vector<size_t> adjacency_list(const size_t& vertex) const override { return ports[vertex].depends; }
+        std::string to_string(const size_t& vertex) const override { return ports[vertex].name; }
+        size_t load_vertex_data(const size_t& vertex) const override { return vertex; }
+
+        const std::vector<SyntheticPort>& ports;
+    };
+
+    struct Result
+    {
+        std::string name;
+        size_t ports;
+        std::vector<double> microseconds;
+    };
+
+    template<class F>
+    Result measure(const std::string& name, const size_t ports, const size_t iterations, F&& f)
+    {
+        Result result{name, ports, {}};
+        for (size_t i = 0; i < iterations; ++i)
+        {
+            // Anything the measured code prints is captured and dropped, so the console is not part of the timing.
+            const System::OutputBuffer discarded_output;
+            const auto timer = Chrono::ElapsedTimer::create_started();
+            f();
+            result.microseconds.push_back(timer.microseconds());
+        }
+        System::println("%-30s %6zu ports: first %10.0f us", name, ports, result.microseconds.front());
+        return result;
+    }
+
+    std::string to_json(const std::vector<Result>& results)
+    {
+        std::string json = "{\"benchmarks\":[\n";
+        for (auto&& result : results)
+        {
+            auto sorted = result.microseconds;
+            Util::sort(sorted);
+            json += Strings::format(R"({"name":"%s","ports":%zu,"iterations":%zu,)"
+                                    R"("first_us":%.0f,"min_us":%.0f,"median_us":%.0f,"max_us":%.0f},)"
+                                    "\n",
+                                    result.name,
+                                    result.ports,
+                                    sorted.size(),
+                                    result.microseconds.front(),
+                                    sorted.front(),
+                                    (sorted[(sorted.size() - 1) / 2] + sorted[sorted.size() / 2]) / 2,
+                                    sorted.back());
+        }
+        if (!results.empty()) json.resize(json.size() - 2);
+        json += "\n]}\n";
+        return json;
+    }
+
+    std::vector<Result> run_benchmarks(const Options& options, const size_t port_count)
+    {
+        auto& fs = Files::get_real_filesystem();
+        const fs::path root = options.work_dir / std::to_string(port_count);
+        std::error_code ec;
+        fs.remove_all(root, ec);
+        fs.create_directories(root, ec);
+        const VcpkgPaths paths = VcpkgPaths::create(root, "").value_or_exit(VCPKG_LINE_INFO);
+
+        const auto ports = generate_ports(port_count, options.seed);
+        write_ports_tree(fs, paths, ports);
+        const size_t installed_count = write_installed_tree(fs, paths, ports);
+        const PackageSpec conflicting_spec = write_conflicting_package(fs, paths, ports);
+
+        const size_t n = options.iterations;
+        std::vector<Result> results;
+
+        results.push_back(measure(
+            "try_load_all_ports", port_count, n, [&] { Paragraphs::try_load_all_ports(fs, paths.ports); }));
+        // The first iteration writes the ports snapshot that the following ones read.
+        results.push_back(measure(
+            "try_load_all_ports_snapshot", port_count, n, [&] { Paragraphs::try_load_all_ports(paths); }));
+
+        StatusParagraphs status_db;
+        results.push_back(
+            measure("database_load_check", port_count, n, [&] { status_db = database_load_check(paths); }));
+        Checks::check_exit(VCPKG_LINE_INFO, get_installed_ports(status_db).size() == installed_count);
+
+        results.push_back(
+            measure("get_installed_files", port_count, n, [&] { get_installed_files(paths, status_db); }));
+
+        std::unordered_map<std::string, SourceControlFile> port_map;
+        for (auto&& scf : Paragraphs::try_load_all_ports(fs, paths.ports).paragraphs)
+        {
+            auto name = scf->core_paragraph->name;
+            port_map.emplace(std::move(name), std::move(*scf));
+        }
+        const auto all_features = Util::fmap(ports, [](const SyntheticPort& port) {
+            return FeatureSpec(PackageSpec::from_name_and_triplet(port.name, Triplet::from_canonical_name(TRIPLET))
+                                   .value_or_exit(VCPKG_LINE_INFO),
+                               "");
+        });
+        results.push_back(measure("create_feature_install_plan", port_count, n, [&] {
+            Dependencies::create_feature_install_plan(port_map, all_features, status_db);
+        }));
+
+        // The installed file index lives in status_db, so the first iteration measures loading it from the listfiles and
+        // the following ones only the lookups.
+        const auto bcf = Paragraphs::try_load_cached_package(paths, conflicting_spec).value_or_exit(VCPKG_LINE_INFO);
+        results.push_back(measure("install_package_conflicts", port_count, n, [&] {
+            const auto result = Install::install_package(paths, bcf, &status_db);
+            Checks::check_exit(VCPKG_LINE_INFO, result == Install::InstallResult::FILE_CONFLICTS);
+        }));
+
+        std::vector<size_t> all_vertices(ports.size());
+        std::iota(all_vertices.begin(), all_vertices.end(), size_t(0));
+        const PortIndexGraph graph(ports);
+        results.push_back(measure(
+            "topological_sort", port_count, n, [&] { Graphs::topological_sort(all_vertices, graph); }));
+
+        fs.remove_all(root, ec);
+        return results;
+    }
+}
+
+int main(const int argc, const char* const* const argv)
+{
+    Metrics::g_metrics.lock()->set_send_metrics(false);
+
+    const Options options = parse_options(argc, argv);
+
+    std::vector<Result> results;
+    for (const size_t port_count : options.port_counts)
+    {
+        Util::Vectors::concatenate(&results, run_benchmarks(options, port_count));
+    }
+
+    Files::get_real_filesystem().write_contents(options.output, to_json(results));
+    System::println("Results written to %s", options.output.u8string());
+    return 0;
+}
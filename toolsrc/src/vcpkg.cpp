@@ -12,8 +12,11 @@
 
 #include <vcpkg/base/chrono.h>
 #include <vcpkg/base/files.h>
+#include <vcpkg/base/hash.h>
+#include <vcpkg/base/stats.h>
 #include <vcpkg/base/strings.h>
 #include <vcpkg/base/system.h>
+#include <vcpkg/base/trace.h>
 #include <vcpkg/commands.h>
 #include <vcpkg/globalstate.h>
 #include <vcpkg/help.h>
@@ -119,6 +122,8 @@ static void inner(const VcpkgCmdArguments& args)
 #endif
     Checks::check_exit(VCPKG_LINE_INFO, exit_code == 0, "Changing the working dir failed");
 
+    Hash::enable_file_hash_cache(paths.get_filesystem(), paths.file_hash_cache);
+
     if (args.command == "install" || args.command == "remove" || args.command == "export" || args.command == "update")
     {
         Commands::Version::warn_if_vcpkg_version_mismatch(paths);
@@ -294,6 +299,7 @@ int main(const int argc, const char* const* const argv)
     {
         auto flags = Strings::split(*v, ",");
         if (std::find(flags.begin(), flags.end(), "binarycaching") != flags.end()) GlobalState::g_binary_caching = true;
+        if (std::find(flags.begin(), flags.end(), "tripletcache") != flags.end()) GlobalState::g_triplet_cache = true;
     }
 
     const VcpkgCmdArguments args = VcpkgCmdArguments::create_from_command_line(argc, argv);
@@ -304,6 +310,8 @@ int main(const int argc, const char* const* const argv)
     if (const auto p = args.printmetrics.get()) Metrics::g_metrics.lock()->set_print_metrics(*p);
     if (const auto p = args.sendmetrics.get()) Metrics::g_metrics.lock()->set_send_metrics(*p);
     if (const auto p = args.debug.get()) GlobalState::debugging = *p;
+    if (const auto p = args.trace_file.get()) Trace::start(fs::u8path(*p));
+    if (const auto p = args.stats.get()) Stats::set_enabled(*p);
 
     if (GlobalState::debugging)
     {
@@ -1,10 +1,1065 @@
 #include "pch.h"
 
 #include <vcpkg/archives.h>
+#include <vcpkg/base/compression.h>
+#include <vcpkg/base/trace.h>
+#include <vcpkg/base/util.h>
 #include <vcpkg/commands.h>
 
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace vcpkg::Archives
 {
+    namespace
+    {
+        constexpr uint32_t ZIP_LOCAL_HEADER_SIGNATURE = 0x04034b50;
+        constexpr uint32_t ZIP_CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+        constexpr uint32_t ZIP_END_OF_CENTRAL_DIRECTORY_SIGNATURE = 0x06054b50;
+        constexpr uint32_t ZIP64_END_OF_CENTRAL_DIRECTORY_SIGNATURE = 0x06064b50;
+        constexpr uint32_t ZIP64_LOCATOR_SIGNATURE = 0x07064b50;
+        constexpr uint16_t ZIP64_EXTRA_FIELD_ID = 0x0001;
+        constexpr uint64_t ZIP32_LIMIT = 0xFFFFFFFF;
+
+        constexpr uint16_t ZIP_METHOD_STORED = 0;
+        constexpr uint16_t ZIP_METHOD_DEFLATED = 8;
+        constexpr uint16_t ZIP_FLAG_ENCRYPTED = 0x0001;
+        constexpr uint16_t ZIP_FLAG_UTF8 = 0x0800;
+        constexpr uint16_t ZIP_VERSION = 20;
+        constexpr uint16_t ZIP64_VERSION = 45;
+        constexpr uint16_t ZIP_HOST_UNIX = 3;
+
+        constexpr uint32_t UNIX_TYPE_MASK = 0170000;
+        constexpr uint32_t UNIX_SYMLINK = 0120000;
+        constexpr uint32_t UNIX_REGULAR = 0100000;
+        constexpr uint32_t UNIX_DIRECTORY = 0040000;
+
+        constexpr size_t IO_CHUNK_SIZE = 64 * 1024;
+        constexpr uint64_t SPOOL_SIZE = 4 * 1024 * 1024;
+
+        void put_u16(std::string& out, uint64_t value)
+        {
+            out.push_back(static_cast<char>(value));
+            out.push_back(static_cast<char>(value >> 8));
+        }
+
+        void put_u32(std::string& out, uint64_t value)
+        {
+            put_u16(out, value);
+            put_u16(out, value >> 16);
+        }
+
+        void put_u64(std::string& out, uint64_t value)
+        {
+            put_u32(out, value);
+            put_u32(out, value >> 32);
+        }
+
+        uint16_t get_u16(const char* p)
+        {
+            const auto bytes = reinterpret_cast<const unsigned char*>(p);
+            return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+        }
+
+        uint32_t get_u32(const char* p) { return get_u16(p) | (static_cast<uint32_t>(get_u16(p + 2)) << 16); }
+
+        uint64_t get_u64(const char* p) { return get_u32(p) | (static_cast<uint64_t>(get_u32(p + 4)) << 32); }
+
+        struct ZipEntry
+        {
+            std::string name;
+            uint16_t flags = 0;
+            uint16_t method = ZIP_METHOD_STORED;
+            uint32_t crc = 0;
+            uint64_t compressed_size = 0;
+            uint64_t size = 0;
+            uint64_t local_header_offset = 0;
+            // Unix st_mode of the entry, or 0 if the archive was not created on a Unix host.
+            uint32_t mode = 0;
+
+            bool is_directory() const { return !name.empty() && name.back() == '/'; }
+            bool is_symlink() const { return (mode & UNIX_TYPE_MASK) == UNIX_SYMLINK; }
+        };
+
+        uint32_t get_unix_mode(const fs::path& path, const bool is_directory)
+        {
+#if !defined(_WIN32)
+            struct stat info;
+            if (::lstat(path.c_str(), &info) == 0) return static_cast<uint32_t>(info.st_mode);
+#else
+            Util::unused(path);
+#endif
+            return is_directory ? UNIX_DIRECTORY | 0755 : UNIX_REGULAR | 0644;
+        }
+
+        void set_unix_mode(const fs::path& path, const uint32_t mode)
+        {
+#if !defined(_WIN32)
+            if ((mode & 07777) != 0) ::chmod(path.c_str(), mode & 07777);
+#else
+            Util::unused(path);
+            Util::unused(mode);
+#endif
+        }
+
+        bool create_symlink(const std::string& target, const fs::path& path)
+        {
+#if !defined(_WIN32)
+            ::unlink(path.c_str());
+            return ::symlink(target.c_str(), path.c_str()) == 0;
+#else
+            Util::unused(target);
+            Util::unused(path);
+            return false;
+#endif
+        }
+
+        bool write_file(const fs::path& path, const char* data, const size_t size)
+        {
+            std::fstream output(path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+            output.write(data, size);
+            output.close();
+            return !output.fail();
+        }
+
+        std::string read_at(std::fstream& input, const uint64_t offset, const uint64_t size)
+        {
+            std::string result;
+            input.clear();
+            input.seekg(offset);
+            if (!input) return result;
+            result.resize(static_cast<size_t>(size));
+            input.read(&result[0], size);
+            result.resize(static_cast<size_t>(input.gcount()));
+            return result;
+        }
+
+        /// <summary>
+        /// Rejects entry names which would escape the destination directory.
+        /// </summary>
+        Optional<std::string> sanitize_entry_name(std::string name)
+        {
+            std::replace(name.begin(), name.end(), '\\', '/');
+            while (name.compare(0, 2, "./") == 0)
+                name.erase(0, 2);
+            if (name.empty() || name[0] == '/' || name.find(':') != std::string::npos) return nullopt;
+
+            for (auto&& component : Strings::split(name, "/"))
+            {
+                if (component == "..") return nullopt;
+            }
+            return std::move(name);
+        }
+
+        // Like the usual limit on symlinks followed while resolving one path.
+        constexpr int MAX_SYMLINK_HOPS = 40;
+
+        /// <summary>
+        /// Resolves `link` against `directory`, given as its components below `to_path`, following the symlinks that
+        /// already exist there, and leaves the result in `directory`. Returns false if the path leaves `to_path` at
+        /// any point.
+        /// </summary>
+        bool resolve_inside(Files::Filesystem& fs,
+                            const fs::path& to_path,
+                            std::vector<std::string>& directory,
+                            std::string link,
+                            int& hops)
+        {
+            std::replace(link.begin(), link.end(), '\\', '/');
+            if (link.empty() || link[0] == '/' || link.find(':') != std::string::npos) return false;
+
+            std::error_code ec;
+            for (auto&& component : Strings::split(link, "/"))
+            {
+                if (component.empty() || component == ".") continue;
+                if (component == "..")
+                {
+                    if (directory.empty()) return false;
+                    directory.pop_back();
+                    continue;
+                }
+
+                directory.push_back(component);
+                const fs::path path = to_path / fs::u8path(Strings::join("/", directory));
+                if (!fs::is_symlink(fs.symlink_status(path, ec))) continue;
+
+                if (++hops > MAX_SYMLINK_HOPS) return false;
+                const auto target = fs::stdfs::read_symlink(path, ec).u8string();
+                if (ec) return false;
+                directory.pop_back();
+                if (!resolve_inside(fs, to_path, directory, target, hops)) return false;
+            }
+            return true;
+        }
+
+        /// <summary>
+        /// Checks that a symlink named `name` (already sanitized) may point at `link` without leaving the
+        /// destination directory, following the symlinks already created there, and that no existing parent of it
+        /// below `to_path` is itself a symlink.
+        /// </summary>
+        bool is_safe_symlink(Files::Filesystem& fs, const fs::path& to_path, const std::string& name, std::string link)
+        {
+            std::vector<std::string> components = Strings::split(name, "/");
+            components.pop_back();
+
+            fs::path parent = to_path;
+            std::error_code ec;
+            for (auto&& component : components)
+            {
+                parent /= fs::u8path(component);
+                if (fs::is_symlink(fs.symlink_status(parent, ec))) return false;
+            }
+
+            int hops = 0;
+            return resolve_inside(fs, to_path, components, std::move(link), hops);
+        }
+
+        /// <summary>
+        /// Checks every symlink of `links` (names and targets) once they all exist, since one created later can
+        /// change where an earlier one leads. If any leads outside the destination, all of them are removed and the
+        /// tool exits.
+        /// </summary>
+        void check_created_symlinks(Files::Filesystem& fs,
+                                    const fs::path& to_path,
+                                    const fs::path& archive_path,
+                                    const std::vector<std::pair<std::string, std::string>>& links)
+        {
+            const auto unsafe = Util::find_if(links, [&](const std::pair<std::string, std::string>& link) {
+                return !is_safe_symlink(fs, to_path, link.first, link.second);
+            });
+            if (unsafe == links.end()) return;
+
+            std::error_code ec;
+            for (auto&& link : links)
+            {
+                const fs::path path = to_path / fs::u8path(link.first);
+                if (fs::is_symlink(fs.symlink_status(path, ec))) fs.remove(path, ec);
+            }
+            Checks::exit_with_message(VCPKG_LINE_INFO,
+                                      "Refusing to extract %s from %s: link target %s is outside the destination",
+                                      unsafe->first,
+                                      archive_path.u8string(),
+                                      unsafe->second);
+        }
+
+        // MS-DOS date in the high word, time in the low word.
+        uint32_t dos_date_time_now()
+        {
+            const time_t t = std::time(nullptr);
+            tm parts{};
+#if defined(_WIN32)
+            localtime_s(&parts, &t);
+#else
+            localtime_r(&t, &parts);
+#endif
+            if (parts.tm_year < 80) return (1 << 21) | (1 << 16);
+            const uint32_t date = ((parts.tm_year - 80) << 9) | ((parts.tm_mon + 1) << 5) | parts.tm_mday;
+            const uint32_t time = (parts.tm_hour << 11) | (parts.tm_min << 5) | (parts.tm_sec / 2);
+            return (date << 16) | time;
+        }
+
+        std::string make_local_header(const ZipEntry& entry, const uint32_t dos_date_time)
+        {
+            const bool is_zip64 = entry.size >= ZIP32_LIMIT || entry.compressed_size >= ZIP32_LIMIT;
+
+            std::string header;
+            put_u32(header, ZIP_LOCAL_HEADER_SIGNATURE);
+            put_u16(header, is_zip64 ? ZIP64_VERSION : ZIP_VERSION);
+            put_u16(header, entry.flags);
+            put_u16(header, entry.method);
+            put_u32(header, dos_date_time);
+            put_u32(header, entry.crc);
+            put_u32(header, is_zip64 ? ZIP32_LIMIT : entry.compressed_size);
+            put_u32(header, is_zip64 ? ZIP32_LIMIT : entry.size);
+            put_u16(header, entry.name.size());
+            put_u16(header, is_zip64 ? 20 : 0);
+            header += entry.name;
+            if (is_zip64)
+            {
+                put_u16(header, ZIP64_EXTRA_FIELD_ID);
+                put_u16(header, 16);
+                put_u64(header, entry.size);
+                put_u64(header, entry.compressed_size);
+            }
+            return header;
+        }
+
+        std::string make_central_header(const ZipEntry& entry, const uint32_t dos_date_time)
+        {
+            std::string zip64_fields;
+            if (entry.size >= ZIP32_LIMIT) put_u64(zip64_fields, entry.size);
+            if (entry.compressed_size >= ZIP32_LIMIT) put_u64(zip64_fields, entry.compressed_size);
+            if (entry.local_header_offset >= ZIP32_LIMIT) put_u64(zip64_fields, entry.local_header_offset);
+            const bool is_zip64 = !zip64_fields.empty();
+
+            std::string header;
+            put_u32(header, ZIP_CENTRAL_HEADER_SIGNATURE);
+            put_u16(header, (ZIP_HOST_UNIX << 8) | ZIP64_VERSION);
+            put_u16(header, is_zip64 ? ZIP64_VERSION : ZIP_VERSION);
+            put_u16(header, entry.flags);
+            put_u16(header, entry.method);
+            put_u32(header, dos_date_time);
+            put_u32(header, entry.crc);
+            put_u32(header, std::min(entry.compressed_size, ZIP32_LIMIT));
+            put_u32(header, std::min(entry.size, ZIP32_LIMIT));
+            put_u16(header, entry.name.size());
+            put_u16(header, is_zip64 ? zip64_fields.size() + 4 : 0);
+            put_u16(header, 0); // comment length
+            put_u16(header, 0); // disk number
+            put_u16(header, 0); // internal attributes
+            put_u32(header, (static_cast<uint64_t>(entry.mode) << 16) | (entry.is_directory() ? 0x10 : 0));
+            put_u32(header, std::min(entry.local_header_offset, ZIP32_LIMIT));
+            header += entry.name;
+            if (is_zip64)
+            {
+                put_u16(header, ZIP64_EXTRA_FIELD_ID);
+                put_u16(header, zip64_fields.size());
+                header += zip64_fields;
+            }
+            return header;
+        }
+
+        std::string make_end_of_central_directory(const uint64_t entry_count,
+                                                  const uint64_t central_directory_offset,
+                                                  const uint64_t central_directory_size)
+        {
+            std::string record;
+            if (entry_count >= 0xFFFF || central_directory_offset >= ZIP32_LIMIT ||
+                central_directory_size >= ZIP32_LIMIT)
+            {
+                const uint64_t zip64_record_offset = central_directory_offset + central_directory_size;
+                put_u32(record, ZIP64_END_OF_CENTRAL_DIRECTORY_SIGNATURE);
+                put_u64(record, 44);
+                put_u16(record, (ZIP_HOST_UNIX << 8) | ZIP64_VERSION);
+                put_u16(record, ZIP64_VERSION);
+                put_u32(record, 0);
+                put_u32(record, 0);
+                put_u64(record, entry_count);
+                put_u64(record, entry_count);
+                put_u64(record, central_directory_size);
+                put_u64(record, central_directory_offset);
+
+                put_u32(record, ZIP64_LOCATOR_SIGNATURE);
+                put_u32(record, 0);
+                put_u64(record, zip64_record_offset);
+                put_u32(record, 1);
+            }
+
+            put_u32(record, ZIP_END_OF_CENTRAL_DIRECTORY_SIGNATURE);
+            put_u16(record, 0);
+            put_u16(record, 0);
+            put_u16(record, std::min<uint64_t>(entry_count, 0xFFFF));
+            put_u16(record, std::min<uint64_t>(entry_count, 0xFFFF));
+            put_u32(record, std::min(central_directory_size, ZIP32_LIMIT));
+            put_u32(record, std::min(central_directory_offset, ZIP32_LIMIT));
+            put_u16(record, 0);
+            return record;
+        }
+
+        ExpectedT<std::vector<ZipEntry>, std::string> read_central_directory(std::fstream& input)
+        {
+            input.seekg(0, std::ios_base::end);
+            const uint64_t file_size = static_cast<uint64_t>(input.tellg());
+            static constexpr uint64_t EOCD_SIZE = 22;
+            if (file_size < EOCD_SIZE) return std::string("file is too small");
+
+            // The end of central directory record is followed by a comment of at most 64KiB.
+            const uint64_t tail_size = std::min<uint64_t>(file_size, EOCD_SIZE + 0xFFFF + 20);
+            const std::string tail = read_at(input, file_size - tail_size, tail_size);
+            if (tail.size() != tail_size) return std::string("failed to read the end of the archive");
+
+            size_t eocd = tail.size() - EOCD_SIZE + 1;
+            do
+            {
+                if (eocd == 0) return std::string("end of central directory record not found");
+                --eocd;
+            } while (get_u32(tail.data() + eocd) != ZIP_END_OF_CENTRAL_DIRECTORY_SIGNATURE);
+
+            uint64_t entry_count = get_u16(tail.data() + eocd + 10);
+            uint64_t central_directory_size = get_u32(tail.data() + eocd + 12);
+            uint64_t central_directory_offset = get_u32(tail.data() + eocd + 16);
+
+            if (eocd >= 20 && get_u32(tail.data() + eocd - 20) == ZIP64_LOCATOR_SIGNATURE)
+            {
+                const std::string record = read_at(input, get_u64(tail.data() + eocd - 20 + 8), 56);
+                if (record.size() != 56 || get_u32(record.data()) != ZIP64_END_OF_CENTRAL_DIRECTORY_SIGNATURE)
+                    return std::string("corrupt zip64 end of central directory record");
+                entry_count = get_u64(record.data() + 32);
+                central_directory_size = get_u64(record.data() + 40);
+                central_directory_offset = get_u64(record.data() + 48);
+            }
+
+            const std::string directory = read_at(input, central_directory_offset, central_directory_size);
+            if (directory.size() != central_directory_size) return std::string("truncated central directory");
+
+            std::vector<ZipEntry> entries;
+            size_t pos = 0;
+            for (uint64_t i = 0; i < entry_count; ++i)
+            {
+                if (pos + 46 > directory.size() || get_u32(directory.data() + pos) != ZIP_CENTRAL_HEADER_SIGNATURE)
+                    return std::string("corrupt central directory");
+
+                const char* header = directory.data() + pos;
+                const uint16_t made_by = get_u16(header + 4);
+                const size_t name_length = get_u16(header + 28);
+                const size_t extra_length = get_u16(header + 30);
+                const size_t comment_length = get_u16(header + 32);
+                if (pos + 46 + name_length + extra_length + comment_length > directory.size())
+                    return std::string("corrupt central directory");
+
+                ZipEntry entry;
+                entry.flags = get_u16(header + 8);
+                entry.method = get_u16(header + 10);
+                entry.crc = get_u32(header + 16);
+                entry.compressed_size = get_u32(header + 20);
+                entry.size = get_u32(header + 24);
+                entry.local_header_offset = get_u32(header + 42);
+                entry.name.assign(header + 46, name_length);
+                if ((made_by >> 8) == ZIP_HOST_UNIX) entry.mode = get_u32(header + 38) >> 16;
+
+                const char* extra = header + 46 + name_length;
+                for (size_t extra_pos = 0; extra_pos + 4 <= extra_length;)
+                {
+                    const uint16_t id = get_u16(extra + extra_pos);
+                    const size_t field_size = get_u16(extra + extra_pos + 2);
+                    if (extra_pos + 4 + field_size > extra_length) break;
+
+                    if (id == ZIP64_EXTRA_FIELD_ID)
+                    {
+                        const char* field = extra + extra_pos + 4;
+                        const char* const field_end = field + field_size;
+                        for (uint64_t* value : {&entry.size, &entry.compressed_size, &entry.local_header_offset})
+                        {
+                            if (*value != ZIP32_LIMIT || field + 8 > field_end) continue;
+                            *value = get_u64(field);
+                            field += 8;
+                        }
+                    }
+                    extra_pos += 4 + field_size;
+                }
+
+                entries.push_back(std::move(entry));
+                pos += 46 + name_length + extra_length + comment_length;
+            }
+
+            return std::move(entries);
+        }
+
+        /// <summary>
+        /// Decompresses an entry in pieces, passing them to `sink`, then checks its size and CRC.
+        /// Returns the size of the entry.
+        /// </summary>
+        ExpectedT<uint64_t, std::string> read_zip_entry(std::fstream& input,
+                                                        const ZipEntry& entry,
+                                                        const Compression::ByteSink& sink)
+        {
+            if ((entry.flags & ZIP_FLAG_ENCRYPTED) != 0) return std::string("encrypted entries are not supported");
+
+            const std::string local_header = read_at(input, entry.local_header_offset, 30);
+            if (local_header.size() != 30 || get_u32(local_header.data()) != ZIP_LOCAL_HEADER_SIGNATURE)
+                return std::string("corrupt local header");
+
+            const uint64_t data_offset =
+                entry.local_header_offset + 30 + get_u16(local_header.data() + 26) + get_u16(local_header.data() + 28);
+            input.clear();
+            input.seekg(data_offset);
+
+            uint64_t remaining = entry.compressed_size;
+            const Compression::ByteSource source = [&](unsigned char* buffer, size_t size) -> size_t {
+                if (!input) return 0;
+                input.read(reinterpret_cast<char*>(buffer), static_cast<size_t>(std::min<uint64_t>(size, remaining)));
+                remaining -= input.gcount();
+                return static_cast<size_t>(input.gcount());
+            };
+
+            uint32_t crc = 0;
+            const Compression::ByteSink checked_sink = [&](const unsigned char* data, size_t size) {
+                crc = Compression::crc32(crc, data, size);
+                sink(data, size);
+            };
+
+            uint64_t size = 0;
+            if (entry.method == ZIP_METHOD_STORED)
+            {
+                std::vector<unsigned char> chunk(IO_CHUNK_SIZE);
+                while (const size_t length = source(chunk.data(), chunk.size()))
+                {
+                    checked_sink(chunk.data(), length);
+                    size += length;
+                }
+            }
+            else if (entry.method == ZIP_METHOD_DEFLATED)
+            {
+                auto maybe_size = Compression::inflate_stream(source, checked_sink);
+                if (remaining != 0) return std::string("truncated entry data");
+                if (!maybe_size.has_value()) return std::move(maybe_size).error();
+                size = *maybe_size.get();
+            }
+            else
+                return Strings::format("unsupported compression method %d", entry.method);
+
+            if (remaining != 0) return std::string("truncated entry data");
+            if (size != entry.size) return std::string("size mismatch");
+            if (crc != entry.crc) return std::string("CRC mismatch");
+            return size;
+        }
+
+        uint64_t parse_tar_number(const char* field, const size_t length)
+        {
+            const auto bytes = reinterpret_cast<const unsigned char*>(field);
+            uint64_t value = 0;
+            if ((bytes[0] & 0x80) != 0)
+            {
+                // GNU base-256 encoding for values which do not fit in octal.
+                for (size_t i = 1; i < length; ++i)
+                    value = (value << 8) | bytes[i];
+                return value;
+            }
+
+            for (size_t i = 0; i < length && field[i] != '\0'; ++i)
+            {
+                if (field[i] >= '0' && field[i] <= '7') value = value * 8 + (field[i] - '0');
+            }
+            return value;
+        }
+
+        std::string tar_string_field(const char* field, const size_t length)
+        {
+            return std::string(field, std::find(field, field + length, '\0'));
+        }
+
+        /// <summary>
+        /// Extracts a tar stream handed over in pieces of any size, writing each entry as its data arrives.
+        /// Symlinks are created by `finish`, after every other entry, so nothing can be written through one.
+        /// </summary>
+        class TarExtractor
+        {
+        public:
+            TarExtractor(Files::Filesystem& fs, const fs::path& archive_path, const fs::path& to_path)
+                : fs(fs), archive_path(archive_path), to_path(to_path)
+            {
+            }
+
+            void write(const char* data, size_t size)
+            {
+                while (size > 0 && !at_end)
+                {
+                    size_t length;
+                    if (remaining > 0)
+                    {
+                        length = static_cast<size_t>(std::min<uint64_t>(size, remaining));
+                        if (file.is_open())
+                            file.write(data, length);
+                        else if (type == 'L' || type == 'K' || type == 'x')
+                            metadata.append(data, length);
+                        remaining -= length;
+                        if (remaining == 0) end_entry();
+                    }
+                    else if (padding > 0)
+                    {
+                        length = std::min(size, padding);
+                        padding -= length;
+                    }
+                    else
+                    {
+                        length = std::min(size, 512 - header.size());
+                        header.append(data, length);
+                        if (header.size() == 512)
+                        {
+                            begin_entry();
+                            header.clear();
+                        }
+                    }
+                    data += length;
+                    size -= length;
+                }
+            }
+
+            void finish()
+            {
+                Checks::check_exit(
+                    VCPKG_LINE_INFO, remaining == 0 && header.empty(), "%s is truncated", archive_path.u8string());
+
+                std::error_code ec;
+                for (auto&& link : links)
+                {
+                    Checks::check_exit(VCPKG_LINE_INFO,
+                                       is_safe_symlink(fs, to_path, link.first, link.second),
+                                       "Refusing to extract %s from %s: link target %s is outside the destination",
+                                       link.first,
+                                       archive_path.u8string(),
+                                       link.second);
+                    const fs::path target = to_path / fs::u8path(link.first);
+                    fs.create_directories(target.parent_path(), ec);
+                    create_symlink(link.second, target);
+                }
+                check_created_symlinks(fs, to_path, archive_path, links);
+            }
+
+        private:
+            // Extended headers only carry names; anything larger is not a real archive.
+            static constexpr uint64_t MAX_METADATA_SIZE = 1 << 20;
+
+            void begin_entry()
+            {
+                if (std::all_of(header.begin(), header.end(), [](char c) { return c == '\0'; }))
+                {
+                    at_end = true;
+                    return;
+                }
+
+                remaining = parse_tar_number(header.data() + 124, 12);
+                padding = static_cast<size_t>((512 - remaining % 512) % 512);
+                type = header[156];
+                metadata.clear();
+
+                if (type == 'L' || type == 'K' || type == 'x')
+                {
+                    Checks::check_exit(VCPKG_LINE_INFO,
+                                       remaining <= MAX_METADATA_SIZE,
+                                       "%s has an oversized extended header",
+                                       archive_path.u8string());
+                }
+                else if (type != 'g')
+                    create_entry();
+
+                if (remaining == 0) end_entry();
+            }
+
+            void create_entry()
+            {
+                std::string name = std::move(next_name);
+                std::string link = std::move(next_link);
+                next_name.clear();
+                next_link.clear();
+                if (name.empty())
+                {
+                    name = tar_string_field(header.data(), 100);
+                    const std::string prefix = tar_string_field(header.data() + 345, 155);
+                    if (header.compare(257, 5, "ustar") == 0 && !prefix.empty()) name = prefix + "/" + name;
+                }
+                if (link.empty()) link = tar_string_field(header.data() + 157, 100);
+
+                while (!name.empty() && name.back() == '/')
+                    name.pop_back();
+                if (name.empty() || name == ".") return;
+
+                auto maybe_name = sanitize_entry_name(name);
+                Checks::check_exit(VCPKG_LINE_INFO,
+                                   maybe_name.has_value(),
+                                   "Refusing to extract %s from %s: invalid path",
+                                   name,
+                                   archive_path.u8string());
+                const fs::path target = to_path / fs::u8path(*maybe_name.get());
+
+                std::error_code ec;
+                switch (type)
+                {
+                    case '5': fs.create_directories(target, ec); break;
+                    case '2': links.emplace_back(*maybe_name.get(), std::move(link)); break;
+                    case '1':
+                    {
+                        auto maybe_link = sanitize_entry_name(link);
+                        Checks::check_exit(VCPKG_LINE_INFO,
+                                           maybe_link.has_value(),
+                                           "Refusing to extract %s from %s: invalid link target",
+                                           name,
+                                           archive_path.u8string());
+                        fs.create_directories(target.parent_path(), ec);
+                        fs.copy_file(
+                            to_path / fs::u8path(*maybe_link.get()), target, fs::copy_options::overwrite_existing, ec);
+                        break;
+                    }
+                    case '0':
+                    case '7':
+                    case '\0':
+                        fs.create_directories(target.parent_path(), ec);
+                        file.open(target, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+                        Checks::check_exit(VCPKG_LINE_INFO, file.good(), "Failed to write %s", target.u8string());
+                        file_path = target;
+                        file_mode = static_cast<uint32_t>(parse_tar_number(header.data() + 100, 8));
+                        break;
+                    default:
+                        // Device nodes and FIFOs are not meaningful in a tool or package archive.
+                        break;
+                }
+            }
+
+            void end_entry()
+            {
+                if (file.is_open())
+                {
+                    file.close();
+                    Checks::check_exit(VCPKG_LINE_INFO, !file.fail(), "Failed to write %s", file_path.u8string());
+                    set_unix_mode(file_path, file_mode);
+                }
+                else if (type == 'L' || type == 'K')
+                {
+                    (type == 'L' ? next_name : next_link) = tar_string_field(metadata.data(), metadata.size());
+                }
+                else if (type == 'x')
+                {
+                    // Records of the form "<length> <key>=<value>\n".
+                    const size_t size = metadata.size();
+                    for (size_t record = 0; record < size;)
+                    {
+                        const size_t length =
+                            static_cast<size_t>(std::strtoull(metadata.c_str() + record, nullptr, 10));
+                        if (length == 0 || record + length > size) break;
+                        const std::string text = metadata.substr(record, length);
+                        const auto space = text.find(' ');
+                        const auto equals = text.find('=');
+                        if (space != std::string::npos && equals != std::string::npos && space < equals)
+                        {
+                            const std::string key = text.substr(space + 1, equals - space - 1);
+                            const std::string value = text.substr(equals + 1, length - equals - 2);
+                            if (key == "path") next_name = value;
+                            if (key == "linkpath") next_link = value;
+                        }
+                        record += length;
+                    }
+                }
+            }
+
+            Files::Filesystem& fs;
+            const fs::path& archive_path;
+            const fs::path& to_path;
+
+            std::string header;
+            char type = '\0';
+            uint64_t remaining = 0;
+            size_t padding = 0;
+            bool at_end = false;
+
+            std::fstream file;
+            fs::path file_path;
+            uint32_t file_mode = 0;
+            std::string metadata;
+
+            // Set by GNU long name/link entries ('L'/'K') and pax extended headers ('x') for the next entry.
+            std::string next_name;
+            std::string next_link;
+            std::vector<std::pair<std::string, std::string>> links;
+        };
+    }
+
+    void compress_directory_to_zip(Files::Filesystem& fs, const fs::path& source_dir, const fs::path& archive_path)
+    {
+        const Trace::Span span("compress", archive_path.filename().u8string());
+        const uint32_t dos_date_time = dos_date_time_now();
+        const std::string prefix = source_dir.generic_u8string();
+        const std::vector<fs::path> paths = fs.get_files_recursive(source_dir);
+
+        std::fstream output(archive_path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+        Checks::check_exit(VCPKG_LINE_INFO, output.good(), "Failed to open %s for writing", archive_path.u8string());
+
+        std::vector<ZipEntry> entries(paths.size());
+        std::mutex output_mutex;
+        uint64_t output_offset = 0;
+        Util::LockGuarded<std::vector<std::string>> errors;
+
+        // Entries are compressed in parallel and appended in completion order; the central directory is sorted.
+        Util::parallel_for_each_n(paths.size(), [&](const size_t i) {
+            const fs::path& path = paths[i];
+            ZipEntry& entry = entries[i];
+
+            std::error_code ec;
+            const auto status = fs.symlink_status(path, ec);
+            const bool is_directory = fs::is_directory(status);
+            entry.name = path.generic_u8string().substr(prefix.size() + 1);
+            if (is_directory) entry.name.push_back('/');
+            entry.flags = ZIP_FLAG_UTF8;
+            entry.mode = get_unix_mode(path, is_directory);
+
+            // Files are compressed in chunks. The output stays in memory up to SPOOL_SIZE and then continues in a
+            // temporary file; files no larger than that are kept as well, to be stored if they do not compress.
+            std::string contents;
+            std::string compressed;
+            fs::path spool_path;
+            std::fstream spool;
+            bool is_stored = true;
+            if (entry.is_symlink())
+            {
+                contents = fs::stdfs::read_symlink(path, ec).u8string();
+                entry.crc =
+                    Compression::crc32(0, reinterpret_cast<const unsigned char*>(contents.data()), contents.size());
+                entry.size = contents.size();
+            }
+            else if (!is_directory)
+            {
+                std::fstream input(path, std::ios_base::in | std::ios_base::binary);
+                if (!input) ec = std::make_error_code(std::errc::no_such_file_or_directory);
+
+                Compression::deflate_stream(
+                    [&](unsigned char* buffer, size_t size) -> size_t {
+                        if (!input) return 0;
+                        input.read(reinterpret_cast<char*>(buffer), size);
+                        const size_t length = static_cast<size_t>(input.gcount());
+                        entry.crc = Compression::crc32(entry.crc, buffer, length);
+                        entry.size += length;
+                        if (entry.size <= SPOOL_SIZE) contents.append(reinterpret_cast<const char*>(buffer), length);
+                        return length;
+                    },
+                    [&](const unsigned char* data, size_t size) {
+                        entry.compressed_size += size;
+                        compressed.append(reinterpret_cast<const char*>(data), size);
+                        if (compressed.size() < SPOOL_SIZE) return;
+                        if (spool_path.empty())
+                        {
+                            spool_path = Files::unique_temporary_path(archive_path);
+                            spool.open(spool_path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+                        }
+                        spool.write(compressed.data(), compressed.size());
+                        compressed.clear();
+                    });
+
+                if (input.bad()) ec = std::make_error_code(std::errc::io_error);
+                if (!spool_path.empty())
+                {
+                    spool.write(compressed.data(), compressed.size());
+                    compressed.clear();
+                    spool.close();
+                    if (spool.fail()) ec = std::make_error_code(std::errc::io_error);
+                }
+                is_stored = entry.size <= SPOOL_SIZE && entry.compressed_size >= entry.size;
+            }
+
+            if (is_stored && !spool_path.empty())
+            {
+                std::error_code ignored;
+                fs.remove(spool_path, ignored);
+                spool_path.clear();
+            }
+
+            if (ec)
+            {
+                errors.lock()->push_back(Strings::format("%s: %s", path.u8string(), ec.message()));
+                if (!spool_path.empty()) fs.remove(spool_path, ec);
+                return;
+            }
+
+            if (is_stored)
+            {
+                entry.compressed_size = entry.size;
+                compressed = std::move(contents);
+            }
+            else
+                entry.method = ZIP_METHOD_DEFLATED;
+
+            const std::string local_header = make_local_header(entry, dos_date_time);
+
+            std::lock_guard<std::mutex> lock(output_mutex);
+            entry.local_header_offset = output_offset;
+            output.write(local_header.data(), local_header.size());
+            if (spool_path.empty())
+                output.write(compressed.data(), compressed.size());
+            else
+            {
+                std::fstream input(spool_path, std::ios_base::in | std::ios_base::binary);
+                std::vector<char> chunk(IO_CHUNK_SIZE);
+                while (input.read(chunk.data(), chunk.size()) || input.gcount() > 0)
+                    output.write(chunk.data(), input.gcount());
+                input.close();
+                fs.remove(spool_path, ec);
+            }
+            output_offset += local_header.size() + entry.compressed_size;
+        });
+
+        {
+            auto errors_ptr = errors.lock();
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               errors_ptr->empty(),
+                               "Failed to add files to %s:\n    %s",
+                               archive_path.u8string(),
+                               Strings::join("\n    ", *errors_ptr));
+        }
+
+        std::sort(entries.begin(), entries.end(), [](const ZipEntry& lhs, const ZipEntry& rhs) {
+            return lhs.name < rhs.name;
+        });
+
+        std::string central_directory;
+        for (auto&& entry : entries)
+            central_directory += make_central_header(entry, dos_date_time);
+        output.write(central_directory.data(), central_directory.size());
+
+        const std::string end_record =
+            make_end_of_central_directory(entries.size(), output_offset, central_directory.size());
+        output.write(end_record.data(), end_record.size());
+        output.close();
+
+        Checks::check_exit(VCPKG_LINE_INFO, !output.fail(), "Failed to write %s", archive_path.u8string());
+    }
+
+    void extract_zip(Files::Filesystem& fs, const fs::path& archive_path, const fs::path& to_path)
+    {
+        const Trace::Span span("extract", archive_path.filename().u8string());
+        std::vector<ZipEntry> entries;
+        {
+            std::fstream input(archive_path, std::ios_base::in | std::ios_base::binary);
+            Checks::check_exit(VCPKG_LINE_INFO, input.good(), "Failed to open %s", archive_path.u8string());
+
+            auto maybe_entries = read_central_directory(input);
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               maybe_entries.has_value(),
+                               "Failed to read zip archive %s: %s",
+                               archive_path.u8string(),
+                               maybe_entries.error());
+            entries = std::move(maybe_entries).value_or_exit(VCPKG_LINE_INFO);
+        }
+
+        std::error_code ec;
+        fs.create_directories(to_path, ec);
+
+        std::vector<const ZipEntry*> files;
+        std::vector<const ZipEntry*> links;
+        for (auto&& entry : entries)
+        {
+            auto maybe_name = sanitize_entry_name(entry.name);
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               maybe_name.has_value(),
+                               "Refusing to extract %s from %s: invalid path",
+                               entry.name,
+                               archive_path.u8string());
+            entry.name = std::move(*maybe_name.get());
+
+            const fs::path target = to_path / fs::u8path(entry.name);
+            if (entry.is_directory())
+                fs.create_directories(target, ec);
+            else
+            {
+                fs.create_directories(target.parent_path(), ec);
+                (entry.is_symlink() ? links : files).push_back(&entry);
+            }
+        }
+
+        Util::LockGuarded<std::vector<std::string>> errors;
+        Util::parallel_for_each_n(files.size(), [&](const size_t i) {
+            const ZipEntry& entry = *files[i];
+            const fs::path target = to_path / fs::u8path(entry.name);
+
+            std::fstream input(archive_path, std::ios_base::in | std::ios_base::binary);
+            std::fstream output(target, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+            auto maybe_size = read_zip_entry(input, entry, [&](const unsigned char* data, size_t size) {
+                output.write(reinterpret_cast<const char*>(data), size);
+            });
+            output.close();
+            if (!maybe_size.has_value())
+            {
+                errors.lock()->push_back(Strings::format("%s: %s", entry.name, maybe_size.error()));
+                return;
+            }
+            if (output.fail())
+            {
+                errors.lock()->push_back(Strings::format("%s: failed to write %s", entry.name, target.u8string()));
+                return;
+            }
+            set_unix_mode(target, entry.mode);
+        });
+
+        // Symlinks are created last, so no other entry can be written through one.
+        std::fstream input(archive_path, std::ios_base::in | std::ios_base::binary);
+        std::vector<std::pair<std::string, std::string>> created_links;
+        for (auto&& entry : links)
+        {
+            std::string link;
+            auto maybe_size = read_zip_entry(input, *entry, [&](const unsigned char* data, size_t size) {
+                link.append(reinterpret_cast<const char*>(data), size);
+            });
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               maybe_size.has_value(),
+                               "Failed to extract %s from %s: %s",
+                               entry->name,
+                               archive_path.u8string(),
+                               maybe_size.error());
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               is_safe_symlink(fs, to_path, entry->name, link),
+                               "Refusing to extract %s from %s: link target %s is outside the destination",
+                               entry->name,
+                               archive_path.u8string(),
+                               link);
+
+            const fs::path target = to_path / fs::u8path(entry->name);
+            if (create_symlink(link, target))
+            {
+                created_links.emplace_back(entry->name, std::move(link));
+            }
+            else
+            {
+                Checks::check_exit(VCPKG_LINE_INFO,
+                                   write_file(target, link.data(), link.size()),
+                                   "Failed to write %s",
+                                   target.u8string());
+            }
+        }
+        check_created_symlinks(fs, to_path, archive_path, created_links);
+
+        auto errors_ptr = errors.lock();
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           errors_ptr->empty(),
+                           "Failed to extract %s:\n    %s",
+                           archive_path.u8string(),
+                           Strings::join("\n    ", *errors_ptr));
+    }
+
+    void extract_tar_gz(Files::Filesystem& fs, const fs::path& archive_path, const fs::path& to_path)
+    {
+        const Trace::Span span("extract", archive_path.filename().u8string());
+        std::fstream input(archive_path, std::ios_base::in | std::ios_base::binary);
+        Checks::check_exit(VCPKG_LINE_INFO, input.good(), "Failed to open %s", archive_path.u8string());
+
+        // The gzip header is parsed from the first chunk, which the decompressor then continues from.
+        std::string gzip(IO_CHUNK_SIZE, '\0');
+        input.read(&gzip[0], gzip.size());
+        gzip.resize(static_cast<size_t>(input.gcount()));
+        const auto gzip_bytes = reinterpret_cast<const unsigned char*>(gzip.data());
+
+        // RFC 1952 member header: magic, method, flags, mtime, extra flags, os, then optional fields.
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           gzip.size() >= 18 && gzip_bytes[0] == 0x1f && gzip_bytes[1] == 0x8b && gzip_bytes[2] == 8,
+                           "%s is not a gzip archive",
+                           archive_path.u8string());
+        const unsigned char flags = gzip_bytes[3];
+        size_t pos = 10;
+        if ((flags & 0x04) != 0) pos += 2 + get_u16(gzip.data() + pos);
+        for (const unsigned char zero_terminated_field : {0x08, 0x10})
+        {
+            if ((flags & zero_terminated_field) == 0) continue;
+            while (pos < gzip.size() && gzip[pos] != '\0')
+                ++pos;
+            ++pos;
+        }
+        if ((flags & 0x02) != 0) pos += 2;
+        Checks::check_exit(VCPKG_LINE_INFO, pos < gzip.size(), "%s is truncated", archive_path.u8string());
+
+        std::error_code ec;
+        fs.create_directories(to_path, ec);
+
+        TarExtractor tar(fs, archive_path, to_path);
+        auto maybe_size = Compression::inflate_stream(
+            [&](unsigned char* buffer, size_t size) -> size_t {
+                if (pos < gzip.size())
+                {
+                    const size_t length = std::min(size, gzip.size() - pos);
+                    std::copy(gzip_bytes + pos, gzip_bytes + pos + length, buffer);
+                    pos += length;
+                    return length;
+                }
+                if (!input) return 0;
+                input.read(reinterpret_cast<char*>(buffer), size);
+                return static_cast<size_t>(input.gcount());
+            },
+            [&](const unsigned char* data, size_t size) { tar.write(reinterpret_cast<const char*>(data), size); });
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           maybe_size.has_value(),
+                           "Failed to decompress %s: %s",
+                           archive_path.u8string(),
+                           maybe_size.error());
+        tar.finish();
+    }
+
     void extract_archive(const VcpkgPaths& paths, const fs::path& archive, const fs::path& to_path)
     {
         Files::Filesystem& fs = paths.get_filesystem();
@@ -67,17 +1122,13 @@ namespace vcpkg::Archives
             recursion_limiter_sevenzip = false;
         }
 #else
-        if (ext == ".gz" && ext.extension() != ".tar")
+        if (ext == ".gz")
         {
-            const auto code = System::cmd_execute(
-                Strings::format(R"(cd '%s' && tar xzf '%s')", to_path_partial.u8string(), archive.u8string()));
-            Checks::check_exit(VCPKG_LINE_INFO, code == 0, "tar failed while extracting %s", archive.u8string());
+            extract_tar_gz(fs, archive, to_path_partial);
         }
         else if (ext == ".zip")
         {
-            const auto code = System::cmd_execute(
-                Strings::format(R"(cd '%s' && unzip -qqo '%s')", to_path_partial.u8string(), archive.u8string()));
-            Checks::check_exit(VCPKG_LINE_INFO, code == 0, "unzip failed while extracting %s", archive.u8string());
+            extract_zip(fs, archive, to_path_partial);
         }
         else
         {
@@ -4,16 +4,46 @@
 #include <vcpkg/metrics.h>
 
 #include <vcpkg/base/checks.h>
+#include <vcpkg/base/stats.h>
 #include <vcpkg/base/system.h>
+#include <vcpkg/base/trace.h>
 
 namespace vcpkg::Checks
 {
+    static thread_local bool t_throw_on_exit = false;
+
+    ThrowOnExit::ThrowOnExit() : previous(t_throw_on_exit) { t_throw_on_exit = true; }
+
+    ThrowOnExit::~ThrowOnExit() { t_throw_on_exit = previous; }
+
+    static std::mutex g_exit_hooks_mutex;
+    static std::vector<void (*)()> g_exit_hooks;
+
+    void register_exit_hook(void (*hook)())
+    {
+        std::lock_guard<std::mutex> lock(g_exit_hooks_mutex);
+        g_exit_hooks.push_back(hook);
+    }
+
     [[noreturn]] static void cleanup_and_exit(const int exit_code)
     {
+        if (t_throw_on_exit) throw ExitRequested{exit_code};
+
         static std::atomic<bool> have_entered{false};
         if (have_entered) std::terminate();
         have_entered = true;
 
+        std::vector<void (*)()> exit_hooks;
+        {
+            std::lock_guard<std::mutex> lock(g_exit_hooks_mutex);
+            exit_hooks = g_exit_hooks;
+        }
+        for (auto&& hook : exit_hooks)
+            hook();
+
+        Trace::flush();
+        Stats::print();
+
         const auto elapsed_us_inner = GlobalState::timer.lock()->microseconds();
 
         bool debugging = GlobalState::debugging;
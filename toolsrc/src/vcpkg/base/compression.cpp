@@ -0,0 +1,862 @@
+#include "pch.h"
+
+#include <vcpkg/base/compression.h>
+
+namespace vcpkg::Compression
+{
+    uint32_t crc32(uint32_t crc, const unsigned char* data, size_t size) noexcept
+    {
+        static const auto TABLE = []() {
+            std::array<uint32_t, 256> table;
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k)
+                {
+                    c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+                }
+                table[i] = c;
+            }
+            return table;
+        }();
+
+        crc = ~crc;
+        for (size_t i = 0; i < size; ++i)
+        {
+            crc = TABLE[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    namespace
+    {
+        static constexpr uint16_t LENGTH_BASE[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                                     31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static constexpr uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                                     2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        static constexpr uint16_t DISTANCE_BASE[30] = {1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+                                                       33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+                                                       1025, 1537, 2049, 3073, 4097, 6145,  8193,  12289, 16385, 24577};
+        static constexpr uint8_t DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                                       6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+        // Order in which the code length code lengths are transmitted.
+        static constexpr uint8_t CODE_LENGTH_ORDER[19] = {
+            16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+        static constexpr int MAX_BITS = 15;
+        static constexpr size_t WINDOW_SIZE = 32768;
+        static constexpr size_t MIN_MATCH = 3;
+        static constexpr size_t MAX_MATCH = 258;
+        static constexpr size_t STREAM_CHUNK_SIZE = 64 * 1024;
+
+        uint32_t reverse_bits(uint32_t code, int length)
+        {
+            uint32_t result = 0;
+            for (int i = 0; i < length; ++i)
+            {
+                result = (result << 1) | (code & 1);
+                code >>= 1;
+            }
+            return result;
+        }
+
+        /// <summary>
+        /// Computes canonical Huffman codes (RFC 1951 3.2.2), bit-reversed so they can be emitted LSB first.
+        /// Returns false if the lengths are over-subscribed.
+        /// </summary>
+        bool canonical_codes(const uint8_t* lengths, size_t count, uint16_t* codes)
+        {
+            int length_counts[MAX_BITS + 1] = {};
+            for (size_t i = 0; i < count; ++i)
+                ++length_counts[lengths[i]];
+            length_counts[0] = 0;
+
+            int left = 1;
+            for (int len = 1; len <= MAX_BITS; ++len)
+            {
+                left = (left << 1) - length_counts[len];
+                if (left < 0) return false;
+            }
+
+            uint32_t next_code[MAX_BITS + 1] = {};
+            uint32_t code = 0;
+            for (int len = 1; len <= MAX_BITS; ++len)
+            {
+                code = (code + length_counts[len - 1]) << 1;
+                next_code[len] = code;
+            }
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                const int len = lengths[i];
+                if (len != 0) codes[i] = static_cast<uint16_t>(reverse_bits(next_code[len]++, len));
+            }
+            return true;
+        }
+
+        /// <summary>
+        /// Reads bits LSB first from input pulled in chunks from a ByteSource. Past the end of the input it
+        /// yields zero bytes, which `overrun` detects.
+        /// </summary>
+        struct BitReader
+        {
+            explicit BitReader(const ByteSource& source) : source(source), input(STREAM_CHUNK_SIZE) {}
+
+            // Makes the next input byte available; false at the end of the input.
+            bool fill()
+            {
+                if (position < input_size) return true;
+                if (at_end) return false;
+                input_size = source(input.data(), input.size());
+                position = 0;
+                at_end = input_size == 0;
+                return !at_end;
+            }
+
+            void refill()
+            {
+                while (bit_count <= 56)
+                {
+                    uint64_t byte = 0;
+                    if (fill())
+                        byte = input[position++];
+                    else
+                        ++padding;
+                    bit_buffer |= byte << bit_count;
+                    bit_count += 8;
+                }
+            }
+
+            uint32_t peek(int bits) const { return static_cast<uint32_t>(bit_buffer & ((uint64_t(1) << bits) - 1)); }
+
+            void consume(int bits)
+            {
+                bit_buffer >>= bits;
+                bit_count -= bits;
+            }
+
+            uint32_t read(int bits)
+            {
+                if (bit_count < bits) refill();
+                const uint32_t result = peek(bits);
+                consume(bits);
+                return result;
+            }
+
+            // Whether the zero padding past the end of the input has been consumed.
+            bool overrun() const { return padding > static_cast<size_t>(bit_count / 8); }
+
+            void align_to_byte() { consume(bit_count % 8); }
+
+            // After align_to_byte, appends the next `size` bytes to `out`; false if the input ends first.
+            bool read_bytes(std::vector<unsigned char>& out, size_t size)
+            {
+                for (; size > 0 && bit_count >= 8; --size)
+                    out.push_back(static_cast<unsigned char>(read(8)));
+                while (size > 0)
+                {
+                    if (!fill()) return false;
+                    const size_t length = std::min(size, input_size - position);
+                    out.insert(out.end(), input.data() + position, input.data() + position + length);
+                    position += length;
+                    size -= length;
+                }
+                return true;
+            }
+
+            const ByteSource& source;
+            std::vector<unsigned char> input;
+            size_t input_size = 0;
+            size_t position = 0;
+            bool at_end = false;
+            // Zero bytes supplied after the end of the input.
+            size_t padding = 0;
+            uint64_t bit_buffer = 0;
+            int bit_count = 0;
+        };
+
+        /// <summary>
+        /// Table-driven Huffman decoder indexed by the next `max_length` input bits.
+        /// </summary>
+        struct HuffmanDecoder
+        {
+            bool build(const uint8_t* lengths, size_t count)
+            {
+                uint16_t codes[288];
+                if (!canonical_codes(lengths, count, codes)) return false;
+
+                max_length = 1;
+                for (size_t i = 0; i < count; ++i)
+                    max_length = std::max<int>(max_length, lengths[i]);
+
+                // Each entry holds (symbol << 4) | length; a length of 0 marks a code that is not in the table.
+                entries.assign(size_t(1) << max_length, 0);
+                for (size_t symbol = 0; symbol < count; ++symbol)
+                {
+                    const int len = lengths[symbol];
+                    if (len == 0) continue;
+                    for (size_t index = codes[symbol]; index < entries.size(); index += size_t(1) << len)
+                    {
+                        entries[index] = static_cast<uint16_t>((symbol << 4) | len);
+                    }
+                }
+                return true;
+            }
+
+            int decode(BitReader& reader) const
+            {
+                if (reader.bit_count < max_length) reader.refill();
+                const uint16_t entry = entries[reader.peek(max_length)];
+                const int len = entry & 0xF;
+                if (len == 0) return -1;
+                reader.consume(len);
+                return entry >> 4;
+            }
+
+            std::vector<uint16_t> entries;
+            int max_length = 0;
+        };
+
+        bool read_dynamic_tables(BitReader& reader, HuffmanDecoder& literals, HuffmanDecoder& distances)
+        {
+            const size_t literal_count = reader.read(5) + 257;
+            const size_t distance_count = reader.read(5) + 1;
+            const size_t code_length_count = reader.read(4) + 4;
+            if (literal_count > 286 || distance_count > 30) return false;
+
+            uint8_t code_length_lengths[19] = {};
+            for (size_t i = 0; i < code_length_count; ++i)
+                code_length_lengths[CODE_LENGTH_ORDER[i]] = static_cast<uint8_t>(reader.read(3));
+
+            HuffmanDecoder code_lengths;
+            if (!code_lengths.build(code_length_lengths, 19)) return false;
+
+            uint8_t lengths[286 + 30] = {};
+            size_t index = 0;
+            while (index < literal_count + distance_count)
+            {
+                const int symbol = code_lengths.decode(reader);
+                if (symbol < 0) return false;
+                if (symbol < 16)
+                {
+                    lengths[index++] = static_cast<uint8_t>(symbol);
+                    continue;
+                }
+
+                uint8_t value = 0;
+                size_t repeat;
+                if (symbol == 16)
+                {
+                    if (index == 0) return false;
+                    value = lengths[index - 1];
+                    repeat = 3 + reader.read(2);
+                }
+                else if (symbol == 17)
+                    repeat = 3 + reader.read(3);
+                else
+                    repeat = 11 + reader.read(7);
+
+                if (index + repeat > literal_count + distance_count) return false;
+                std::fill_n(lengths + index, repeat, value);
+                index += repeat;
+            }
+
+            if (lengths[256] == 0) return false;
+            return literals.build(lengths, literal_count) && distances.build(lengths + literal_count, distance_count);
+        }
+
+        void build_fixed_tables(HuffmanDecoder& literals, HuffmanDecoder& distances)
+        {
+            uint8_t lengths[288];
+            std::fill(lengths, lengths + 144, uint8_t(8));
+            std::fill(lengths + 144, lengths + 256, uint8_t(9));
+            std::fill(lengths + 256, lengths + 280, uint8_t(7));
+            std::fill(lengths + 280, lengths + 288, uint8_t(8));
+            literals.build(lengths, 288);
+
+            std::fill(lengths, lengths + 30, uint8_t(5));
+            distances.build(lengths, 30);
+        }
+    }
+
+    ExpectedT<uint64_t, std::string> inflate_stream(const ByteSource& source, const ByteSink& sink)
+    {
+        // Output is handed to the sink in pieces; the last WINDOW_SIZE bytes stay behind for back-references.
+        static constexpr size_t FLUSH_SIZE = 8 * WINDOW_SIZE;
+        std::vector<unsigned char> output;
+        output.reserve(FLUSH_SIZE + 0xFFFF);
+        uint64_t flushed = 0;
+        auto flush = [&](size_t keep) {
+            if (output.size() <= keep) return;
+            const size_t length = output.size() - keep;
+            sink(output.data(), length);
+            output.erase(output.begin(), output.begin() + length);
+            flushed += length;
+        };
+
+        BitReader reader(source);
+        HuffmanDecoder literals;
+        HuffmanDecoder distances;
+
+        bool is_final_block = false;
+        while (!is_final_block)
+        {
+            is_final_block = reader.read(1) != 0;
+            const uint32_t block_type = reader.read(2);
+
+            if (block_type == 0)
+            {
+                reader.align_to_byte();
+                const size_t length = reader.read(16);
+                const size_t inverted = reader.read(16);
+                if (reader.overrun()) return std::string("truncated stored block");
+                if (length != (~inverted & 0xFFFF)) return std::string("corrupt stored block length");
+                if (!reader.read_bytes(output, length) || reader.overrun())
+                    return std::string("truncated stored block");
+                if (output.size() >= FLUSH_SIZE) flush(WINDOW_SIZE);
+                continue;
+            }
+
+            if (block_type == 1)
+                build_fixed_tables(literals, distances);
+            else if (block_type == 2)
+            {
+                if (!read_dynamic_tables(reader, literals, distances)) return std::string("invalid Huffman tables");
+            }
+            else
+                return std::string("invalid block type");
+
+            while (true)
+            {
+                if (reader.overrun()) return std::string("unexpected end of stream");
+                if (output.size() >= FLUSH_SIZE) flush(WINDOW_SIZE);
+
+                const int symbol = literals.decode(reader);
+                if (symbol < 0) return std::string("invalid literal/length code");
+                if (symbol < 256)
+                {
+                    output.push_back(static_cast<unsigned char>(symbol));
+                    continue;
+                }
+                if (symbol == 256) break;
+                if (symbol > 285) return std::string("invalid length symbol");
+
+                const size_t length =
+                    LENGTH_BASE[symbol - 257] + reader.read(LENGTH_EXTRA[symbol - 257]);
+                const int distance_symbol = distances.decode(reader);
+                if (distance_symbol < 0 || distance_symbol >= 30) return std::string("invalid distance code");
+                const size_t distance =
+                    DISTANCE_BASE[distance_symbol] + reader.read(DISTANCE_EXTRA[distance_symbol]);
+                if (distance > output.size()) return std::string("distance too far back");
+
+                const size_t start = output.size() - distance;
+                for (size_t i = 0; i < length; ++i)
+                    output.push_back(output[start + i]);
+            }
+        }
+
+        if (reader.overrun()) return std::string("unexpected end of stream");
+        flush(0);
+        return flushed;
+    }
+
+    ExpectedT<std::vector<unsigned char>, std::string> inflate(const unsigned char* data,
+                                                               size_t size,
+                                                               size_t size_hint)
+    {
+        std::vector<unsigned char> output;
+        output.reserve(size_hint);
+
+        size_t offset = 0;
+        auto maybe_size = inflate_stream(
+            [&](unsigned char* buffer, size_t capacity) {
+                const size_t length = std::min(capacity, size - offset);
+                std::copy(data + offset, data + offset + length, buffer);
+                offset += length;
+                return length;
+            },
+            [&](const unsigned char* piece, size_t length) { output.insert(output.end(), piece, piece + length); });
+        if (!maybe_size.has_value()) return std::move(maybe_size).error();
+        return std::move(output);
+    }
+
+    namespace
+    {
+        struct BitWriter
+        {
+            void write(uint32_t bits, int count)
+            {
+                bit_buffer |= uint64_t(bits) << bit_count;
+                bit_count += count;
+                while (bit_count >= 8)
+                {
+                    output.push_back(static_cast<unsigned char>(bit_buffer));
+                    bit_buffer >>= 8;
+                    bit_count -= 8;
+                }
+            }
+
+            void align_to_byte()
+            {
+                if (bit_count > 0) write(0, 8 - bit_count);
+            }
+
+            std::vector<unsigned char> output;
+            uint64_t bit_buffer = 0;
+            int bit_count = 0;
+        };
+
+        /// <summary>
+        /// Builds Huffman code lengths no longer than `limit` for the given symbol frequencies.
+        /// </summary>
+        void build_code_lengths(const uint32_t* frequencies, size_t count, int limit, uint8_t* lengths)
+        {
+            std::fill(lengths, lengths + count, uint8_t(0));
+
+            std::vector<std::pair<uint32_t, uint16_t>> symbols;
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (frequencies[i] != 0) symbols.emplace_back(frequencies[i], static_cast<uint16_t>(i));
+            }
+            if (symbols.empty()) return;
+            if (symbols.size() == 1)
+            {
+                lengths[symbols[0].second] = 1;
+                return;
+            }
+            std::sort(symbols.begin(), symbols.end());
+
+            // Two-queue Huffman construction over the sorted leaves.
+            const size_t leaf_count = symbols.size();
+            std::vector<uint64_t> weights(2 * leaf_count - 1);
+            std::vector<size_t> parents(2 * leaf_count - 1);
+            for (size_t i = 0; i < leaf_count; ++i)
+                weights[i] = symbols[i].first;
+
+            size_t next_leaf = 0;
+            size_t next_internal = leaf_count;
+            size_t next_node = leaf_count;
+            auto pick = [&]() {
+                if (next_leaf < leaf_count && (next_internal == next_node || weights[next_leaf] <= weights[next_internal]))
+                    return next_leaf++;
+                return next_internal++;
+            };
+            while (next_node < weights.size())
+            {
+                const size_t a = pick();
+                const size_t b = pick();
+                weights[next_node] = weights[a] + weights[b];
+                parents[a] = next_node;
+                parents[b] = next_node;
+                ++next_node;
+            }
+
+            std::vector<int> depths(weights.size(), 0);
+            int length_counts[MAX_BITS + 1] = {};
+            for (size_t i = weights.size() - 1; i-- > 0;)
+            {
+                depths[i] = depths[parents[i]] + 1;
+                if (i < leaf_count) ++length_counts[std::min(depths[i], limit)];
+            }
+
+            // Clamping to `limit` over-subscribes the code; lengthen shorter codes until the Kraft sum is exactly 1.
+            uint32_t total = 0;
+            for (int len = 1; len <= limit; ++len)
+                total += static_cast<uint32_t>(length_counts[len]) << (limit - len);
+            while (total != (uint32_t(1) << limit))
+            {
+                --length_counts[limit];
+                for (int len = limit - 1; len > 0; --len)
+                {
+                    if (length_counts[len] != 0)
+                    {
+                        --length_counts[len];
+                        length_counts[len + 1] += 2;
+                        break;
+                    }
+                }
+                --total;
+            }
+
+            // The least frequent symbols get the longest codes.
+            size_t symbol_index = 0;
+            for (int len = limit; len > 0; --len)
+            {
+                for (int i = 0; i < length_counts[len]; ++i)
+                    lengths[symbols[symbol_index++].second] = static_cast<uint8_t>(len);
+            }
+        }
+
+        int length_symbol(size_t length)
+        {
+            static const auto TABLE = []() {
+                std::array<uint8_t, MAX_MATCH + 1> table{};
+                for (int code = 0; code < 29; ++code)
+                {
+                    const size_t end = code == 28 ? MAX_MATCH + 1 : LENGTH_BASE[code + 1];
+                    for (size_t len = LENGTH_BASE[code]; len < end; ++len)
+                        table[len] = static_cast<uint8_t>(code);
+                }
+                return table;
+            }();
+            return TABLE[length];
+        }
+
+        int distance_symbol(size_t distance)
+        {
+            int code = 0;
+            while (code < 29 && DISTANCE_BASE[code + 1] <= distance)
+                ++code;
+            return code;
+        }
+
+        // An LZ77 symbol: either a literal byte or a (length, distance) back-reference.
+        struct Lz77Symbol
+        {
+            uint16_t length_or_literal;
+            uint16_t distance;
+        };
+
+        class DeflateEncoder
+        {
+        public:
+            explicit DeflateEncoder(ByteSink sink)
+                : sink(std::move(sink)), head(size_t(1) << HASH_BITS, -1), previous(WINDOW_SIZE, -1)
+            {
+            }
+
+            void add(const unsigned char* data, size_t size)
+            {
+                buffer.insert(buffer.end(), data, data + size);
+                encode(false);
+            }
+
+            void finish()
+            {
+                if (buffer_start + buffer.size() == 0)
+                {
+                    // A single final fixed-Huffman block containing only the end-of-block symbol.
+                    writer.write(1, 1);
+                    writer.write(1, 2);
+                    writer.write(0, 7);
+                }
+                else
+                    encode(true);
+
+                writer.align_to_byte();
+                drain();
+            }
+
+        private:
+            static constexpr size_t HASH_BITS = 15;
+            static constexpr int MAX_CHAIN = 32;
+            static constexpr size_t NICE_LENGTH = 128;
+            static constexpr size_t BLOCK_SYMBOLS = 1 << 15;
+            // Consumed input is discarded from the front of the buffer once this much has accumulated.
+            static constexpr size_t TRIM_SIZE = 1 << 20;
+
+            // Positions are offsets into the whole input; `buffer` holds the input from `buffer_start` on.
+            const unsigned char* at(size_t pos) const { return buffer.data() + (pos - buffer_start); }
+
+            uint32_t hash_at(size_t pos) const
+            {
+                const unsigned char* const p = at(pos);
+                const uint32_t value = p[0] | (p[1] << 8) | (p[2] << 16);
+                return (value * 2654435761u) >> (32 - HASH_BITS);
+            }
+
+            void insert(size_t pos, size_t end)
+            {
+                if (pos + MIN_MATCH > end) return;
+                const auto hash = hash_at(pos);
+                previous[pos % WINDOW_SIZE] = head[hash];
+                head[hash] = static_cast<int64_t>(pos);
+            }
+
+            void encode(bool is_final)
+            {
+                const size_t end = buffer_start + buffer.size();
+                // Until the input is complete, leave room for the longest match and the hash of its last byte.
+                const size_t limit = is_final ? end : end > MAX_MATCH + MIN_MATCH ? end - MAX_MATCH - MIN_MATCH : 0;
+                while (pos < limit)
+                {
+                    size_t best_length = 0;
+                    size_t best_distance = 0;
+                    if (pos + MIN_MATCH <= end)
+                    {
+                        const unsigned char* const current = at(pos);
+                        const size_t max_length = std::min(MAX_MATCH, end - pos);
+                        int64_t candidate = head[hash_at(pos)];
+                        for (int chain = MAX_CHAIN; candidate >= 0 && chain > 0; --chain)
+                        {
+                            const size_t match = static_cast<size_t>(candidate);
+                            if (pos - match > WINDOW_SIZE) break;
+
+                            const unsigned char* const earlier = at(match);
+                            if (earlier[best_length] == current[best_length])
+                            {
+                                size_t length = 0;
+                                while (length < max_length && earlier[length] == current[length])
+                                    ++length;
+                                if (length > best_length)
+                                {
+                                    best_length = length;
+                                    best_distance = pos - match;
+                                    if (length >= NICE_LENGTH || length == max_length) break;
+                                }
+                            }
+
+                            const int64_t next = previous[match % WINDOW_SIZE];
+                            // Slots are reused once the window wraps; stop rather than follow a newer entry.
+                            if (next >= candidate) break;
+                            candidate = next;
+                        }
+                    }
+
+                    if (best_length >= MIN_MATCH)
+                    {
+                        symbols.push_back({static_cast<uint16_t>(256 + best_length), static_cast<uint16_t>(best_distance)});
+                        for (size_t i = 0; i < best_length; ++i)
+                            insert(pos + i, end);
+                        pos += best_length;
+                    }
+                    else
+                    {
+                        symbols.push_back({*at(pos), 0});
+                        insert(pos, end);
+                        ++pos;
+                    }
+
+                    if (symbols.size() >= BLOCK_SYMBOLS)
+                    {
+                        flush_block(block_start, pos, false);
+                        block_start = pos;
+                    }
+                }
+
+                if (is_final)
+                {
+                    flush_block(block_start, pos, true);
+                    block_start = pos;
+                }
+
+                // Keep the unflushed block (for stored blocks) and the window that matches may refer back to.
+                const size_t keep_from = std::min(block_start, pos > WINDOW_SIZE ? pos - WINDOW_SIZE : 0);
+                if (keep_from - buffer_start >= TRIM_SIZE)
+                {
+                    buffer.erase(buffer.begin(), buffer.begin() + (keep_from - buffer_start));
+                    buffer_start = keep_from;
+                }
+                drain();
+            }
+
+            void drain()
+            {
+                if (writer.output.empty()) return;
+                sink(writer.output.data(), writer.output.size());
+                writer.output.clear();
+            }
+
+            void flush_block(size_t block_start, size_t block_end, bool is_final)
+            {
+                uint32_t literal_frequencies[286] = {};
+                uint32_t distance_frequencies[30] = {};
+                for (auto&& symbol : symbols)
+                {
+                    if (symbol.length_or_literal < 256)
+                        ++literal_frequencies[symbol.length_or_literal];
+                    else
+                    {
+                        ++literal_frequencies[257 + length_symbol(symbol.length_or_literal - 256)];
+                        ++distance_frequencies[distance_symbol(symbol.distance)];
+                    }
+                }
+                literal_frequencies[256] = 1;
+
+                uint8_t literal_lengths[286];
+                build_code_lengths(literal_frequencies, 286, MAX_BITS, literal_lengths);
+                uint8_t distance_lengths[30];
+                build_code_lengths(distance_frequencies, 30, MAX_BITS, distance_lengths);
+                // At least one distance code must be described, even if the block has no matches.
+                if (std::all_of(distance_lengths, distance_lengths + 30, [](uint8_t l) { return l == 0; }))
+                    distance_lengths[0] = 1;
+
+                size_t literal_count = 286;
+                while (literal_count > 257 && literal_lengths[literal_count - 1] == 0)
+                    --literal_count;
+                size_t distance_count = 30;
+                while (distance_count > 1 && distance_lengths[distance_count - 1] == 0)
+                    --distance_count;
+                uint8_t lengths[286 + 30];
+                std::copy(literal_lengths, literal_lengths + literal_count, lengths);
+                std::copy(distance_lengths, distance_lengths + distance_count, lengths + literal_count);
+                const size_t length_count = literal_count + distance_count;
+
+                // Run-length encode the code lengths with symbols 16 (repeat previous), 17 and 18 (repeat zero).
+                std::vector<std::pair<uint8_t, uint8_t>> runs;
+                uint32_t code_length_frequencies[19] = {};
+                for (size_t i = 0; i < length_count;)
+                {
+                    const uint8_t value = lengths[i];
+                    size_t run = 1;
+                    while (i + run < length_count && lengths[i + run] == value)
+                        ++run;
+                    i += run;
+
+                    if (value == 0)
+                    {
+                        while (run >= 11)
+                        {
+                            const size_t n = std::min<size_t>(run, 138);
+                            runs.emplace_back(uint8_t(18), static_cast<uint8_t>(n - 11));
+                            run -= n;
+                        }
+                        if (run >= 3)
+                        {
+                            runs.emplace_back(uint8_t(17), static_cast<uint8_t>(run - 3));
+                            run = 0;
+                        }
+                    }
+                    else
+                    {
+                        runs.emplace_back(value, uint8_t(0));
+                        --run;
+                        while (run >= 3)
+                        {
+                            const size_t n = std::min<size_t>(run, 6);
+                            runs.emplace_back(uint8_t(16), static_cast<uint8_t>(n - 3));
+                            run -= n;
+                        }
+                    }
+                    for (; run > 0; --run)
+                        runs.emplace_back(value, uint8_t(0));
+                }
+                for (auto&& run : runs)
+                    ++code_length_frequencies[run.first];
+
+                uint8_t code_length_lengths[19];
+                build_code_lengths(code_length_frequencies, 19, 7, code_length_lengths);
+                size_t code_length_count = 19;
+                while (code_length_count > 4 && code_length_lengths[CODE_LENGTH_ORDER[code_length_count - 1]] == 0)
+                    --code_length_count;
+
+                // Compare the size of a dynamic block against storing the bytes verbatim.
+                uint64_t dynamic_bits = 3 + 5 + 5 + 4 + 3 * code_length_count;
+                for (auto&& run : runs)
+                {
+                    dynamic_bits += code_length_lengths[run.first];
+                    dynamic_bits += run.first == 16 ? 2 : run.first == 17 ? 3 : run.first == 18 ? 7 : 0;
+                }
+                for (size_t i = 0; i < 286; ++i)
+                    dynamic_bits += uint64_t(literal_frequencies[i]) * literal_lengths[i];
+                for (size_t i = 0; i < 29; ++i)
+                    dynamic_bits += uint64_t(literal_frequencies[257 + i]) * LENGTH_EXTRA[i];
+                for (size_t i = 0; i < 30; ++i)
+                    dynamic_bits += uint64_t(distance_frequencies[i]) * (distance_lengths[i] + DISTANCE_EXTRA[i]);
+
+                const size_t block_size = block_end - block_start;
+                const uint64_t stored_bits = (block_size + 5 * (block_size / 0xFFFF + 1)) * 8 + 8;
+                if (stored_bits <= dynamic_bits)
+                {
+                    write_stored(block_start, block_end, is_final);
+                    symbols.clear();
+                    return;
+                }
+
+                writer.write(is_final ? 1 : 0, 1);
+                writer.write(2, 2);
+                writer.write(static_cast<uint32_t>(literal_count - 257), 5);
+                writer.write(static_cast<uint32_t>(distance_count - 1), 5);
+                writer.write(static_cast<uint32_t>(code_length_count - 4), 4);
+                for (size_t i = 0; i < code_length_count; ++i)
+                    writer.write(code_length_lengths[CODE_LENGTH_ORDER[i]], 3);
+
+                uint16_t code_length_codes[19];
+                canonical_codes(code_length_lengths, 19, code_length_codes);
+                for (auto&& run : runs)
+                {
+                    writer.write(code_length_codes[run.first], code_length_lengths[run.first]);
+                    if (run.first == 16)
+                        writer.write(run.second, 2);
+                    else if (run.first == 17)
+                        writer.write(run.second, 3);
+                    else if (run.first == 18)
+                        writer.write(run.second, 7);
+                }
+
+                uint16_t literal_codes[286];
+                canonical_codes(literal_lengths, 286, literal_codes);
+                uint16_t distance_codes[30];
+                canonical_codes(distance_lengths, 30, distance_codes);
+
+                for (auto&& symbol : symbols)
+                {
+                    if (symbol.length_or_literal < 256)
+                    {
+                        writer.write(literal_codes[symbol.length_or_literal], literal_lengths[symbol.length_or_literal]);
+                        continue;
+                    }
+
+                    const size_t length = symbol.length_or_literal - 256;
+                    const int length_code = length_symbol(length);
+                    writer.write(literal_codes[257 + length_code], literal_lengths[257 + length_code]);
+                    writer.write(static_cast<uint32_t>(length - LENGTH_BASE[length_code]), LENGTH_EXTRA[length_code]);
+
+                    const int distance_code = distance_symbol(symbol.distance);
+                    writer.write(distance_codes[distance_code], distance_lengths[distance_code]);
+                    writer.write(static_cast<uint32_t>(symbol.distance - DISTANCE_BASE[distance_code]),
+                                 DISTANCE_EXTRA[distance_code]);
+                }
+                writer.write(literal_codes[256], literal_lengths[256]);
+
+                symbols.clear();
+            }
+
+            void write_stored(size_t block_start, size_t block_end, bool is_final)
+            {
+                do
+                {
+                    const size_t length = std::min<size_t>(block_end - block_start, 0xFFFF);
+                    const bool is_last_chunk = block_start + length == block_end;
+                    writer.write(is_final && is_last_chunk ? 1 : 0, 1);
+                    writer.write(0, 2);
+                    writer.align_to_byte();
+                    writer.write(static_cast<uint32_t>(length), 16);
+                    writer.write(static_cast<uint32_t>(~length & 0xFFFF), 16);
+                    writer.output.insert(writer.output.end(), at(block_start), at(block_start) + length);
+                    block_start += length;
+                } while (block_start != block_end);
+            }
+
+            ByteSink sink;
+            std::vector<unsigned char> buffer;
+            size_t buffer_start = 0;
+            size_t pos = 0;
+            size_t block_start = 0;
+            std::vector<int64_t> head;
+            std::vector<int64_t> previous;
+            std::vector<Lz77Symbol> symbols;
+            BitWriter writer;
+        };
+    }
+
+    std::vector<unsigned char> deflate(const unsigned char* data, size_t size)
+    {
+        std::vector<unsigned char> output;
+        DeflateEncoder encoder(
+            [&](const unsigned char* piece, size_t length) { output.insert(output.end(), piece, piece + length); });
+        for (size_t offset = 0; offset < size; offset += STREAM_CHUNK_SIZE)
+            encoder.add(data + offset, std::min(STREAM_CHUNK_SIZE, size - offset));
+        encoder.finish();
+        return output;
+    }
+
+    void deflate_stream(const ByteSource& source, const ByteSink& sink)
+    {
+        DeflateEncoder encoder(sink);
+        std::vector<unsigned char> chunk(STREAM_CHUNK_SIZE);
+        while (const size_t size = source(chunk.data(), chunk.size()))
+            encoder.add(chunk.data(), size);
+        encoder.finish();
+    }
+}
@@ -2,12 +2,13 @@
 
 #include <vcpkg/base/downloads.h>
 #include <vcpkg/base/hash.h>
+#include <vcpkg/base/strings.h>
+#include <vcpkg/base/system.h>
+#include <vcpkg/base/trace.h>
 #include <vcpkg/base/util.h>
 
 #if defined(_WIN32)
 #include <VersionHelpers.h>
-#else
-#include <vcpkg/base/system.h>
 #endif
 
 namespace vcpkg::Downloads
@@ -97,13 +98,8 @@ namespace vcpkg::Downloads
     }
 #endif
 
-    void verify_downloaded_file_hash(const Files::Filesystem& fs,
-                                     const std::string& url,
-                                     const fs::path& path,
-                                     const std::string& sha512)
+    static std::string apply_known_hash_changes(std::string actual_hash)
     {
-        std::string actual_hash = vcpkg::Hash::get_file_hash(fs, path, "SHA512");
-
         // <HACK to handle NuGet.org changing nupkg hashes.>
         // This is the NEW hash for 7zip
         if (actual_hash == "a9dfaaafd15d98a2ac83682867ec5766720acf6e99d40d1a00d480692752603bf3f3742623f0ea85647a92374df"
@@ -112,50 +108,598 @@ namespace vcpkg::Downloads
             actual_hash = "8c75314102e68d2b2347d592f8e3eb05812e1ebb525decbac472231633753f1d4ca31c8e6881a36144a8da26b257"
                           "1305b3ae3f4e2b85fc4a290aeda63d1a13b8";
         // </HACK>
+        return actual_hash;
+    }
 
-        Checks::check_exit(VCPKG_LINE_INFO,
-                           sha512 == actual_hash,
-                           "File does not have the expected hash:\n"
-                           "             url : [ %s ]\n"
-                           "       File path : [ %s ]\n"
-                           "   Expected hash : [ %s ]\n"
-                           "     Actual hash : [ %s ]\n",
-                           url,
-                           path.u8string(),
-                           sha512,
-                           actual_hash);
+    [[noreturn]] static void exit_with_hash_mismatch(const std::string& url,
+                                                     const fs::path& path,
+                                                     const std::string& sha512,
+                                                     const std::string& actual_hash)
+    {
+        Checks::exit_with_message(VCPKG_LINE_INFO,
+                                  "File does not have the expected hash:\n"
+                                  "             url : [ %s ]\n"
+                                  "       File path : [ %s ]\n"
+                                  "   Expected hash : [ %s ]\n"
+                                  "     Actual hash : [ %s ]\n",
+                                  url,
+                                  path.u8string(),
+                                  sha512,
+                                  actual_hash);
+    }
+
+    void verify_downloaded_file_hash(const Files::Filesystem& fs,
+                                     const std::string& url,
+                                     const fs::path& path,
+                                     const std::string& sha512)
+    {
+        const std::string actual_hash = apply_known_hash_changes(vcpkg::Hash::get_file_hash(fs, path, "SHA512"));
+        if (sha512 != actual_hash) exit_with_hash_mismatch(url, path, sha512, actual_hash);
+    }
+
+    std::string AssetSource::location_of(const std::string& sha512) const
+    {
+        if (kind == Kind::FILES) return (fs::u8path(location) / sha512).u8string();
+        return location + "/" + sha512;
+    }
+
+    std::string AssetSource::to_string() const
+    {
+        return Strings::format("%s,%s,%s",
+                               kind == Kind::FILES ? "files" : "http",
+                               location,
+                               can_read && can_write ? "readwrite" : (can_write ? "write" : "read"));
+    }
+
+    ExpectedT<std::vector<AssetSource>, std::string> parse_asset_sources(const std::string& sources)
+    {
+        std::vector<AssetSource> ret;
+        for (auto&& source : Strings::split(sources, ";"))
+        {
+            if (source.empty()) continue;
+
+            const auto fields = Strings::split(source, ",");
+            if (fields.size() < 2 || fields.at(1).empty()) return "expected a path or URL in asset source: " + source;
+            if (fields.size() > 3) return "too many arguments in asset source: " + source;
+
+            AssetSource asset_source{AssetSource::Kind::FILES, fields.at(1), true, false};
+            if (fields.at(0) == "http")
+            {
+                asset_source.kind = AssetSource::Kind::HTTP;
+                while (!asset_source.location.empty() && asset_source.location.back() == '/')
+                    asset_source.location.pop_back();
+                if (asset_source.location.empty()) return "expected a URL in asset source: " + source;
+            }
+            else if (fields.at(0) != "files")
+            {
+                return Strings::format("unknown asset source kind '%s' in '%s'", fields.at(0), source);
+            }
+
+            if (fields.size() == 3)
+            {
+                const std::string& access = fields.at(2);
+                if (access != "read" && access != "write" && access != "readwrite")
+                {
+                    return Strings::format("invalid access '%s' in asset source '%s', expected one of: %s",
+                                           access,
+                                           source,
+                                           "read, write, readwrite");
+                }
+                asset_source.can_read = access != "write";
+                asset_source.can_write = access != "read";
+            }
+
+            ret.push_back(std::move(asset_source));
+        }
+        return std::move(ret);
+    }
+
+    const std::vector<AssetSource>& get_asset_sources()
+    {
+        static const std::vector<AssetSource> s_sources = []() {
+            const auto sources = System::get_environment_variable("VCPKG_ASSET_SOURCES").value_or("");
+            auto maybe_sources = parse_asset_sources(sources);
+            if (const auto parsed = maybe_sources.get()) return std::move(*parsed);
+
+            Checks::exit_with_message(
+                VCPKG_LINE_INFO, "Error: invalid VCPKG_ASSET_SOURCES: %s", maybe_sources.error());
+        }();
+        return s_sources;
     }
 
+    // --fail turns HTTP errors into a non-zero exit code.
+    static bool curl_asset(const std::vector<std::string>& arguments)
+    {
+        std::vector<std::string> argv{"curl", "--silent", "--fail", "--location"};
+        argv.insert(argv.end(), arguments.begin(), arguments.end());
+        return System::spawn_and_capture_output(argv).exit_code == 0;
+    }
+
+    Optional<std::string> fetch_from_asset_sources(Files::Filesystem& fs,
+                                                   const std::string& sha512,
+                                                   const fs::path& path)
+    {
+        std::error_code ec;
+        for (auto&& source : get_asset_sources())
+        {
+            if (!source.can_read) continue;
+
+            const auto location = source.location_of(sha512);
+            fs.create_directories(path.parent_path(), ec);
+
+            bool fetched;
+            if (source.kind == AssetSource::Kind::FILES)
+            {
+                const auto source_path = fs::u8path(location);
+                fetched = fs.exists(source_path);
+                if (fetched)
+                {
+                    fs.copy_file(source_path, path, fs::stdfs::copy_options::overwrite_existing, ec);
+                    fetched = !ec;
+                }
+            }
+            else
+            {
+                fetched = curl_asset({"--output", path.u8string(), location});
+            }
+
+            if (fetched && apply_known_hash_changes(Hash::get_file_hash(fs, path, "SHA512")) == sha512)
+            {
+                return location;
+            }
+            fs.remove(path, ec);
+        }
+        return nullopt;
+    }
+
+    void store_to_asset_sources(Files::Filesystem& fs, const std::string& sha512, const fs::path& path)
+    {
+        for (auto&& source : get_asset_sources())
+        {
+            if (!source.can_write) continue;
+
+            const auto location = source.location_of(sha512);
+            std::error_code ec;
+            if (source.kind == AssetSource::Kind::FILES)
+            {
+                const auto destination = fs::u8path(location);
+                if (fs.exists(destination)) continue;
+
+                // Copy under a temporary name first, so that readers never see a partial file.
+                const auto nonce = std::chrono::high_resolution_clock::now().time_since_epoch().count() ^
+                                   std::hash<std::thread::id>()(std::this_thread::get_id());
+                const auto tmp = destination.parent_path() /
+                                 Strings::format("%s.%llx.tmp", sha512, static_cast<unsigned long long>(nonce));
+                fs.create_directories(destination.parent_path(), ec);
+                fs.copy_file(path, tmp, fs::stdfs::copy_options::none, ec);
+                if (!ec) fs.rename(tmp, destination, ec);
+                if (ec) fs.remove(tmp, ec);
+            }
+            else if (!curl_asset({"--upload-file", path.u8string(), location}))
+            {
+                ec = std::make_error_code(std::errc::io_error);
+            }
+
+            if (ec)
+            {
+                System::println(System::Color::warning, "Warning: failed to store %s to %s", path.u8string(), location);
+            }
+        }
+    }
+
+    RemoteFileInfo parse_response_headers(const std::string& headers)
+    {
+        RemoteFileInfo info;
+        bool success = false;
+        bool partial_content = false;
+        bool has_content_range = false;
+        for (auto&& raw_line : Strings::split(headers, "\n"))
+        {
+            const std::string line = Strings::trim(std::string(raw_line));
+            if (Strings::case_insensitive_ascii_starts_with(line, "HTTP/"))
+            {
+                // A new response in the redirect chain; forget the previous one.
+                info = RemoteFileInfo();
+                const auto status_begin = line.find(' ');
+                success = status_begin != std::string::npos && line.size() > status_begin + 1 &&
+                          line[status_begin + 1] == '2';
+                partial_content = success && line.compare(status_begin + 1, 3, "206") == 0;
+                has_content_range = false;
+                continue;
+            }
+
+            const auto colon = line.find(':');
+            if (colon == std::string::npos) continue;
+            const auto name = line.substr(0, colon);
+            const auto value = Strings::trim(line.substr(colon + 1));
+
+            if (Strings::case_insensitive_ascii_equals(name, "Content-Length"))
+            {
+                char* end;
+                const auto size = std::strtoull(value.c_str(), &end, 10);
+                if (!value.empty() && *end == '\0') info.size = static_cast<std::uint64_t>(size);
+            }
+            else if (Strings::case_insensitive_ascii_equals(name, "Accept-Ranges"))
+            {
+                info.accepts_ranges = Strings::case_insensitive_ascii_equals(value, "bytes");
+            }
+            else if (Strings::case_insensitive_ascii_equals(name, "Content-Range"))
+            {
+                has_content_range = true;
+            }
+        }
+
+        if (!success) return RemoteFileInfo();
+        info.is_partial = partial_content && has_content_range;
+        return info;
+    }
+
+    static constexpr std::uint64_t MIN_SEGMENT_SIZE = 16 * 1024 * 1024;
+    static constexpr std::uint64_t MAX_SEGMENTS = 4;
+
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> split_into_segments(std::uint64_t size)
+    {
+        std::vector<std::pair<std::uint64_t, std::uint64_t>> segments;
+        if (size == 0) return segments;
+
+        const std::uint64_t count = std::max<std::uint64_t>(1, std::min(MAX_SEGMENTS, size / MIN_SEGMENT_SIZE));
+        const std::uint64_t segment_size = (size + count - 1) / count;
+        for (std::uint64_t first = 0; first < size; first += segment_size)
+        {
+            segments.emplace_back(first, std::min(size, first + segment_size) - 1);
+        }
+        return segments;
+    }
+
+#if !defined(_WIN32)
+    static constexpr size_t DOWNLOAD_BUFFER_SIZE = 64 * 1024;
+
+    // curl's exit code when a server does not honor `--continue-at`.
+    static constexpr int CURL_RANGE_ERROR = 33;
+
+    static std::uint64_t file_size_or_zero(const fs::path& path)
+    {
+        std::error_code ec;
+        const auto size = fs::stdfs::file_size(path, ec);
+        return ec ? 0 : static_cast<std::uint64_t>(size);
+    }
+
+    /// <summary>
+    /// Returns the offset just past the headers of the final response in `text`, the output of
+    /// `curl --include --location`, or npos if they have not all arrived yet. Interim and redirect responses, which
+    /// curl prints without a body, are skipped.
+    /// </summary>
+    static size_t find_end_of_final_headers(const std::string& text)
+    {
+        size_t block_begin = 0;
+        for (;;)
+        {
+            size_t end = text.find("\r\n\r\n", block_begin);
+            size_t separator_size = 4;
+            const size_t lf_end = text.find("\n\n", block_begin);
+            if (lf_end < end)
+            {
+                end = lf_end;
+                separator_size = 2;
+            }
+            if (end == std::string::npos) return std::string::npos;
+
+            const auto status_begin = text.find(' ', block_begin);
+            const char status_class = status_begin + 1 < end ? text[status_begin + 1] : '2';
+            block_begin = end + separator_size;
+            if (status_class != '1' && status_class != '3') return block_begin;
+        }
+    }
+
+    /// <summary>
+    /// Appends the output of `curl <arguments>` to `target`, feeding it to `hasher` if one is given. Returns the exit
+    /// code of curl, or -1 if `target` could not be written.
+    /// If `on_response` is given, the headers of the final response are passed to it as soon as they have arrived,
+    /// before any of the body is written.
+    /// </summary>
+    static int curl_append(const std::vector<std::string>& arguments,
+                           const fs::path& target,
+                           Hash::Hasher* hasher,
+                           const std::function<void(const RemoteFileInfo&)>& on_response = nullptr)
+    {
+        FILE* out = fopen(target.c_str(), "ab");
+        if (!out) return -1;
+
+        std::vector<std::string> argv{"curl", "--fail", "--location"};
+        if (on_response) argv.push_back("--include");
+        argv.insert(argv.end(), arguments.begin(), arguments.end());
+
+        bool write_error = false;
+        bool in_headers = static_cast<bool>(on_response);
+        std::string headers;
+        System::ProcessOptions options;
+        options.output = System::ProcessOutput::CAPTURE;
+        options.on_output = [&](const char* data, size_t size) {
+            if (in_headers)
+            {
+                headers.append(data, size);
+                const auto headers_end = find_end_of_final_headers(headers);
+                if (headers_end == std::string::npos) return;
+
+                in_headers = false;
+                on_response(parse_response_headers(headers.substr(0, headers_end)));
+                data = headers.data() + headers_end;
+                size = headers.size() - headers_end;
+            }
+            if (hasher) hasher->add_bytes(data, data + size);
+            write_error |= fwrite(data, 1, size, out) != size;
+        };
+        const auto exit_code = System::spawn(argv, options).wait().exit_code;
+
+        write_error |= fclose(out) != 0;
+        return write_error ? -1 : exit_code;
+    }
+
+    static void hash_file_contents(const fs::path& path, Hash::Hasher& hasher, FILE* copy_to)
+    {
+        FILE* in = fopen(path.c_str(), "rb");
+        Checks::check_exit(VCPKG_LINE_INFO, in != nullptr, "Failed to open file: %s", path.u8string());
+
+        const auto buffer = std::make_unique<char[]>(DOWNLOAD_BUFFER_SIZE);
+        bool write_error = false;
+        while (const auto size = fread(buffer.get(), 1, DOWNLOAD_BUFFER_SIZE, in))
+        {
+            hasher.add_bytes(buffer.get(), buffer.get() + size);
+            if (copy_to) write_error |= fwrite(buffer.get(), 1, size, copy_to) != size;
+        }
+        const bool read_error = ferror(in) != 0;
+        fclose(in);
+        Checks::check_exit(VCPKG_LINE_INFO, !read_error && !write_error, "Failed to copy file: %s", path.u8string());
+    }
+
+    static fs::path segment_path(const fs::path& part_path, size_t index)
+    {
+        return fs::path(part_path).concat("." + std::to_string(index));
+    }
+
+    /// <summary>
+    /// Downloads into `part_path` with one curl process, resuming from whatever the file already holds, and returns
+    /// the SHA512 of the complete file. If the server refuses to resume, the file is downloaded again from the start.
+    /// </summary>
+    static std::string download_single(Files::Filesystem& fs,
+                                       const std::string& url,
+                                       const fs::path& part_path,
+                                       const RemoteFileInfo& info)
+    {
+        auto hasher = Hash::get_hasher_for(Hash::Algorithm::SHA512);
+
+        std::error_code ec;
+        auto existing = file_size_or_zero(part_path);
+        const auto size = info.size.get();
+        if (existing != 0 && (!info.accepts_ranges || (size && existing > *size)))
+        {
+            fs.remove(part_path, ec);
+            existing = 0;
+        }
+
+        if (existing != 0)
+        {
+            System::println("Resuming download of %s at %llu bytes", url, static_cast<unsigned long long>(existing));
+            hash_file_contents(part_path, *hasher, nullptr);
+        }
+
+        if (!size || existing < *size)
+        {
+            std::vector<std::string> arguments;
+            if (existing != 0) arguments = {"--continue-at", std::to_string(existing)};
+            arguments.push_back(url);
+            auto exit_code = curl_append(arguments, part_path, hasher.get());
+            if (exit_code == CURL_RANGE_ERROR && existing != 0)
+            {
+                // The server advertised ranges but answered with the whole file. The partial file would make every
+                // later attempt fail the same way, so it is dropped.
+                System::println("Could not resume download of %s, restarting it", url);
+                fs.remove(part_path, ec);
+                hasher = Hash::get_hasher_for(Hash::Algorithm::SHA512);
+                exit_code = curl_append({url}, part_path, hasher.get());
+            }
+            Checks::check_exit(VCPKG_LINE_INFO, exit_code == 0, "Could not download %s", url);
+        }
+
+        return hasher->get_hash();
+    }
+
+    /// <summary>
+    /// Downloads the byte ranges of `url` concurrently into `<part_path>.<n>`, each resumable on its own, then joins
+    /// them into `part_path`. The join is the only pass over the data and also computes its SHA512, which is returned.
+    /// The first segment is requested alone until its response shows whether the server honors ranges; if it does
+    /// not, that response holds the whole file and becomes the download.
+    /// </summary>
+    static std::string download_segmented(Files::Filesystem& fs,
+                                          const std::string& url,
+                                          const fs::path& part_path,
+                                          const std::vector<std::pair<std::uint64_t, std::uint64_t>>& segments)
+    {
+        System::println("Downloading %s in %zu parallel segments", url, segments.size());
+
+        std::mutex mutex;
+        std::condition_variable ranges_known;
+        Optional<bool> ranges_honored;
+        const auto set_ranges_honored = [&](bool honored) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (ranges_honored.has_value()) return;
+            ranges_honored = honored;
+            ranges_known.notify_all();
+        };
+
+        std::vector<char> succeeded(segments.size(), 0);
+        bool whole_file = false;
+        int whole_file_exit_code = 0;
+        Util::parallel_for_each_n(
+            segments.size(),
+            [&](size_t i) {
+                if (i != 0)
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    ranges_known.wait(lock, [&]() { return ranges_honored.has_value(); });
+                    if (!*ranges_honored.get()) return;
+                }
+
+                const auto path = segment_path(part_path, i);
+                const auto length = segments[i].second - segments[i].first + 1;
+                auto existing = file_size_or_zero(path);
+                if (existing > length)
+                {
+                    std::error_code ec;
+                    fs.remove(path, ec);
+                    existing = 0;
+                }
+
+                if (existing < length)
+                {
+                    const auto range = Strings::format("%llu-%llu",
+                                                       static_cast<unsigned long long>(segments[i].first + existing),
+                                                       static_cast<unsigned long long>(segments[i].second));
+                    std::function<void(const RemoteFileInfo&)> on_response;
+                    if (i == 0)
+                    {
+                        on_response = [&](const RemoteFileInfo& response) {
+                            if (!response.is_partial)
+                            {
+                                System::println("%s does not honor range requests, downloading it in one piece", url);
+                                std::error_code ec;
+                                fs::stdfs::resize_file(path, 0, ec);
+                                whole_file = true;
+                            }
+                            set_ranges_honored(response.is_partial);
+                        };
+                    }
+
+                    const auto exit_code =
+                        curl_append({"--silent", "--show-error", "--range", range, url}, path, nullptr, on_response);
+                    if (i == 0)
+                    {
+                        whole_file_exit_code = exit_code;
+                        // Without a response, the other segments would most likely fail the same way.
+                        set_ranges_honored(false);
+                    }
+                    if (exit_code != 0) return;
+                }
+                if (i == 0) set_ranges_honored(true);
+                succeeded[i] = file_size_or_zero(path) == length;
+            },
+            segments.size());
+
+        std::error_code ec;
+        const auto hasher = Hash::get_hasher_for(Hash::Algorithm::SHA512);
+        if (whole_file)
+        {
+            Checks::check_exit(VCPKG_LINE_INFO, whole_file_exit_code == 0, "Could not download %s", url);
+            for (size_t i = 1; i < segments.size(); ++i)
+            {
+                fs.remove(segment_path(part_path, i), ec);
+            }
+            fs.rename(segment_path(part_path, 0), part_path, ec);
+            Checks::check_exit(VCPKG_LINE_INFO, !ec, "Failed to rename file: %s", part_path.u8string());
+            hash_file_contents(part_path, *hasher, nullptr);
+            return hasher->get_hash();
+        }
+
+        for (size_t i = 0; i < segments.size(); ++i)
+        {
+            Checks::check_exit(VCPKG_LINE_INFO, succeeded[i] != 0, "Could not download segment %zu of %s", i, url);
+        }
+
+        FILE* out = fopen(part_path.c_str(), "wb");
+        Checks::check_exit(VCPKG_LINE_INFO, out != nullptr, "Failed to open file: %s", part_path.u8string());
+        for (size_t i = 0; i < segments.size(); ++i)
+        {
+            hash_file_contents(segment_path(part_path, i), *hasher, out);
+        }
+        Checks::check_exit(VCPKG_LINE_INFO, fclose(out) == 0, "Failed to write file: %s", part_path.u8string());
+
+        for (size_t i = 0; i < segments.size(); ++i)
+        {
+            fs.remove(segment_path(part_path, i), ec);
+        }
+        return hasher->get_hash();
+    }
+
+    static std::string curl_download_file(Files::Filesystem& fs, const std::string& url, const fs::path& part_path)
+    {
+        std::error_code ec;
+        fs.create_directories(part_path.parent_path(), ec);
+
+        const auto headers = System::spawn_and_capture_output({"curl", "--silent", "--head", "--location", url});
+        const auto info = headers.exit_code == 0 ? parse_response_headers(headers.output) : RemoteFileInfo();
+
+        const auto size = info.size.get();
+        const auto segments = info.accepts_ranges && size ? split_into_segments(*size)
+                                                          : std::vector<std::pair<std::uint64_t, std::uint64_t>>();
+        if (segments.size() > 1)
+        {
+            fs.remove(part_path, ec);
+            return download_segmented(fs, url, part_path, segments);
+        }
+
+        for (size_t i = 0; i < MAX_SEGMENTS; ++i)
+        {
+            fs.remove(segment_path(part_path, i), ec);
+        }
+        return download_single(fs, url, part_path, info);
+    }
+#endif
+
     void download_file(vcpkg::Files::Filesystem& fs,
                        const std::string& url,
                        const fs::path& download_path,
                        const std::string& sha512)
     {
-        const std::string download_path_part = download_path.u8string() + ".part";
+        const Trace::Span span("download", download_path.filename().u8string());
+        const fs::path download_path_part = download_path.u8string() + ".part";
         std::error_code ec;
         fs.remove(download_path, ec);
-        fs.remove(download_path_part, ec);
+
+        // Fetched next to the .part file rather than into it, which may hold a download to resume.
+        const fs::path download_path_asset = download_path.u8string() + ".asset";
+        const auto maybe_asset = fetch_from_asset_sources(fs, sha512, download_path_asset);
+        if (const auto location = maybe_asset.get())
+        {
+            System::println("Using cached asset: %s", *location);
+            fs.rename(download_path_asset, download_path, ec);
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               !ec,
+                               "Failed to rename %s to %s: %s",
+                               download_path_asset.u8string(),
+                               download_path.u8string(),
+                               ec.message());
+            return;
+        }
+
 #if defined(_WIN32)
+        fs.remove(download_path_part, ec);
+
         auto url_no_proto = url.substr(8); // drop https://
         auto path_begin = Util::find(url_no_proto, '/');
         std::string hostname(url_no_proto.begin(), path_begin);
         std::string path(path_begin, url_no_proto.end());
 
-        winhttp_download_file(fs, download_path_part.c_str(), hostname, path);
+        winhttp_download_file(fs, download_path_part.u8string().c_str(), hostname, path);
+        verify_downloaded_file_hash(fs, url, download_path_part, sha512);
 #else
-        const auto code = System::cmd_execute(
-            Strings::format(R"(curl -L '%s' --create-dirs --output '%s')", url, download_path_part));
-        Checks::check_exit(VCPKG_LINE_INFO, code == 0, "Could not download %s", url);
+        const auto actual_hash = apply_known_hash_changes(curl_download_file(fs, url, download_path_part));
+        if (sha512 != actual_hash)
+        {
+            // Resuming from a corrupt file would fail the same way, so start over next time.
+            fs.remove(download_path_part, ec);
+            exit_with_hash_mismatch(url, download_path_part, sha512, actual_hash);
+        }
 #endif
 
-        verify_downloaded_file_hash(fs, url, download_path_part, sha512);
         fs.rename(download_path_part, download_path, ec);
         Checks::check_exit(VCPKG_LINE_INFO,
                            !ec,
                            "Failed to do post-download rename-in-place.\n"
                            "fs.rename(%s, %s, %s)",
-                           download_path_part,
+                           download_path_part.u8string(),
                            download_path.u8string(),
                            ec.message());
+
+        store_to_asset_sources(fs, sha512, download_path);
     }
 }
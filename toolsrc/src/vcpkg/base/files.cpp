@@ -1,17 +1,23 @@
 #include "pch.h"
 
 #include <vcpkg/base/files.h>
+#include <vcpkg/base/stats.h>
 #include <vcpkg/base/system.h>
 #include <vcpkg/base/util.h>
 
 #if defined(__linux__)
 #include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
 #include <sys/sendfile.h>
-#include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 #endif
 
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#endif
+
 namespace vcpkg::Files
 {
     static const std::regex FILESYSTEM_INVALID_CHARACTERS_REGEX = std::regex(R"([\/:*?"<>|])");
@@ -24,6 +30,104 @@ namespace vcpkg::Files
             VCPKG_LINE_INFO, !ec, "error while writing file: %s: %s", file_path.u8string(), ec.message());
     }
 
+    void Filesystem::append_contents(const fs::path& file_path, const std::string& data)
+    {
+        std::error_code ec;
+        append_contents(file_path, data, ec);
+        Checks::check_exit(
+            VCPKG_LINE_INFO, !ec, "error while appending to file: %s: %s", file_path.u8string(), ec.message());
+    }
+
+#if defined(__linux__)
+    static bool copy_file_contents(int i_fd, int o_fd, off_t size)
+    {
+#if defined(FICLONE)
+        // Shares the extents of the source where the file system supports it (btrfs, XFS), copying no data at all.
+        if (ioctl(o_fd, FICLONE, i_fd) == 0) return true;
+#endif
+
+        off_t copied = 0;
+        while (copied < size)
+        {
+            const auto written = copy_file_range(i_fd, nullptr, o_fd, nullptr, static_cast<size_t>(size - copied), 0);
+            if (written <= 0) break;
+            copied += written;
+        }
+        if (copied == size) return true;
+
+        // copy_file_range is not available on older kernels or across file systems; sendfile still copies in the
+        // kernel.
+        off_t offset = copied;
+        while (offset < size)
+        {
+            const auto written = sendfile(o_fd, i_fd, &offset, static_cast<size_t>(size - offset));
+            if (written <= 0) return false;
+        }
+        return true;
+    }
+
+    /// <summary>
+    /// Copies a regular file without passing its data through user space. Returns false for `opts` it does not handle,
+    /// which are left to std::filesystem.
+    /// </summary>
+    static bool kernel_copy_file(const fs::path& oldpath,
+                                 const fs::path& newpath,
+                                 fs::copy_options opts,
+                                 std::error_code& ec)
+    {
+        if (opts != fs::copy_options::none && opts != fs::copy_options::overwrite_existing) return false;
+
+        ec.clear();
+        const int i_fd = open(oldpath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (i_fd == -1)
+        {
+            ec.assign(errno, std::generic_category());
+            return true;
+        }
+
+        struct stat info = {0};
+        if (fstat(i_fd, &info) != 0 || !S_ISREG(info.st_mode))
+        {
+            close(i_fd);
+            return false;
+        }
+
+        // Truncating only once the target is known not to be the source itself, directly or through a link; like
+        // std::filesystem, copying a file onto itself is an error.
+        const int o_flags =
+            O_WRONLY | O_CREAT | O_CLOEXEC | (opts == fs::copy_options::overwrite_existing ? 0 : O_EXCL);
+        const int o_fd = open(newpath.c_str(), o_flags, info.st_mode & 07777);
+        if (o_fd == -1)
+        {
+            ec.assign(errno, std::generic_category());
+            close(i_fd);
+            return true;
+        }
+
+        struct stat target_info = {0};
+        if (fstat(o_fd, &target_info) != 0)
+            ec.assign(errno, std::generic_category());
+        else if (target_info.st_dev == info.st_dev && target_info.st_ino == info.st_ino)
+            ec = std::make_error_code(std::errc::file_exists);
+        else if (ftruncate(o_fd, 0) != 0)
+            ec.assign(errno, std::generic_category());
+        if (ec)
+        {
+            close(i_fd);
+            close(o_fd);
+            return true;
+        }
+
+        if (!copy_file_contents(i_fd, o_fd, info.st_size) || fchmod(o_fd, info.st_mode & 07777) != 0)
+        {
+            ec.assign(errno != 0 ? errno : EIO, std::generic_category());
+        }
+        close(i_fd);
+        if (close(o_fd) != 0 && !ec) ec.assign(errno, std::generic_category());
+        return true;
+    }
+#endif
+
     struct RealFilesystem final : Filesystem
     {
         virtual Expected<std::string> read_contents(const fs::path& file_path) const override
@@ -48,6 +152,8 @@ namespace vcpkg::Files
             file_stream.read(&output[0], length);
             file_stream.close();
 
+            Stats::add(Stats::Counter::FILES_READ);
+            Stats::add(Stats::Counter::BYTES_READ, output.size());
             return std::move(output);
         }
         virtual Expected<std::vector<std::string>> read_lines(const fs::path& file_path) const override
@@ -60,12 +166,17 @@ namespace vcpkg::Files
 
             std::vector<std::string> output;
             std::string line;
+            std::uint64_t bytes = 0;
             while (std::getline(file_stream, line))
             {
+                bytes += line.size() + 1;
                 output.push_back(line);
             }
             file_stream.close();
 
+            Stats::add(Stats::Counter::FILES_READ);
+            Stats::add(Stats::Counter::BYTES_READ, bytes);
+
             return std::move(output);
         }
         virtual fs::path find_file_recursively_up(const fs::path& starting_dir,
@@ -92,6 +203,7 @@ namespace vcpkg::Files
             std::error_code ec;
             fs::stdfs::recursive_directory_iterator b(dir, ec), e{};
             if (ec) return ret;
+            Stats::add(Stats::Counter::DIRECTORIES_LISTED);
             for (; b != e; ++b)
             {
                 ret.push_back(b->path());
@@ -107,6 +219,7 @@ namespace vcpkg::Files
             std::error_code ec;
             fs::stdfs::directory_iterator b(dir, ec), e{};
             if (ec) return ret;
+            Stats::add(Stats::Counter::DIRECTORIES_LISTED);
             for (; b != e; ++b)
             {
                 ret.push_back(b->path());
@@ -118,11 +231,16 @@ namespace vcpkg::Files
         virtual void write_lines(const fs::path& file_path, const std::vector<std::string>& lines) override
         {
             std::fstream output(file_path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+            std::uint64_t bytes = 0;
             for (const std::string& line : lines)
             {
                 output << line << "\n";
+                bytes += line.size() + 1;
             }
             output.close();
+
+            Stats::add(Stats::Counter::FILES_WRITTEN);
+            Stats::add(Stats::Counter::BYTES_WRITTEN, bytes);
         }
 
         virtual void rename(const fs::path& oldpath, const fs::path& newpath, std::error_code& ec) override
@@ -214,6 +332,10 @@ namespace vcpkg::Files
                                fs::copy_options opts,
                                std::error_code& ec) override
         {
+            Stats::add(Stats::Counter::FILES_COPIED);
+#if defined(__linux__)
+            if (kernel_copy_file(oldpath, newpath, opts, ec)) return !ec;
+#endif
             return fs::stdfs::copy_file(oldpath, newpath, opts, ec);
         }
         virtual void copy_symlink(const fs::path& oldpath, const fs::path& newpath, std::error_code& ec)
@@ -229,15 +351,54 @@ namespace vcpkg::Files
         {
             return fs::stdfs::symlink_status(path, ec);
         }
+        virtual FileStamp stamp(const fs::path& path, std::error_code& ec) const override
+        {
+#if defined(_WIN32)
+            const auto last_write = fs::stdfs::last_write_time(path, ec);
+            if (ec) return FileStamp();
+            const auto size = fs::stdfs::file_size(path, ec);
+            if (ec) return FileStamp();
+            return FileStamp{
+                size, std::chrono::duration_cast<std::chrono::nanoseconds>(last_write.time_since_epoch()).count(), 0};
+#else
+            // One stat instead of separate calls for the size and the time, and the only way to get the inode.
+            struct stat info = {0};
+            if (::stat(path.c_str(), &info) != 0)
+            {
+                ec.assign(errno, std::generic_category());
+                return FileStamp();
+            }
+            ec.clear();
+#if defined(__APPLE__)
+            const auto& mtime = info.st_mtimespec;
+#else
+            const auto& mtime = info.st_mtim;
+#endif
+            return FileStamp{static_cast<std::uintmax_t>(info.st_size),
+                             std::int64_t(mtime.tv_sec) * 1000000000 + std::int64_t(mtime.tv_nsec),
+                             static_cast<std::uint64_t>(info.st_ino)};
+#endif
+        }
         virtual void write_contents(const fs::path& file_path, const std::string& data, std::error_code& ec) override
+        {
+            write_contents_with_mode(file_path, data, false, ec);
+        }
+        virtual void append_contents(const fs::path& file_path, const std::string& data, std::error_code& ec) override
+        {
+            write_contents_with_mode(file_path, data, true, ec);
+        }
+        static void write_contents_with_mode(const fs::path& file_path,
+                                             const std::string& data,
+                                             const bool append,
+                                             std::error_code& ec)
         {
             ec.clear();
 
             FILE* f = nullptr;
 #if defined(_WIN32)
-            auto err = _wfopen_s(&f, file_path.native().c_str(), L"wb");
+            auto err = _wfopen_s(&f, file_path.native().c_str(), append ? L"ab" : L"wb");
 #else
-            f = fopen(file_path.native().c_str(), "wb");
+            f = fopen(file_path.native().c_str(), append ? "ab" : "wb");
             int err = f != nullptr ? 0 : 1;
 #endif
             if (err != 0)
@@ -251,6 +412,9 @@ namespace vcpkg::Files
                 auto count = fwrite(data.data(), sizeof(data[0]), data.size(), f);
                 fclose(f);
 
+                Stats::add(Stats::Counter::FILES_WRITTEN);
+                Stats::add(Stats::Counter::BYTES_WRITTEN, count);
+
                 if (count != data.size())
                 {
                     ec = std::make_error_code(std::errc::no_space_on_device);
@@ -281,8 +445,7 @@ namespace vcpkg::Files
 
             return ret;
 #else
-            const std::string cmd = Strings::format("which %s", name);
-            auto out = System::cmd_execute_and_capture_output(cmd);
+            auto out = System::spawn_and_capture_output({"which", name});
             if (out.exit_code != 0)
             {
                 return {};
@@ -299,6 +462,21 @@ namespace vcpkg::Files
         return real_fs;
     }
 
+    fs::path unique_temporary_path(const fs::path& destination)
+    {
+        static std::atomic<unsigned> counter{0};
+#if defined(_WIN32)
+        const auto pid = static_cast<unsigned long long>(_getpid());
+#else
+        const auto pid = static_cast<unsigned long long>(getpid());
+#endif
+        const auto time = static_cast<unsigned long long>(
+            std::chrono::high_resolution_clock::now().time_since_epoch().count());
+        const auto filename = Strings::format(
+            "%s.%llx.%llx.%x.tmp", destination.filename().u8string(), pid, time, counter.fetch_add(1));
+        return destination.parent_path() / filename;
+    }
+
     bool has_invalid_chars_for_filesystem(const std::string& s)
     {
         return std::regex_search(s, FILESYSTEM_INVALID_CHARACTERS_REGEX);
@@ -1,30 +1,38 @@
 #include "pch.h"
 
 #include <vcpkg/base/checks.h>
+#include <vcpkg/base/hash.h>
+#include <vcpkg/base/optional.h>
+#include <vcpkg/base/stats.h>
 #include <vcpkg/base/strings.h>
-#include <vcpkg/base/system.h>
 #include <vcpkg/base/util.h>
 
-#if defined(_WIN32)
-#include <bcrypt.h>
-
-#ifndef NT_SUCCESS
-#define NT_SUCCESS(Status) (((NTSTATUS)(Status)) >= 0)
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define VCPKG_HASH_SHA_NI
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define VCPKG_TARGET_SHA_NI
+#else
+#include <cpuid.h>
+#define VCPKG_TARGET_SHA_NI __attribute__((target("sha,sse4.1")))
 #endif
 #endif
 
 namespace vcpkg::Hash
 {
-    static void verify_has_only_allowed_chars(const std::string& s)
+    Algorithm algorithm_from_string(const std::string& hash_type)
     {
-        static const std::regex ALLOWED_CHARS{"^[a-zA-Z0-9-]*$"};
-        Checks::check_exit(VCPKG_LINE_INFO,
-                           std::regex_match(s, ALLOWED_CHARS),
-                           "Only alphanumeric chars and dashes are currently allowed. String was:\n"
-                           "    % s",
-                           s);
+        const std::string upper = Strings::ascii_to_uppercase(hash_type);
+        if (upper == "SHA1") return Algorithm::SHA1;
+        if (upper == "SHA256") return Algorithm::SHA256;
+        if (upper == "SHA384") return Algorithm::SHA384;
+        if (upper == "SHA512") return Algorithm::SHA512;
+
+        Checks::exit_with_message(
+            VCPKG_LINE_INFO, "Only SHA1, SHA256, SHA384 and SHA512 hashes are supported, but %s was provided", hash_type);
     }
-#if defined(_WIN32)
+
     namespace
     {
         std::string to_hex(const unsigned char* string, const size_t bytes)
@@ -48,199 +56,730 @@ namespace vcpkg::Hash
             return output;
         }
 
-        class BCryptHasher
+        template<class UIntTy>
+        UIntTy rotate_right(const UIntTy x, const int bits)
         {
-            struct BCryptAlgorithmHandle : Util::ResourceBase
+            return (x >> bits) | (x << (sizeof(UIntTy) * 8 - bits));
+        }
+
+        template<class UIntTy>
+        UIntTy rotate_left(const UIntTy x, const int bits)
+        {
+            return (x << bits) | (x >> (sizeof(UIntTy) * 8 - bits));
+        }
+
+        template<class UIntTy>
+        UIntTy read_big_endian(const unsigned char* bytes)
+        {
+            UIntTy result = 0;
+            for (size_t i = 0; i < sizeof(UIntTy); ++i)
+            {
+                result = (result << 8) | bytes[i];
+            }
+            return result;
+        }
+
+        template<class UIntTy>
+        void write_big_endian(unsigned char* bytes, UIntTy value)
+        {
+            for (size_t i = sizeof(UIntTy); i > 0; --i)
+            {
+                bytes[i - 1] = static_cast<unsigned char>(value);
+                value >>= 8;
+            }
+        }
+
+        constexpr uint32_t SHA256_ROUND_CONSTANTS[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+        };
+
+#if defined(VCPKG_HASH_SHA_NI)
+        // The SHA extensions (SHA-NI) compute SHA-1 and SHA-256 rounds in hardware. They are checked for once; the
+        // code using them is compiled for them regardless of the target architecture and only called when present.
+        bool has_sha_ni()
+        {
+            static const bool has = [] {
+#if defined(_MSC_VER)
+                int info[4];
+                __cpuid(info, 0);
+                if (info[0] < 7) return false;
+                __cpuidex(info, 1, 0);
+                const bool sse41 = (info[2] & (1 << 19)) != 0;
+                __cpuidex(info, 7, 0);
+                return sse41 && (info[1] & (1 << 29)) != 0;
+#else
+                unsigned int eax, ebx, ecx, edx;
+                if (__get_cpuid_max(0, nullptr) < 7) return false;
+                __cpuid_count(1, 0, eax, ebx, ecx, edx);
+                const bool sse41 = (ecx & (1u << 19)) != 0;
+                __cpuid_count(7, 0, eax, ebx, ecx, edx);
+                return sse41 && (ebx & (1u << 29)) != 0;
+#endif
+            }();
+            return has;
+        }
+
+        VCPKG_TARGET_SHA_NI void sha1_process_blocks_sha_ni(uint32_t* state,
+                                                            const unsigned char* blocks,
+                                                            size_t count) noexcept
+        {
+            const __m128i byte_swap = _mm_set_epi64x(0x0001020304050607, 0x08090a0b0c0d0e0f);
+
+            // The instructions keep a, b, c, d in one register, highest lane first, and e in the highest lane of
+            // another.
+            __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0x1B);
+            __m128i e = _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0);
+
+            for (; count != 0; --count, blocks += 64)
+            {
+                const __m128i abcd_saved = abcd;
+                const __m128i e_saved = e;
+
+                // Four rounds at a time; words[q % 4] holds the message words of rounds 4q to 4q + 3.
+                __m128i words[4];
+                __m128i previous_abcd = abcd;
+                for (int q = 0; q < 20; ++q)
+                {
+                    auto& w = words[q % 4];
+                    if (q < 4)
+                    {
+                        w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + q * 16));
+                        w = _mm_shuffle_epi8(w, byte_swap);
+                    }
+                    else
+                    {
+                        w = _mm_sha1msg1_epu32(w, words[(q + 1) % 4]);
+                        w = _mm_xor_si128(w, words[(q + 2) % 4]);
+                        w = _mm_sha1msg2_epu32(w, words[(q + 3) % 4]);
+                    }
+
+                    const __m128i e_plus_w = q == 0 ? _mm_add_epi32(e, w) : _mm_sha1nexte_epu32(previous_abcd, w);
+                    previous_abcd = abcd;
+                    switch (q / 5)
+                    {
+                        case 0: abcd = _mm_sha1rnds4_epu32(abcd, e_plus_w, 0); break;
+                        case 1: abcd = _mm_sha1rnds4_epu32(abcd, e_plus_w, 1); break;
+                        case 2: abcd = _mm_sha1rnds4_epu32(abcd, e_plus_w, 2); break;
+                        default: abcd = _mm_sha1rnds4_epu32(abcd, e_plus_w, 3); break;
+                    }
+                }
+
+                e = _mm_sha1nexte_epu32(previous_abcd, e_saved);
+                abcd = _mm_add_epi32(abcd, abcd_saved);
+            }
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_shuffle_epi32(abcd, 0x1B));
+            state[4] = static_cast<uint32_t>(_mm_extract_epi32(e, 3));
+        }
+
+        VCPKG_TARGET_SHA_NI void sha256_process_blocks_sha_ni(uint32_t* state,
+                                                              const unsigned char* blocks,
+                                                              size_t count) noexcept
+        {
+            const __m128i byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0b, 0x0405060700010203);
+
+            // The instructions keep the state as the register pairs (a, b, e, f) and (c, d, g, h).
+            const __m128i dcba = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state));
+            const __m128i hgfe = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4));
+            const __m128i cdab = _mm_shuffle_epi32(dcba, 0xB1);
+            const __m128i efgh = _mm_shuffle_epi32(hgfe, 0x1B);
+            __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+            __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xF0);
+
+            for (; count != 0; --count, blocks += 64)
             {
-                BCRYPT_ALG_HANDLE handle = nullptr;
+                const __m128i abef_saved = abef;
+                const __m128i cdgh_saved = cdgh;
 
-                ~BCryptAlgorithmHandle()
+                // Four rounds at a time; words[q % 4] holds the message words of rounds 4q to 4q + 3.
+                __m128i words[4];
+                for (int q = 0; q < 16; ++q)
                 {
-                    if (handle) BCryptCloseAlgorithmProvider(handle, 0);
+                    auto& w = words[q % 4];
+                    if (q < 4)
+                    {
+                        w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + q * 16));
+                        w = _mm_shuffle_epi8(w, byte_swap);
+                    }
+                    else
+                    {
+                        w = _mm_sha256msg1_epu32(w, words[(q + 1) % 4]);
+                        w = _mm_add_epi32(w, _mm_alignr_epi8(words[(q + 3) % 4], words[(q + 2) % 4], 4));
+                        w = _mm_sha256msg2_epu32(w, words[(q + 3) % 4]);
+                    }
+
+                    __m128i w_plus_k = _mm_add_epi32(
+                        w, _mm_loadu_si128(reinterpret_cast<const __m128i*>(SHA256_ROUND_CONSTANTS + q * 4)));
+                    cdgh = _mm_sha256rnds2_epu32(cdgh, abef, w_plus_k);
+                    w_plus_k = _mm_shuffle_epi32(w_plus_k, 0x0E);
+                    abef = _mm_sha256rnds2_epu32(abef, cdgh, w_plus_k);
                 }
-            };
 
-            struct BCryptHashHandle : Util::ResourceBase
+                abef = _mm_add_epi32(abef, abef_saved);
+                cdgh = _mm_add_epi32(cdgh, cdgh_saved);
+            }
+
+            const __m128i feba = _mm_shuffle_epi32(abef, 0x1B);
+            const __m128i dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_blend_epi16(feba, dchg, 0xF0));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), _mm_alignr_epi8(dchg, feba, 8));
+        }
+#endif
+
+        struct Sha1Algorithm
+        {
+            using WordType = uint32_t;
+            static constexpr size_t BLOCK_SIZE = 64;
+            static constexpr size_t DIGEST_WORDS = 5;
+
+            void clear() noexcept { state = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0}; }
+
+            void process_block(const unsigned char* block) noexcept
             {
-                BCRYPT_HASH_HANDLE handle = nullptr;
+                WordType words[80];
+                for (size_t i = 0; i < 16; ++i)
+                    words[i] = read_big_endian<WordType>(block + i * 4);
+                for (size_t i = 16; i < 80; ++i)
+                    words[i] = rotate_left(words[i - 3] ^ words[i - 8] ^ words[i - 14] ^ words[i - 16], 1);
+
+                WordType a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+                for (size_t i = 0; i < 80; ++i)
+                {
+                    WordType f;
+                    WordType k;
+                    if (i < 20)
+                    {
+                        f = (b & c) | (~b & d);
+                        k = 0x5A827999;
+                    }
+                    else if (i < 40)
+                    {
+                        f = b ^ c ^ d;
+                        k = 0x6ED9EBA1;
+                    }
+                    else if (i < 60)
+                    {
+                        f = (b & c) | (b & d) | (c & d);
+                        k = 0x8F1BBCDC;
+                    }
+                    else
+                    {
+                        f = b ^ c ^ d;
+                        k = 0xCA62C1D6;
+                    }
 
-                ~BCryptHashHandle()
+                    const WordType tmp = rotate_left(a, 5) + f + e + k + words[i];
+                    e = d;
+                    d = c;
+                    c = rotate_left(b, 30);
+                    b = a;
+                    a = tmp;
+                }
+
+                state[0] += a;
+                state[1] += b;
+                state[2] += c;
+                state[3] += d;
+                state[4] += e;
+            }
+
+            void process_blocks(const unsigned char* blocks, size_t count) noexcept
+            {
+#if defined(VCPKG_HASH_SHA_NI)
+                if (has_sha_ni()) return sha1_process_blocks_sha_ni(state.data(), blocks, count);
+#endif
+                for (size_t i = 0; i < count; ++i)
+                    process_block(blocks + i * BLOCK_SIZE);
+            }
+
+            std::array<WordType, 5> state;
+        };
+
+        struct Sha256Algorithm
+        {
+            using WordType = uint32_t;
+            static constexpr size_t BLOCK_SIZE = 64;
+            static constexpr size_t DIGEST_WORDS = 8;
+
+            void clear() noexcept
+            {
+                state = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+            }
+
+            void process_block(const unsigned char* block) noexcept
+            {
+                WordType words[64];
+                for (size_t i = 0; i < 16; ++i)
+                    words[i] = read_big_endian<WordType>(block + i * 4);
+                for (size_t i = 16; i < 64; ++i)
+                {
+                    const WordType s0 =
+                        rotate_right(words[i - 15], 7) ^ rotate_right(words[i - 15], 18) ^ (words[i - 15] >> 3);
+                    const WordType s1 =
+                        rotate_right(words[i - 2], 17) ^ rotate_right(words[i - 2], 19) ^ (words[i - 2] >> 10);
+                    words[i] = words[i - 16] + s0 + words[i - 7] + s1;
+                }
+
+                auto local = state;
+                for (size_t i = 0; i < 64; ++i)
                 {
-                    if (handle) BCryptDestroyHash(handle);
+                    auto& a = local[0];
+                    auto& b = local[1];
+                    auto& c = local[2];
+                    auto& d = local[3];
+                    auto& e = local[4];
+                    auto& f = local[5];
+                    auto& g = local[6];
+                    auto& h = local[7];
+
+                    const WordType s1 = rotate_right(e, 6) ^ rotate_right(e, 11) ^ rotate_right(e, 25);
+                    const WordType ch = (e & f) ^ (~e & g);
+                    const WordType tmp1 = h + s1 + ch + SHA256_ROUND_CONSTANTS[i] + words[i];
+                    const WordType s0 = rotate_right(a, 2) ^ rotate_right(a, 13) ^ rotate_right(a, 22);
+                    const WordType maj = (a & b) ^ (a & c) ^ (b & c);
+                    const WordType tmp2 = s0 + maj;
+
+                    h = g;
+                    g = f;
+                    f = e;
+                    e = d + tmp1;
+                    d = c;
+                    c = b;
+                    b = a;
+                    a = tmp1 + tmp2;
                 }
-            };
 
-            static void initialize_hash_handle(BCryptHashHandle& hash_handle,
-                                               const BCryptAlgorithmHandle& algorithm_handle)
+                for (size_t i = 0; i < 8; ++i)
+                    state[i] += local[i];
+            }
+
+            void process_blocks(const unsigned char* blocks, size_t count) noexcept
+            {
+#if defined(VCPKG_HASH_SHA_NI)
+                if (has_sha_ni()) return sha256_process_blocks_sha_ni(state.data(), blocks, count);
+#endif
+                for (size_t i = 0; i < count; ++i)
+                    process_block(blocks + i * BLOCK_SIZE);
+            }
+
+            std::array<WordType, 8> state;
+        };
+
+        struct Sha512Algorithm
+        {
+            using WordType = uint64_t;
+            static constexpr size_t BLOCK_SIZE = 128;
+            static constexpr size_t DIGEST_WORDS = 8;
+
+            void clear() noexcept
             {
-                const NTSTATUS error_code =
-                    BCryptCreateHash(algorithm_handle.handle, &hash_handle.handle, nullptr, 0, nullptr, 0, 0);
-                Checks::check_exit(VCPKG_LINE_INFO, NT_SUCCESS(error_code), "Failed to initialize the hasher");
+                state = {0x6a09e667f3bcc908,
+                         0xbb67ae8584caa73b,
+                         0x3c6ef372fe94f82b,
+                         0xa54ff53a5f1d36f1,
+                         0x510e527fade682d1,
+                         0x9b05688c2b3e6c1f,
+                         0x1f83d9abfb41bd6b,
+                         0x5be0cd19137e2179};
             }
 
-            static void hash_data(BCryptHashHandle& hash_handle, const unsigned char* buffer, const size_t& data_size)
+            void process_block(const unsigned char* block) noexcept
             {
-                const NTSTATUS error_code = BCryptHashData(
-                    hash_handle.handle, const_cast<unsigned char*>(buffer), static_cast<ULONG>(data_size), 0);
-                Checks::check_exit(VCPKG_LINE_INFO, NT_SUCCESS(error_code), "Failed to hash data");
+                static constexpr WordType ROUND_CONSTANTS[80] = {
+                    0x428a2f98d728ae22, 0x7137449123ef65cd, 0xb5c0fbcfec4d3b2f, 0xe9b5dba58189dbbc, 0x3956c25bf348b538,
+                    0x59f111f1b605d019, 0x923f82a4af194f9b, 0xab1c5ed5da6d8118, 0xd807aa98a3030242, 0x12835b0145706fbe,
+                    0x243185be4ee4b28c, 0x550c7dc3d5ffb4e2, 0x72be5d74f27b896f, 0x80deb1fe3b1696b1, 0x9bdc06a725c71235,
+                    0xc19bf174cf692694, 0xe49b69c19ef14ad2, 0xefbe4786384f25e3, 0x0fc19dc68b8cd5b5, 0x240ca1cc77ac9c65,
+                    0x2de92c6f592b0275, 0x4a7484aa6ea6e483, 0x5cb0a9dcbd41fbd4, 0x76f988da831153b5, 0x983e5152ee66dfab,
+                    0xa831c66d2db43210, 0xb00327c898fb213f, 0xbf597fc7beef0ee4, 0xc6e00bf33da88fc2, 0xd5a79147930aa725,
+                    0x06ca6351e003826f, 0x142929670a0e6e70, 0x27b70a8546d22ffc, 0x2e1b21385c26c926, 0x4d2c6dfc5ac42aed,
+                    0x53380d139d95b3df, 0x650a73548baf63de, 0x766a0abb3c77b2a8, 0x81c2c92e47edaee6, 0x92722c851482353b,
+                    0xa2bfe8a14cf10364, 0xa81a664bbc423001, 0xc24b8b70d0f89791, 0xc76c51a30654be30, 0xd192e819d6ef5218,
+                    0xd69906245565a910, 0xf40e35855771202a, 0x106aa07032bbd1b8, 0x19a4c116b8d2d0c8, 0x1e376c085141ab53,
+                    0x2748774cdf8eeb99, 0x34b0bcb5e19b48a8, 0x391c0cb3c5c95a63, 0x4ed8aa4ae3418acb, 0x5b9cca4f7763e373,
+                    0x682e6ff3d6b2b8a3, 0x748f82ee5defb2fc, 0x78a5636f43172f60, 0x84c87814a1f0ab72, 0x8cc702081a6439ec,
+                    0x90befffa23631e28, 0xa4506cebde82bde9, 0xbef9a3f7b2c67915, 0xc67178f2e372532b, 0xca273eceea26619c,
+                    0xd186b8c721c0c207, 0xeada7dd6cde0eb1e, 0xf57d4f7fee6ed178, 0x06f067aa72176fba, 0x0a637dc5a2c898a6,
+                    0x113f9804bef90dae, 0x1b710b35131c471b, 0x28db77f523047d84, 0x32caab7b40c72493, 0x3c9ebe0a15c9bebc,
+                    0x431d67c49c100d4c, 0x4cc5d4becb3e42b6, 0x597f299cfc657e2a, 0x5fcb6fab3ad6faec, 0x6c44198c4a475817,
+                };
+
+                WordType words[80];
+                for (size_t i = 0; i < 16; ++i)
+                    words[i] = read_big_endian<WordType>(block + i * 8);
+                for (size_t i = 16; i < 80; ++i)
+                {
+                    const WordType s0 =
+                        rotate_right(words[i - 15], 1) ^ rotate_right(words[i - 15], 8) ^ (words[i - 15] >> 7);
+                    const WordType s1 =
+                        rotate_right(words[i - 2], 19) ^ rotate_right(words[i - 2], 61) ^ (words[i - 2] >> 6);
+                    words[i] = words[i - 16] + s0 + words[i - 7] + s1;
+                }
+
+                auto local = state;
+                for (size_t i = 0; i < 80; ++i)
+                {
+                    auto& a = local[0];
+                    auto& b = local[1];
+                    auto& c = local[2];
+                    auto& d = local[3];
+                    auto& e = local[4];
+                    auto& f = local[5];
+                    auto& g = local[6];
+                    auto& h = local[7];
+
+                    const WordType s1 = rotate_right(e, 14) ^ rotate_right(e, 18) ^ rotate_right(e, 41);
+                    const WordType ch = (e & f) ^ (~e & g);
+                    const WordType tmp1 = h + s1 + ch + ROUND_CONSTANTS[i] + words[i];
+                    const WordType s0 = rotate_right(a, 28) ^ rotate_right(a, 34) ^ rotate_right(a, 39);
+                    const WordType maj = (a & b) ^ (a & c) ^ (b & c);
+                    const WordType tmp2 = s0 + maj;
+
+                    h = g;
+                    g = f;
+                    f = e;
+                    e = d + tmp1;
+                    d = c;
+                    c = b;
+                    b = a;
+                    a = tmp1 + tmp2;
+                }
+
+                for (size_t i = 0; i < 8; ++i)
+                    state[i] += local[i];
             }
 
-            static std::string finalize_hash_handle(const BCryptHashHandle& hash_handle, const ULONG length_in_bytes)
+            // There are no SHA-512 instructions on common CPUs yet.
+            void process_blocks(const unsigned char* blocks, size_t count) noexcept
             {
-                std::unique_ptr<unsigned char[]> hash_buffer = std::make_unique<UCHAR[]>(length_in_bytes);
-                const NTSTATUS error_code = BCryptFinishHash(hash_handle.handle, hash_buffer.get(), length_in_bytes, 0);
-                Checks::check_exit(VCPKG_LINE_INFO, NT_SUCCESS(error_code), "Failed to finalize the hash");
-                return to_hex(hash_buffer.get(), length_in_bytes);
+                for (size_t i = 0; i < count; ++i)
+                    process_block(blocks + i * BLOCK_SIZE);
             }
 
+            std::array<WordType, 8> state;
+        };
+
+        // SHA-384 is SHA-512 with a different initial state, truncated to six words.
+        struct Sha384Algorithm : Sha512Algorithm
+        {
+            static constexpr size_t DIGEST_WORDS = 6;
+
+            void clear() noexcept
+            {
+                state = {0xcbbb9d5dc1059ed8,
+                         0x629a292a367cd507,
+                         0x9159015a3070dd17,
+                         0x152fecd8f70e5939,
+                         0x67332667ffc00b31,
+                         0x8eb44a8768581511,
+                         0xdb0c2e0d64f98fa7,
+                         0x47b5481dbefa4fa4};
+            }
+        };
+
+        /// <summary>
+        /// Merkle-Damgard block buffering and padding shared by the SHA family.
+        /// </summary>
+        template<class ShaAlgorithm>
+        class ShaHasher final : public Hasher
+        {
+            using WordType = typename ShaAlgorithm::WordType;
+            static constexpr size_t BLOCK_SIZE = ShaAlgorithm::BLOCK_SIZE;
+            // The message length trailer is two words wide: 64 bits for SHA-1/SHA-256, 128 bits for SHA-512.
+            static constexpr size_t LENGTH_SIZE = 2 * sizeof(WordType);
+
         public:
-            explicit BCryptHasher(const std::string& hash_type)
-            {
-                NTSTATUS error_code =
-                    BCryptOpenAlgorithmProvider(&this->algorithm_handle.handle,
-                                                Strings::to_utf16(Strings::ascii_to_uppercase(hash_type)).c_str(),
-                                                nullptr,
-                                                0);
-                Checks::check_exit(VCPKG_LINE_INFO, NT_SUCCESS(error_code), "Failed to open the algorithm provider");
-
-                DWORD hash_buffer_bytes;
-                DWORD cb_data;
-                error_code = BCryptGetProperty(this->algorithm_handle.handle,
-                                               BCRYPT_HASH_LENGTH,
-                                               reinterpret_cast<PUCHAR>(&hash_buffer_bytes),
-                                               sizeof(DWORD),
-                                               &cb_data,
-                                               0);
-                Checks::check_exit(VCPKG_LINE_INFO, NT_SUCCESS(error_code), "Failed to get hash length");
-                this->length_in_bytes = hash_buffer_bytes;
-            }
-
-            std::string hash_file(const fs::path& path) const
-            {
-                BCryptHashHandle hash_handle;
-                initialize_hash_handle(hash_handle, this->algorithm_handle);
-
-                FILE* file = nullptr;
-                const auto ec = _wfopen_s(&file, path.c_str(), L"rb");
-                Checks::check_exit(VCPKG_LINE_INFO, ec == 0, "Failed to open file: %s", path.u8string());
-                if (file != nullptr)
+            ShaHasher() { clear(); }
+
+            virtual void add_bytes(const void* start, const void* end) noexcept override
+            {
+                auto first = static_cast<const unsigned char*>(start);
+                const auto last = static_cast<const unsigned char*>(end);
+                message_length += static_cast<uint64_t>(last - first);
+
+                if (buffered != 0)
                 {
-                    unsigned char buffer[4096];
-                    while (const auto actual_size = fread(buffer, 1, sizeof(buffer), file))
-                    {
-                        hash_data(hash_handle, buffer, actual_size);
-                    }
-                    fclose(file);
+                    const size_t to_copy = std::min(BLOCK_SIZE - buffered, static_cast<size_t>(last - first));
+                    std::copy(first, first + to_copy, buffer.begin() + buffered);
+                    buffered += to_copy;
+                    first += to_copy;
+                    if (buffered != BLOCK_SIZE) return;
+
+                    algorithm.process_blocks(buffer.data(), 1);
+                    buffered = 0;
                 }
 
-                return finalize_hash_handle(hash_handle, length_in_bytes);
+                const size_t blocks = static_cast<size_t>(last - first) / BLOCK_SIZE;
+                algorithm.process_blocks(first, blocks);
+                first += blocks * BLOCK_SIZE;
+
+                std::copy(first, last, buffer.begin());
+                buffered = static_cast<size_t>(last - first);
             }
 
-            std::string hash_string(const std::string& s) const
+            virtual std::string get_hash() noexcept override
             {
-                BCryptHashHandle hash_handle;
-                initialize_hash_handle(hash_handle, this->algorithm_handle);
-                hash_data(hash_handle, reinterpret_cast<const unsigned char*>(s.c_str()), s.size());
-                return finalize_hash_handle(hash_handle, length_in_bytes);
+                const uint64_t message_bits = message_length * 8;
+
+                buffer[buffered++] = 0x80;
+                if (buffered > BLOCK_SIZE - LENGTH_SIZE)
+                {
+                    std::fill(buffer.begin() + buffered, buffer.end(), static_cast<unsigned char>(0));
+                    algorithm.process_blocks(buffer.data(), 1);
+                    buffered = 0;
+                }
+                std::fill(buffer.begin() + buffered, buffer.end(), static_cast<unsigned char>(0));
+                write_big_endian(buffer.data() + BLOCK_SIZE - sizeof(uint64_t), message_bits);
+                algorithm.process_blocks(buffer.data(), 1);
+
+                unsigned char digest[ShaAlgorithm::DIGEST_WORDS * sizeof(WordType)];
+                for (size_t i = 0; i < ShaAlgorithm::DIGEST_WORDS; ++i)
+                {
+                    write_big_endian(digest + i * sizeof(WordType), algorithm.state[i]);
+                }
+
+                clear();
+                return to_hex(digest, sizeof(digest));
+            }
+
+            virtual void clear() noexcept override
+            {
+                algorithm.clear();
+                buffered = 0;
+                message_length = 0;
             }
 
         private:
-            BCryptAlgorithmHandle algorithm_handle;
-            ULONG length_in_bytes;
+            ShaAlgorithm algorithm;
+            std::array<unsigned char, BLOCK_SIZE> buffer;
+            size_t buffered;
+            uint64_t message_length;
         };
     }
 
-    std::string get_file_hash(const Files::Filesystem& fs, const fs::path& path, const std::string& hash_type)
+    std::unique_ptr<Hasher> get_hasher_for(Algorithm algo)
     {
-        Checks::check_exit(VCPKG_LINE_INFO, fs.exists(path), "File %s does not exist", path.u8string());
-        return BCryptHasher{hash_type}.hash_file(path);
+        switch (algo)
+        {
+            case Algorithm::SHA1: return std::make_unique<ShaHasher<Sha1Algorithm>>();
+            case Algorithm::SHA256: return std::make_unique<ShaHasher<Sha256Algorithm>>();
+            case Algorithm::SHA384: return std::make_unique<ShaHasher<Sha384Algorithm>>();
+            case Algorithm::SHA512: return std::make_unique<ShaHasher<Sha512Algorithm>>();
+            default: Checks::unreachable(VCPKG_LINE_INFO);
+        }
+    }
+
+    std::string get_bytes_hash(const void* first, const void* last, Algorithm algo)
+    {
+        auto hasher = get_hasher_for(algo);
+        hasher->add_bytes(first, last);
+        Stats::add(Stats::Counter::HASHES_COMPUTED);
+        Stats::add(Stats::Counter::BYTES_HASHED, static_cast<const char*>(last) - static_cast<const char*>(first));
+        return hasher->get_hash();
     }
 
     std::string get_string_hash(const std::string& s, const std::string& hash_type)
     {
-        verify_has_only_allowed_chars(s);
-        return BCryptHasher{hash_type}.hash_string(s);
+        return get_bytes_hash(s.data(), s.data() + s.size(), algorithm_from_string(hash_type));
     }
 
-#else
-    static std::string get_digest_size(const std::string& hash_type)
+    namespace
     {
-        if (!Strings::case_insensitive_ascii_starts_with(hash_type, "SHA"))
+        struct CachedDigest
+        {
+            Files::FileStamp stamp;
+            std::string digest;
+        };
+
+        // Lines are "<algorithm> <size> <mtime> <inode> <digest> <absolute path>"; the path goes last because it may
+        // contain spaces. The file is only appended to, later lines win, and it is rewritten once mostly superseded.
+        struct FileHashCache
+        {
+            Files::Filesystem* fs = nullptr;
+            fs::path cache_file;
+            bool loaded = false;
+            std::unordered_map<std::string, CachedDigest> entries;
+
+            static std::string key(const std::string& algorithm, const std::string& path)
+            {
+                return algorithm + ' ' + path;
+            }
+
+            void load()
+            {
+                loaded = true;
+                const auto maybe_contents = fs->read_contents(cache_file);
+                const auto contents = maybe_contents.get();
+                if (!contents) return;
+
+                size_t line_count = 0;
+                for (auto&& line : Strings::split(*contents, "\n"))
+                {
+                    ++line_count;
+
+                    // Concurrent appends can tear or interleave lines, so anything that does not parse is skipped.
+                    const auto fields = Strings::split(line, " ");
+                    if (fields.size() < 6) continue;
+
+                    char* end;
+                    CachedDigest entry;
+                    entry.stamp.size = std::strtoull(fields[1].c_str(), &end, 10);
+                    if (*end != '\0') continue;
+                    entry.stamp.mtime = std::strtoll(fields[2].c_str(), &end, 10);
+                    if (*end != '\0') continue;
+                    entry.stamp.inode = std::strtoull(fields[3].c_str(), &end, 10);
+                    if (*end != '\0') continue;
+                    entry.digest = fields[4];
+
+                    const auto path_begin = fields[0].size() + fields[1].size() + fields[2].size() +
+                                            fields[3].size() + fields[4].size() + 5;
+                    entries[key(fields[0], line.substr(path_begin))] = std::move(entry);
+                }
+
+                if (line_count > 2 * entries.size() + 64) compact();
+            }
+
+            void compact()
+            {
+                std::string contents;
+                for (auto&& entry : entries)
+                {
+                    const auto separator = entry.first.find(' ');
+                    contents += format_line(
+                        entry.first.substr(0, separator), entry.first.substr(separator + 1), entry.second);
+                }
+
+                // Other vcpkg processes sharing downloads/ may be compacting the same cache.
+                std::error_code ec;
+                const auto tmp = Files::unique_temporary_path(cache_file);
+                fs->write_contents(tmp, contents, ec);
+                if (!ec) fs->rename(tmp, cache_file, ec);
+                if (ec) fs->remove(tmp, ec);
+            }
+
+            static std::string format_line(const std::string& algorithm,
+                                           const std::string& path,
+                                           const CachedDigest& entry)
+            {
+                return Strings::format("%s %llu %lld %llu %s %s\n",
+                                       algorithm,
+                                       static_cast<unsigned long long>(entry.stamp.size),
+                                       static_cast<long long>(entry.stamp.mtime),
+                                       static_cast<unsigned long long>(entry.stamp.inode),
+                                       entry.digest,
+                                       path);
+            }
+
+            void store(const std::string& algorithm, const std::string& path, const CachedDigest& entry)
+            {
+                entries[key(algorithm, path)] = entry;
+
+                std::error_code ec;
+                fs->create_directories(cache_file.parent_path(), ec);
+                fs->append_contents(cache_file, format_line(algorithm, path, entry), ec);
+            }
+        };
+
+        Util::LockGuarded<FileHashCache> g_file_hash_cache;
+
+        const char* algorithm_name(Algorithm algo)
         {
-            Checks::exit_with_message(
-                VCPKG_LINE_INFO, "shasum only supports SHA hashes, but %s was provided", hash_type);
+            switch (algo)
+            {
+                case Algorithm::SHA1: return "SHA1";
+                case Algorithm::SHA256: return "SHA256";
+                case Algorithm::SHA384: return "SHA384";
+                case Algorithm::SHA512: return "SHA512";
+                default: Checks::unreachable(VCPKG_LINE_INFO);
+            }
         }
 
-        return hash_type.substr(3, hash_type.length() - 3);
+        // Returns nullopt for files too recently modified to be cached safely.
+        Optional<Files::FileStamp> get_file_stamp(const Files::Filesystem& fs, const fs::path& path)
+        {
+            std::error_code ec;
+            const auto stamp = fs.stamp(path, ec);
+            if (ec) return nullopt;
+
+            const auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                 fs::stdfs::file_time_type::clock::now().time_since_epoch())
+                                 .count();
+            if (now - stamp.mtime < std::chrono::nanoseconds(std::chrono::seconds(2)).count()) return nullopt;
+            return stamp;
+        }
     }
 
-    static std::string parse_shasum_output(const std::string& shasum_output)
+    void enable_file_hash_cache(Files::Filesystem& fs, const fs::path& cache_file)
     {
-        std::vector<std::string> split = Strings::split(shasum_output, " ");
-        Checks::check_exit(VCPKG_LINE_INFO,
-                           split.size() == 3,
-                           "Expected output of the form [hash filename\n] (3 tokens), but got\n"
-                           "[%s] (%s tokens)",
-                           shasum_output,
-                           std::to_string(split.size()));
-
-        return split[0];
+        auto cache = g_file_hash_cache.lock();
+        cache->fs = &fs;
+        cache->cache_file = cache_file;
+        cache->loaded = false;
+        cache->entries.clear();
     }
 
-    std::string get_file_hash(const Files::Filesystem& fs, const fs::path& path, const std::string& hash_type)
+    static std::string compute_file_hash(const Files::Filesystem& fs, const fs::path& path, Algorithm algo)
     {
-        const std::string digest_size = get_digest_size(hash_type);
+        const auto hasher = get_hasher_for(algo);
         Checks::check_exit(VCPKG_LINE_INFO, fs.exists(path), "File %s does not exist", path.u8string());
 
-        // Try hash-specific tools, like sha512sum
-        {
-            const auto ec_data = System::cmd_execute_and_capture_output(
-                Strings::format(R"(sha%ssum "%s")", digest_size, path.u8string()));
-            if (ec_data.exit_code == 0)
-            {
-                return parse_shasum_output(ec_data.output);
-            }
-        }
+        FILE* file = nullptr;
+#if defined(_WIN32)
+        const auto ec = _wfopen_s(&file, path.c_str(), L"rb");
+        Checks::check_exit(VCPKG_LINE_INFO, ec == 0, "Failed to open file: %s", path.u8string());
+#else
+        file = fopen(path.c_str(), "rb");
+#endif
+        Checks::check_exit(VCPKG_LINE_INFO, file != nullptr, "Failed to open file: %s", path.u8string());
 
-        // Try shasum
+        std::unique_ptr<unsigned char[]> buffer = std::make_unique<unsigned char[]>(1024 * 64);
+        std::uint64_t bytes = 0;
+        while (const auto actual_size = fread(buffer.get(), 1, 1024 * 64, file))
         {
-            const auto ec_data = System::cmd_execute_and_capture_output(
-                Strings::format(R"(shasum -a %s "%s")", digest_size, path.u8string()));
-            if (ec_data.exit_code == 0)
-            {
-                return parse_shasum_output(ec_data.output);
-            }
+            hasher->add_bytes(buffer.get(), buffer.get() + actual_size);
+            bytes += actual_size;
         }
+        const bool read_error = ferror(file) != 0;
+        fclose(file);
+        Checks::check_exit(VCPKG_LINE_INFO, !read_error, "Failed to read file: %s", path.u8string());
+
+        Stats::add(Stats::Counter::HASHES_COMPUTED);
+        Stats::add(Stats::Counter::BYTES_HASHED, bytes);
 
-        Checks::exit_with_message(VCPKG_LINE_INFO, "Could not hash file %s with %s", path.u8string(), hash_type);
+        return hasher->get_hash();
     }
 
-    std::string get_string_hash(const std::string& s, const std::string& hash_type)
+    std::string get_file_hash(const Files::Filesystem& fs, const fs::path& path, const std::string& hash_type)
     {
-        const std::string digest_size = get_digest_size(hash_type);
-        verify_has_only_allowed_chars(s);
-
-        // Try hash-specific tools, like sha512sum
+        const auto algo = algorithm_from_string(hash_type);
         {
-            const auto ec_data =
-                System::cmd_execute_and_capture_output(Strings::format(R"(echo -n "%s" | sha%ssum)", s, digest_size));
-            if (ec_data.exit_code == 0)
-            {
-                return parse_shasum_output(ec_data.output);
-            }
+            auto cache = g_file_hash_cache.lock();
+            if (!cache->fs) return compute_file_hash(fs, path, algo);
         }
 
-        // Try shasum
+        const auto maybe_stamp = get_file_stamp(fs, path);
+        const auto stamp = maybe_stamp.get();
+        if (!stamp) return compute_file_hash(fs, path, algo);
+
+        const auto absolute_path = fs::stdfs::absolute(path).u8string();
         {
-            const auto ec_data = System::cmd_execute_and_capture_output(
-                Strings::format(R"(echo -n "%s" | shasum -a %s)", s, digest_size));
-            if (ec_data.exit_code == 0)
-            {
-                return parse_shasum_output(ec_data.output);
-            }
+            auto cache = g_file_hash_cache.lock();
+            if (!cache->loaded) cache->load();
+
+            const auto it = cache->entries.find(FileHashCache::key(algorithm_name(algo), absolute_path));
+            if (it != cache->entries.end() && it->second.stamp == *stamp) return it->second.digest;
         }
 
-        Checks::exit_with_message(VCPKG_LINE_INFO, "Could not hash input string with %s", hash_type);
+        // Hash outside the lock so large files do not serialize other threads.
+        CachedDigest entry{*stamp, compute_file_hash(fs, path, algo)};
+        g_file_hash_cache.lock()->store(algorithm_name(algo), absolute_path, entry);
+        return std::move(entry.digest);
     }
-#endif
 }
@@ -0,0 +1,116 @@
+#include "pch.h"
+
+#include <vcpkg/base/stats.h>
+#include <vcpkg/base/system.h>
+#include <vcpkg/base/util.h>
+
+#if defined(_WIN32)
+#include <Psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace vcpkg::Stats
+{
+    static constexpr size_t COUNTER_COUNT = static_cast<size_t>(Counter::COUNT);
+
+    static std::atomic<std::uint64_t> g_counters[COUNTER_COUNT];
+    static std::atomic<bool> g_enabled{false};
+
+    static Util::LockGuarded<std::map<std::string, std::uint64_t>>& get_processes()
+    {
+        // Detached workers may still start processes during static destruction, so the map is never destroyed.
+        static auto* processes = new Util::LockGuarded<std::map<std::string, std::uint64_t>>();
+        return *processes;
+    }
+
+    void add(const Counter counter, const std::uint64_t amount)
+    {
+        g_counters[static_cast<size_t>(counter)].fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    void add_process(const std::string& program)
+    {
+        const auto separator = program.find_last_of("/\\");
+        auto name = separator == std::string::npos ? program : program.substr(separator + 1);
+        ++(*get_processes().lock())[std::move(name)];
+    }
+
+    void add_command_line(const std::string& command_line)
+    {
+        const auto begin = command_line.find_first_not_of(' ');
+        if (begin == std::string::npos) return add_process(command_line);
+
+        if (command_line[begin] == '"')
+        {
+            const auto end = command_line.find('"', begin + 1);
+            return add_process(command_line.substr(begin + 1, end == std::string::npos ? end : end - begin - 1));
+        }
+
+        const auto end = command_line.find(' ', begin);
+        return add_process(command_line.substr(begin, end == std::string::npos ? end : end - begin));
+    }
+
+    void set_enabled(const bool enabled) { g_enabled = enabled; }
+
+    bool is_enabled() { return g_enabled; }
+
+    // As unsigned long long for %llu, which std::uint64_t is not on LP64 platforms.
+    static unsigned long long get(const Counter counter)
+    {
+        return g_counters[static_cast<size_t>(counter)].load(std::memory_order_relaxed);
+    }
+
+    static std::string format_mib(const std::uint64_t bytes)
+    {
+        return Strings::format("%.1f MiB", bytes / (1024.0 * 1024.0));
+    }
+
+    static std::uint64_t get_peak_rss_bytes()
+    {
+#if defined(_WIN32)
+        PROCESS_MEMORY_COUNTERS counters;
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+        return counters.PeakWorkingSetSize;
+#else
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#if defined(__APPLE__)
+        return static_cast<std::uint64_t>(usage.ru_maxrss);
+#else
+        return static_cast<std::uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+    }
+
+    void print()
+    {
+        if (!g_enabled) return;
+
+        const auto processes = *get_processes().lock();
+        std::uint64_t process_count = 0;
+        for (auto&& process : processes)
+            process_count += process.second;
+
+        System::println("\nStatistics:");
+        System::println("    Processes started:     %llu", static_cast<unsigned long long>(process_count));
+        for (auto&& process : processes)
+        {
+            System::println("        %-18s %llu", process.first, static_cast<unsigned long long>(process.second));
+        }
+        System::println("    Files read:            %llu (%s)",
+                        get(Counter::FILES_READ),
+                        format_mib(get(Counter::BYTES_READ)));
+        System::println("    Files written:         %llu (%s)",
+                        get(Counter::FILES_WRITTEN),
+                        format_mib(get(Counter::BYTES_WRITTEN)));
+        System::println("    Files copied:          %llu", get(Counter::FILES_COPIED));
+        System::println("    Directories listed:    %llu", get(Counter::DIRECTORIES_LISTED));
+        System::println("    Paragraph parses:      %llu", get(Counter::PARAGRAPH_PARSES));
+        System::println("    Hashes computed:       %llu (%s)",
+                        get(Counter::HASHES_COMPUTED),
+                        format_mib(get(Counter::BYTES_HASHED)));
+        System::println("    Source fetches failed: %llu", get(Counter::SOURCE_PREFETCH_FAILURES));
+        System::println("    Peak resident memory:  %s", format_mib(get_peak_rss_bytes()));
+    }
+}
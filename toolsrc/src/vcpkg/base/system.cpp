@@ -1,12 +1,24 @@
 #include "pch.h"
 
 #include <vcpkg/base/checks.h>
+#include <vcpkg/base/stats.h>
 #include <vcpkg/base/system.h>
+#include <vcpkg/base/util.h>
 #include <vcpkg/globalstate.h>
 #include <vcpkg/metrics.h>
 
 #include <ctime>
 
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+extern char** environ;
+#endif
+
 #if defined(__APPLE__)
 #include <mach-o/dyld.h>
 #endif
@@ -95,7 +107,7 @@ namespace vcpkg::System
     }
 
     CMakeVariable::CMakeVariable(const CStringView varname, const char* varvalue)
-        : s(Strings::format(R"("-D%s=%s")", varname, varvalue))
+        : s(Strings::format(R"("-D%s=%s")", varname, varvalue)), argument(Strings::format("-D%s=%s", varname, varvalue))
     {
     }
     CMakeVariable::CMakeVariable(const CStringView varname, const std::string& varvalue)
@@ -116,6 +128,18 @@ namespace vcpkg::System
             R"("%s" %s -P "%s")", cmake_exe.u8string(), cmd_cmake_pass_variables, cmake_script.generic_u8string());
     }
 
+    std::vector<std::string> make_cmake_argv(const fs::path& cmake_exe,
+                                             const fs::path& cmake_script,
+                                             const std::vector<CMakeVariable>& pass_variables)
+    {
+        std::vector<std::string> argv{cmake_exe.u8string()};
+        for (auto&& variable : pass_variables)
+            argv.push_back(variable.argument);
+        argv.push_back("-P");
+        argv.push_back(cmake_script.generic_u8string());
+        return argv;
+    }
+
 #if defined(_WIN32)
     static std::wstring compute_clean_environment(const std::unordered_map<std::string, std::string>& extra_env)
     {
@@ -224,6 +248,7 @@ namespace vcpkg::System
         // Wrapping the command in a single set of quotes causes cmd.exe to correctly execute
         const std::string actual_cmd_line = Strings::format(R"###(cmd.exe /c "%s")###", cmd_line);
         Debug::println("CreateProcessW(%s)", actual_cmd_line);
+        Stats::add_command_line(cmd_line.c_str());
         bool succeeded = TRUE == CreateProcessW(nullptr,
                                                 Strings::to_utf16(actual_cmd_line).data(),
                                                 nullptr,
@@ -284,10 +309,10 @@ namespace vcpkg::System
 
         return static_cast<int>(exit_code);
 #else
-        Debug::println("system(%s)", cmd_line.c_str());
-        fflush(nullptr);
-        int rc = system(cmd_line.c_str());
-        Debug::println("system() returned %d after %d us", rc, static_cast<int>(timer.microseconds()));
+        // Like system() before it, this ignores extra_env, whose only user (`vcpkg env`) builds Windows paths.
+        Util::unused(extra_env);
+        const int rc = spawn({"/bin/sh", "-c", cmd_line.c_str()}).wait().exit_code;
+        Debug::println("/bin/sh returned %d after %d us", rc, static_cast<int>(timer.microseconds()));
         return rc;
 #endif
     }
@@ -301,14 +326,14 @@ namespace vcpkg::System
         // We are wrap the command line in quotes to cause cmd.exe to correctly process it
         const std::string& actual_cmd_line = Strings::format(R"###("%s")###", cmd_line);
         Debug::println("_wsystem(%s)", actual_cmd_line);
+        Stats::add_command_line(cmd_line.c_str());
         GlobalState::g_ctrl_c_state.transition_to_spawn_process();
         const int exit_code = _wsystem(Strings::to_utf16(actual_cmd_line).c_str());
         GlobalState::g_ctrl_c_state.transition_from_spawn_process();
         Debug::println("_wsystem() returned %d", exit_code);
 #else
-        Debug::println("_system(%s)", cmd_line);
-        const int exit_code = system(cmd_line.c_str());
-        Debug::println("_system() returned %d", exit_code);
+        const int exit_code = spawn({"/bin/sh", "-c", cmd_line.c_str()}).wait().exit_code;
+        Debug::println("/bin/sh returned %d", exit_code);
 #endif
         return exit_code;
     }
@@ -321,6 +346,7 @@ namespace vcpkg::System
         const auto actual_cmd_line = Strings::format(R"###("%s 2>&1")###", cmd_line);
 
         Debug::println("_wpopen(%s)", actual_cmd_line);
+        Stats::add_command_line(cmd_line.c_str());
         std::wstring output;
         wchar_t buf[1024];
         GlobalState::g_ctrl_c_state.transition_to_spawn_process();
@@ -357,38 +383,273 @@ namespace vcpkg::System
 
         return {ec, Strings::to_utf8(output.c_str())};
 #else
-        const auto actual_cmd_line = Strings::format(R"###(%s 2>&1)###", cmd_line);
+        ProcessOptions options;
+        options.output = ProcessOutput::CAPTURE;
+        options.redirect_errors = true;
+        auto result = spawn({"/bin/sh", "-c", cmd_line.c_str()}, options).wait();
 
-        Debug::println("popen(%s)", actual_cmd_line);
-        std::string output;
-        char buf[1024];
-        // Flush stdout before launching external process
-        fflush(stdout);
-        const auto pipe = popen(actual_cmd_line.c_str(), "r");
-        if (pipe == nullptr)
+        Debug::println("/bin/sh returned %d after %8d us", result.exit_code, static_cast<int>(timer.microseconds()));
+
+        return result;
+#endif
+    }
+
+#if !defined(_WIN32)
+    static constexpr size_t PIPE_BUFFER_SIZE = 64 * 1024;
+
+    Process::Process(Process&& other) noexcept
+        : m_pid(other.m_pid)
+        , m_output_fd(other.m_output_fd)
+        , m_exited(other.m_exited)
+        , m_result(std::move(other.m_result))
+        , m_resource_usage(other.m_resource_usage)
+        , m_on_output(std::move(other.m_on_output))
+    {
+        other.m_pid = -1;
+        other.m_output_fd = -1;
+        other.m_exited = true;
+    }
+
+    Process::~Process()
+    {
+        if (!m_exited || m_output_fd != -1) wait();
+    }
+
+    ExitCodeAndOutput Process::wait()
+    {
+        read_output(true);
+        reap(true);
+        return m_result;
+    }
+
+    bool Process::try_wait()
+    {
+        // The output is drained first, since a child blocked on a full pipe would never exit.
+        return read_output(false) && reap(false);
+    }
+
+    // Returns true once the write end of the pipe is closed, which happens when the child and everything it started
+    // have exited.
+    bool Process::read_output(bool block)
+    {
+        if (m_output_fd == -1) return true;
+
+        char buffer[PIPE_BUFFER_SIZE];
+        while (true)
         {
-            return {1, output};
+            if (!block)
+            {
+                pollfd poll_fd{m_output_fd, POLLIN, 0};
+                if (poll(&poll_fd, 1, 0) <= 0) return false;
+            }
+
+            const auto size = read(m_output_fd, buffer, sizeof(buffer));
+            if (size < 0 && errno == EINTR) continue;
+            if (size <= 0)
+            {
+                close(m_output_fd);
+                m_output_fd = -1;
+                return true;
+            }
+
+            if (m_on_output)
+                m_on_output(buffer, static_cast<size_t>(size));
+            else
+                m_result.output.append(buffer, static_cast<size_t>(size));
         }
-        while (fgets(buf, 1024, pipe))
+    }
+
+    bool Process::reap(bool block)
+    {
+        if (m_exited) return true;
+
+        int status = 0;
+        rusage usage{};
+        pid_t rc;
+        do
         {
-            output.append(buf);
+            rc = wait4(m_pid, &status, block ? 0 : WNOHANG, &usage);
+        } while (rc == -1 && errno == EINTR);
+        if (rc == 0) return false;
+
+        const auto to_microseconds = [](const timeval& tv) {
+            return static_cast<std::uint64_t>(tv.tv_sec) * 1000000 + static_cast<std::uint64_t>(tv.tv_usec);
+        };
+        m_resource_usage.user_microseconds = to_microseconds(usage.ru_utime);
+        m_resource_usage.system_microseconds = to_microseconds(usage.ru_stime);
+#if defined(__APPLE__)
+        m_resource_usage.peak_rss_bytes = static_cast<std::uint64_t>(usage.ru_maxrss);
+#else
+        m_resource_usage.peak_rss_bytes = static_cast<std::uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+        // Counted in 512 byte blocks.
+        m_resource_usage.read_bytes = static_cast<std::uint64_t>(usage.ru_inblock) * 512;
+        m_resource_usage.written_bytes = static_cast<std::uint64_t>(usage.ru_oublock) * 512;
+
+        if (rc == -1)
+            m_result.exit_code = 1;
+        else if (WIFEXITED(status))
+            m_result.exit_code = WEXITSTATUS(status);
+        else
+            m_result.exit_code = 128 + WTERMSIG(status);
+        m_exited = true;
+        return true;
+    }
+
+    // Without extra variables the child shares this process's environment as is.
+    static std::vector<std::string> make_environment(const std::unordered_map<std::string, std::string>& extra_env)
+    {
+        std::vector<std::string> env;
+        for (char** entry = environ; *entry != nullptr; ++entry)
+        {
+            const char* const equals = strchr(*entry, '=');
+            const std::string name = equals ? std::string(static_cast<const char*>(*entry), equals) : *entry;
+            if (extra_env.find(name) == extra_env.end()) env.emplace_back(*entry);
         }
-        if (!feof(pipe))
+
+        for (auto&& variable : extra_env)
+            env.push_back(variable.first + "=" + variable.second);
+        return env;
+    }
+
+    static std::vector<char*> to_c_strings(const std::vector<std::string>& strings)
+    {
+        auto ret = Util::fmap(strings, [](const std::string& s) { return const_cast<char*>(s.c_str()); });
+        ret.push_back(nullptr);
+        return ret;
+    }
+
+    // Builds share the process with the threads of other builds, so the pipe must not leak into the children they
+    // start; a leaked write end would keep the read here from ever seeing the end of the output.
+    static bool make_close_on_exec_pipe(int (&fds)[2])
+    {
+#if defined(__APPLE__)
+        if (pipe(fds) != 0) return false;
+        fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+        fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+        return true;
+#else
+        return pipe2(fds, O_CLOEXEC) == 0;
+#endif
+    }
+
+    Process spawn(const std::vector<std::string>& argv, const ProcessOptions& options)
+    {
+        Checks::check_exit(VCPKG_LINE_INFO, !argv.empty());
+        Debug::println("posix_spawn(%s)", Strings::join(" ", argv));
+
+        // Commands run through the shell count as the program they start rather than as sh.
+        if (argv.size() == 3 && argv[0] == "/bin/sh" && argv[1] == "-c")
+            Stats::add_command_line(argv[2]);
+        else
+            Stats::add_process(argv[0]);
+
+        Process process;
+        process.m_on_output = options.on_output;
+
+        const auto c_argv = to_c_strings(argv);
+        const auto env = options.extra_env.empty() ? std::vector<std::string>() : make_environment(options.extra_env);
+        const auto c_env = to_c_strings(env);
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+
+        int pipe_fds[2] = {-1, -1};
+        switch (options.output)
         {
-            return {1, output};
+            case ProcessOutput::CAPTURE:
+                Checks::check_exit(VCPKG_LINE_INFO, make_close_on_exec_pipe(pipe_fds), "Failed to create a pipe");
+                posix_spawn_file_actions_adddup2(&actions, pipe_fds[1], STDOUT_FILENO);
+                break;
+            case ProcessOutput::DISCARD:
+                posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+                break;
+            case ProcessOutput::INHERIT: break;
+            default: Checks::unreachable(VCPKG_LINE_INFO);
         }
+        if (options.redirect_errors) posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
 
-        const auto ec = pclose(pipe);
+        // Flush stdout before launching external process
+        fflush(nullptr);
 
-        Debug::println("_pclose() returned %d after %8d us", ec, (int)timer.microseconds());
+        char* const* const envp = options.extra_env.empty() ? environ : c_env.data();
+        pid_t pid = -1;
+        const int rc = posix_spawnp(&pid, argv[0].c_str(), &actions, nullptr, c_argv.data(), envp);
+        posix_spawn_file_actions_destroy(&actions);
+        if (pipe_fds[1] != -1) close(pipe_fds[1]);
 
-        return {ec, output};
+        if (rc != 0)
+        {
+            if (pipe_fds[0] != -1) close(pipe_fds[0]);
+            process.m_exited = true;
+            process.m_result = {
+                127, Strings::format("Failed to run %s: %s\n", argv[0], std::system_category().message(rc))};
+            return process;
+        }
+
+        process.m_pid = pid;
+        process.m_output_fd = pipe_fds[0];
+        return process;
+    }
 #endif
+
+#if defined(_WIN32)
+    // Quotes `arg` so that CommandLineToArgvW, and the CRT, parse it back unchanged: backslashes are only special
+    // before a quote, so they are doubled there and before the closing quote, and embedded quotes are escaped.
+    static std::string quote_argument(const std::string& arg)
+    {
+        std::string quoted = "\"";
+        size_t backslashes = 0;
+        for (auto&& ch : arg)
+        {
+            if (ch == '\\')
+            {
+                ++backslashes;
+                continue;
+            }
+
+            if (ch == '"')
+                quoted.append(backslashes * 2 + 1, '\\');
+            else
+                quoted.append(backslashes, '\\');
+            backslashes = 0;
+            quoted.push_back(ch);
+        }
+        quoted.append(backslashes * 2, '\\');
+        quoted.push_back('"');
+        return quoted;
     }
+#endif
 
-    void println() { putchar('\n'); }
+    ExitCodeAndOutput spawn_and_capture_output(const std::vector<std::string>& argv)
+    {
+#if defined(_WIN32)
+        return cmd_execute_and_capture_output(Strings::join(" ", argv, quote_argument));
+#else
+        ProcessOptions options;
+        options.output = ProcessOutput::CAPTURE;
+        options.redirect_errors = true;
+        return spawn(argv, options).wait();
+#endif
+    }
+
+    static thread_local OutputBuffer* t_output_buffer = nullptr;
+
+    OutputBuffer::OutputBuffer() : previous(t_output_buffer) { t_output_buffer = this; }
 
-    void print(const CStringView message) { fputs(message.c_str(), stdout); }
+    OutputBuffer::~OutputBuffer() { t_output_buffer = previous; }
+
+    OutputBuffer* OutputBuffer::current() { return t_output_buffer; }
+
+    void println() { print("\n"); }
+
+    void print(const CStringView message)
+    {
+        if (t_output_buffer)
+            t_output_buffer->append(message.c_str(), strlen(message.c_str()));
+        else
+            fputs(message.c_str(), stdout);
+    }
 
     void println(const CStringView message)
     {
@@ -398,6 +659,7 @@ namespace vcpkg::System
 
     void print(const Color c, const CStringView message)
     {
+        if (t_output_buffer) return print(message);
 #if defined(_WIN32)
         const HANDLE console_handle = GetStdHandle(STD_OUTPUT_HANDLE);
 
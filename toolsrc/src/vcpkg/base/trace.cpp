@@ -0,0 +1,139 @@
+#include "pch.h"
+
+#include <vcpkg/base/system.h>
+#include <vcpkg/base/trace.h>
+#include <vcpkg/base/util.h>
+
+namespace vcpkg::Trace
+{
+    namespace
+    {
+        struct Event
+        {
+            std::string name;
+            const char* category;
+            size_t thread;
+            long long start_us;
+            long long duration_us;
+        };
+
+        struct TraceState
+        {
+            fs::path path;
+            std::chrono::steady_clock::time_point origin;
+            std::vector<Event> events;
+            size_t threads = 0;
+        };
+
+        std::atomic<bool> g_enabled{false};
+
+        // Numbered in the order threads first record a span; the thread that starts tracing is 1.
+        thread_local size_t t_thread = 0;
+
+        Util::LockGuarded<TraceState>& get_state()
+        {
+            // Detached workers may still be recording during static destruction, so the state is never destroyed.
+            static auto* state = new Util::LockGuarded<TraceState>();
+            return *state;
+        }
+
+        std::string to_json_string(const std::string& str)
+        {
+            std::string encoded = "\"";
+            for (auto&& ch : str)
+            {
+                if (ch == '\\' || ch == '"')
+                {
+                    encoded.push_back('\\');
+                    encoded.push_back(ch);
+                }
+                else if (static_cast<unsigned char>(ch) < 0x20)
+                {
+                    encoded.append(Strings::format("\\u%04x", static_cast<int>(ch)));
+                }
+                else
+                {
+                    encoded.push_back(ch);
+                }
+            }
+            encoded.push_back('"');
+            return encoded;
+        }
+    }
+
+    void start(const fs::path& path)
+    {
+        {
+            auto state = get_state().lock();
+            state->path = path;
+            state->origin = std::chrono::steady_clock::now();
+            if (t_thread == 0) t_thread = ++state->threads;
+        }
+        g_enabled = true;
+    }
+
+    bool is_enabled() { return g_enabled; }
+
+    void flush()
+    {
+        if (!g_enabled.exchange(false)) return;
+
+        auto state = get_state().lock();
+
+        std::string doc = "{\"traceEvents\":[\n";
+        for (size_t thread = 1; thread <= state->threads; ++thread)
+        {
+            doc += Strings::format(R"({"name":"thread_name","ph":"M","pid":1,"tid":%zu,"args":{"name":"%s"}},)"
+                                   "\n",
+                                   thread,
+                                   thread == 1 ? std::string("main") : Strings::format("thread %zu", thread));
+        }
+        for (auto&& event : state->events)
+        {
+            doc += Strings::format(R"({"name":%s,"cat":"%s","ph":"X","pid":1,"tid":%zu,"ts":%lld,"dur":%lld},)"
+                                   "\n",
+                                   to_json_string(event.name),
+                                   event.category,
+                                   event.thread,
+                                   event.start_us,
+                                   event.duration_us);
+        }
+        // The metadata events above guarantee a trailing comma to remove.
+        doc.resize(doc.size() - 2);
+        doc += "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+        std::error_code ec;
+        Files::get_real_filesystem().write_contents(state->path, doc, ec);
+        if (ec)
+        {
+            System::println(
+                System::Color::warning, "Failed to write trace file %s: %s", state->path.u8string(), ec.message());
+        }
+    }
+
+    Span::Span(const CStringView category, const std::string& detail) : m_category(nullptr)
+    {
+        if (!g_enabled) return;
+
+        m_category = category.c_str();
+        m_name = detail.empty() ? std::string(m_category) : Strings::format("%s %s", m_category, detail);
+        m_start = std::chrono::steady_clock::now();
+    }
+
+    Span::~Span()
+    {
+        if (!m_category || !g_enabled) return;
+
+        const auto end = std::chrono::steady_clock::now();
+        auto state = get_state().lock();
+        if (t_thread == 0) t_thread = ++state->threads;
+
+        using std::chrono::duration_cast;
+        using std::chrono::microseconds;
+        state->events.push_back({std::move(m_name),
+                                 m_category,
+                                 t_thread,
+                                 duration_cast<microseconds>(m_start - state->origin).count(),
+                                 duration_cast<microseconds>(end - m_start).count()});
+    }
+}
@@ -0,0 +1,926 @@
+#include "pch.h"
+
+#include <vcpkg/archives.h>
+#include <vcpkg/base/checks.h>
+#include <vcpkg/base/strings.h>
+#include <vcpkg/base/system.h>
+#include <vcpkg/base/trace.h>
+#include <vcpkg/base/util.h>
+#include <vcpkg/binarycaching.h>
+
+namespace vcpkg::BinaryCaching
+{
+    static constexpr StringLiteral INDEX_MAGIC = "vcpkg-binary-index-1";
+    static constexpr std::int64_t INDEX_MAX_AGE_SECONDS = 24 * 60 * 60;
+
+    static std::int64_t seconds_since_epoch()
+    {
+        return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    }
+
+    static const char* to_index_status(CacheStatus status)
+    {
+        switch (status)
+        {
+            case CacheStatus::AVAILABLE: return "pass";
+            case CacheStatus::FAILED: return "fail";
+            case CacheStatus::MISSING: return "missing";
+            default: Checks::unreachable(VCPKG_LINE_INFO);
+        }
+    }
+
+    static Optional<CacheStatus> from_index_status(const std::string& text)
+    {
+        if (text == "pass") return CacheStatus::AVAILABLE;
+        if (text == "fail") return CacheStatus::FAILED;
+        if (text == "missing") return CacheStatus::MISSING;
+        return nullopt;
+    }
+
+    static bool parse_integer(const std::string& text, long long& out)
+    {
+        if (text.empty()) return false;
+        char* end;
+        out = std::strtoll(text.c_str(), &end, 10);
+        return *end == '\0';
+    }
+
+    Optional<BinaryIndex> BinaryIndex::parse(const std::string& text)
+    {
+        const auto lines = Strings::split(text, "\n");
+        if (lines.empty()) return nullopt;
+
+        BinaryIndex ret;
+        long long scan_time;
+        const auto header = Strings::split(lines[0], " ");
+        if (header.size() != 2 || header[0] != INDEX_MAGIC.c_str() || !parse_integer(header[1], scan_time))
+            return nullopt;
+        ret.scan_time = scan_time;
+
+        for (size_t i = 1; i < lines.size(); ++i)
+        {
+            // A concurrent append may have been torn or interleaved, so skip anything that does not parse.
+            const auto fields = Strings::split(lines[i], " ");
+            long long size;
+            long long time;
+            if (fields.size() != 4 || !parse_integer(fields[2], size) || size < 0 || !parse_integer(fields[3], time))
+                continue;
+
+            const auto maybe_status = from_index_status(fields[1]);
+            if (const auto status = maybe_status.get())
+            {
+                ret.entries[fields[0]] = Entry{*status, static_cast<std::uint64_t>(size), time};
+            }
+        }
+        return ret;
+    }
+
+    std::string BinaryIndex::format_header(std::int64_t scan_time)
+    {
+        return Strings::format("%s %lld\n", INDEX_MAGIC, static_cast<long long>(scan_time));
+    }
+
+    std::string BinaryIndex::format_entry(const std::string& abi, const Entry& entry)
+    {
+        return Strings::format("%s %s %llu %lld\n",
+                               abi,
+                               to_index_status(entry.status),
+                               static_cast<unsigned long long>(entry.size),
+                               static_cast<long long>(entry.time));
+    }
+
+    struct DirectoryProvider final : BinaryProvider
+    {
+        DirectoryProvider(Files::Filesystem& fs, const fs::path& dir, Access access)
+            : BinaryProvider(access), fs(fs), dir(dir)
+        {
+        }
+
+        fs::path archive_subpath(const std::string& abi) const
+        {
+            return fs::u8path(abi.substr(0, 2)) / fs::u8path(abi + ".zip");
+        }
+        fs::path archive_path(const std::string& abi) const { return dir / archive_subpath(abi); }
+        fs::path tombstone_path(const std::string& abi) const { return dir / "fail" / archive_subpath(abi); }
+        fs::path index_path() const { return dir / "index.txt"; }
+
+        std::string location(const std::string& abi) const override { return archive_path(abi).u8string(); }
+
+        CacheStatus lookup(const std::string& abi) const override
+        {
+            {
+                auto state = index_state.lock();
+                if (const auto index = load_index(*state))
+                {
+                    const auto it = index->entries.find(abi);
+                    if (it != index->entries.end() && it->second.status == CacheStatus::AVAILABLE)
+                        return CacheStatus::AVAILABLE;
+                    if (probe_archive(*index, abi)) return CacheStatus::AVAILABLE;
+                    return it == index->entries.end() ? CacheStatus::MISSING : it->second.status;
+                }
+            }
+            return probe(abi);
+        }
+
+        Optional<fs::path> fetch(const std::string& abi, const fs::path&) const override
+        {
+            auto path = archive_path(abi);
+            {
+                auto state = index_state.lock();
+                if (const auto index = load_index(*state))
+                {
+                    const auto it = index->entries.find(abi);
+                    if (it == index->entries.end() || it->second.status != CacheStatus::AVAILABLE)
+                    {
+                        if (probe_archive(*index, abi)) return path;
+                        return nullopt;
+                    }
+                    if (fs.exists(path)) return path;
+
+                    // The index is out of date; record what is actually there.
+                    record(*index, abi, probe(abi));
+                    return nullopt;
+                }
+            }
+
+            if (!fs.exists(path)) return nullopt;
+            return path;
+        }
+
+        bool store(const std::string& abi, const fs::path& source) const override
+        {
+            const auto destination = archive_path(abi);
+            const auto tmp = Files::unique_temporary_path(destination);
+
+            std::error_code ec;
+            fs.create_directories(destination.parent_path(), ec);
+            fs.copy_file(source, tmp, fs::copy_options::overwrite_existing, ec);
+            if (!ec) fs.rename(tmp, destination, ec);
+            if (ec)
+            {
+                std::error_code ignored;
+                fs.remove(tmp, ignored);
+                System::println(System::Color::warning,
+                                "Failed to store binary cache %s: %s",
+                                destination.u8string(),
+                                ec.message());
+                return false;
+            }
+
+            auto state = index_state.lock();
+            if (const auto index = load_index(*state)) record(*index, abi, CacheStatus::AVAILABLE);
+            return true;
+        }
+
+        void store_failure(const std::string& abi) const override
+        {
+            const auto tombstone = tombstone_path(abi);
+            std::error_code ec;
+            fs.create_directories(tombstone.parent_path(), ec);
+            fs.write_contents(tombstone, "", ec);
+
+            // An archive takes precedence over a tombstone, as in probe().
+            auto state = index_state.lock();
+            if (const auto index = load_index(*state))
+            {
+                const auto it = index->entries.find(abi);
+                if (it == index->entries.end() || it->second.status != CacheStatus::AVAILABLE)
+                    record(*index, abi, CacheStatus::FAILED);
+            }
+        }
+
+        void clear_failure(const std::string& abi) const override
+        {
+            std::error_code ec;
+            fs.remove(tombstone_path(abi), ec);
+
+            auto state = index_state.lock();
+            if (const auto index = load_index(*state))
+            {
+                const auto it = index->entries.find(abi);
+                if (it != index->entries.end() && it->second.status == CacheStatus::FAILED)
+                    record(*index, abi, CacheStatus::MISSING);
+            }
+        }
+
+    private:
+        struct IndexState
+        {
+            bool loaded = false;
+            Optional<BinaryIndex> index;
+        };
+
+        CacheStatus probe(const std::string& abi) const
+        {
+            if (fs.exists(archive_path(abi))) return CacheStatus::AVAILABLE;
+            if (fs.exists(tombstone_path(abi))) return CacheStatus::FAILED;
+            return CacheStatus::MISSING;
+        }
+
+        // Another writer may have stored the archive after the index was loaded, or appended its line to a copy of the
+        // index that a rebuild replaced, so anything the index does not list as available costs one stat.
+        bool probe_archive(BinaryIndex& index, const std::string& abi) const
+        {
+            if (!fs.exists(archive_path(abi))) return false;
+            record(index, abi, CacheStatus::AVAILABLE);
+            return true;
+        }
+
+        // Returns the index, loading it on first use, or nullptr if lookups must probe the file system instead.
+        BinaryIndex* load_index(IndexState& state) const
+        {
+            if (!state.loaded)
+            {
+                state.loaded = true;
+
+                auto maybe_contents = fs.read_contents(index_path());
+                if (const auto contents = maybe_contents.get())
+                {
+                    state.index = BinaryIndex::parse(*contents);
+                }
+
+                const auto index = state.index.get();
+                if (!index || seconds_since_epoch() - index->scan_time > INDEX_MAX_AGE_SECONDS)
+                {
+                    if (can_write())
+                        state.index = rebuild_index();
+                    else
+                        state.index = nullopt;
+                }
+            }
+            return state.index.get();
+        }
+
+        BinaryIndex rebuild_index() const
+        {
+            BinaryIndex index;
+            index.scan_time = seconds_since_epoch();
+
+            const fs::path fail_dir = dir / "fail";
+            std::error_code ec;
+            for (fs::stdfs::recursive_directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+            {
+                const auto& path = it->path();
+                if (path.extension() != ".zip" || !fs::stdfs::is_regular_file(it->status())) continue;
+
+                const auto parent = path.parent_path().parent_path();
+                CacheStatus status;
+                if (parent == dir)
+                    status = CacheStatus::AVAILABLE;
+                else if (parent == fail_dir)
+                    status = CacheStatus::FAILED;
+                else
+                    continue;
+
+                const auto abi = path.stem().u8string();
+                auto& entry = index.entries[abi];
+                if (entry.status == CacheStatus::AVAILABLE && status == CacheStatus::FAILED) continue;
+
+                std::error_code stat_ec;
+                const auto size = fs::stdfs::file_size(path, stat_ec);
+                const auto time = fs::stdfs::last_write_time(path, stat_ec);
+                entry.status = status;
+                entry.size = stat_ec ? 0 : size;
+                entry.time = std::chrono::duration_cast<std::chrono::seconds>(time.time_since_epoch()).count();
+            }
+
+            // Keep what other writers appended to the old index while the directory was being scanned.
+            auto maybe_contents = fs.read_contents(index_path());
+            if (const auto old_contents = maybe_contents.get())
+            {
+                auto maybe_old_index = BinaryIndex::parse(*old_contents);
+                if (const auto old_index = maybe_old_index.get())
+                {
+                    for (auto&& entry : old_index->entries)
+                    {
+                        if (entry.second.time >= index.scan_time) index.entries[entry.first] = entry.second;
+                    }
+                }
+            }
+
+            std::string contents = BinaryIndex::format_header(index.scan_time);
+            for (auto&& entry : index.entries)
+            {
+                contents += BinaryIndex::format_entry(entry.first, entry.second);
+            }
+
+            const auto destination = index_path();
+            const auto tmp = Files::unique_temporary_path(destination);
+            fs.create_directories(dir, ec);
+            fs.write_contents(tmp, contents, ec);
+            if (!ec) fs.rename(tmp, destination, ec);
+            if (ec) fs.remove(tmp, ec);
+
+            return index;
+        }
+
+        void record(BinaryIndex& index, const std::string& abi, CacheStatus status) const
+        {
+            BinaryIndex::Entry entry{status, 0, seconds_since_epoch()};
+            if (status == CacheStatus::AVAILABLE)
+            {
+                std::error_code ec;
+                const auto size = fs::stdfs::file_size(archive_path(abi), ec);
+                if (!ec) entry.size = size;
+            }
+            index.entries[abi] = entry;
+            if (!can_write()) return;
+
+            std::error_code ec;
+            fs.append_contents(index_path(), BinaryIndex::format_entry(abi, entry), ec);
+        }
+
+        Files::Filesystem& fs;
+        fs::path dir;
+        mutable Util::LockGuarded<IndexState> index_state;
+    };
+
+    struct HttpProvider final : BinaryProvider
+    {
+        HttpProvider(const std::string& url_prefix, Access access) : BinaryProvider(access), url_prefix(url_prefix)
+        {
+            while (!this->url_prefix.empty() && this->url_prefix.back() == '/')
+                this->url_prefix.pop_back();
+        }
+
+        std::string archive_url(const std::string& abi) const { return url_prefix + "/" + abi + ".zip"; }
+        std::string tombstone_url(const std::string& abi) const { return url_prefix + "/fail/" + abi + ".zip"; }
+
+        // --fail turns HTTP errors into a non-zero exit code.
+        static bool curl(const std::vector<std::string>& arguments)
+        {
+            std::vector<std::string> argv{"curl", "--silent", "--fail", "--location"};
+            argv.insert(argv.end(), arguments.begin(), arguments.end());
+            return System::spawn_and_capture_output(argv).exit_code == 0;
+        }
+
+        std::string location(const std::string& abi) const override { return archive_url(abi); }
+
+        CacheStatus lookup(const std::string& abi) const override
+        {
+            if (curl({"--head", archive_url(abi)})) return CacheStatus::AVAILABLE;
+            if (curl({"--head", tombstone_url(abi)})) return CacheStatus::FAILED;
+            return CacheStatus::MISSING;
+        }
+
+        Optional<fs::path> fetch(const std::string& abi, const fs::path& scratch_path) const override
+        {
+            auto& fs = Files::get_real_filesystem();
+            std::error_code ec;
+            fs.create_directories(scratch_path.parent_path(), ec);
+            fs.remove(scratch_path, ec);
+
+            if (curl({"--output", scratch_path.u8string(), archive_url(abi)}))
+            {
+                return scratch_path;
+            }
+            fs.remove(scratch_path, ec);
+            return nullopt;
+        }
+
+        bool store(const std::string& abi, const fs::path& archive_path) const override
+        {
+            const auto url = archive_url(abi);
+            if (curl({"--upload-file", archive_path.u8string(), url}))
+            {
+                return true;
+            }
+            System::println(System::Color::warning, "Failed to store binary cache %s", url);
+            return false;
+        }
+
+        void store_failure(const std::string& abi) const override
+        {
+            curl({"--request", "PUT", "--data-binary", "", tombstone_url(abi)});
+        }
+
+        void clear_failure(const std::string& abi) const override
+        {
+            curl({"--request", "DELETE", tombstone_url(abi)});
+        }
+
+    private:
+        std::string url_prefix;
+    };
+
+    std::unique_ptr<BinaryProvider> make_directory_provider(Files::Filesystem& fs, const fs::path& dir, Access access)
+    {
+        return std::make_unique<DirectoryProvider>(fs, dir, access);
+    }
+
+    std::unique_ptr<BinaryProvider> make_http_provider(const std::string& url_prefix, Access access)
+    {
+        return std::make_unique<HttpProvider>(url_prefix, access);
+    }
+
+    CacheStatus BinaryProviders::lookup(const std::string& abi) const
+    {
+        CacheStatus status = CacheStatus::MISSING;
+        for (auto&& provider : providers)
+        {
+            if (!provider->can_read()) continue;
+
+            const auto provider_status = provider->lookup(abi);
+            if (provider_status == CacheStatus::AVAILABLE) return CacheStatus::AVAILABLE;
+            if (provider_status == CacheStatus::FAILED) status = CacheStatus::FAILED;
+        }
+        return status;
+    }
+
+    Optional<BinaryProviders::FetchResult> BinaryProviders::fetch(const std::string& abi,
+                                                                  const fs::path& scratch_path) const
+    {
+        const Trace::Span span("binary cache fetch", abi);
+        for (auto it = providers.begin(); it != providers.end(); ++it)
+        {
+            if (!(*it)->can_read()) continue;
+
+            auto maybe_archive = (*it)->fetch(abi, scratch_path);
+            if (const auto archive = maybe_archive.get())
+            {
+                for (auto earlier = providers.begin(); earlier != it; ++earlier)
+                {
+                    if ((*earlier)->can_write()) (*earlier)->store(abi, *archive);
+                }
+                return FetchResult{(*it)->location(abi), std::move(*archive)};
+            }
+        }
+        return nullopt;
+    }
+
+    std::vector<std::string> BinaryProviders::store(const std::string& abi, const fs::path& archive_path) const
+    {
+        std::vector<std::string> locations;
+        for (auto&& provider : providers)
+        {
+            if (provider->can_write() && provider->store(abi, archive_path))
+            {
+                locations.push_back(provider->location(abi));
+            }
+        }
+        return locations;
+    }
+
+    void BinaryProviders::store_failure(const std::string& abi) const
+    {
+        for (auto&& provider : providers)
+        {
+            if (provider->can_write()) provider->store_failure(abi);
+        }
+    }
+
+    void BinaryProviders::clear_failure(const std::string& abi) const
+    {
+        for (auto&& provider : providers)
+        {
+            if (provider->can_write()) provider->clear_failure(abi);
+        }
+    }
+
+    static Optional<Access> parse_access(const std::string& text)
+    {
+        if (text == "read") return Access::READ;
+        if (text == "write") return Access::WRITE;
+        if (text == "readwrite") return Access::READ_WRITE;
+        return nullopt;
+    }
+
+    ExpectedT<BinaryProviders, std::string> parse_binary_sources(Files::Filesystem& fs,
+                                                                 const fs::path& default_dir,
+                                                                 const std::string& sources)
+    {
+        BinaryProviders ret;
+        ret.providers.push_back(make_directory_provider(fs, default_dir, Access::READ_WRITE));
+
+        for (auto&& source : Strings::split(sources, ";"))
+        {
+            if (source.empty()) continue;
+
+            const auto fields = Strings::split(source, ",");
+            const std::string& kind = fields.at(0);
+
+            if (kind == "clear")
+            {
+                if (fields.size() != 1) return "unexpected arguments to 'clear' in binary source: " + source;
+                ret.providers.clear();
+                continue;
+            }
+
+            const size_t access_index = kind == "default" ? 1 : 2;
+            if (kind != "default" && fields.size() < 2) return "expected a path or URL in binary source: " + source;
+            if (fields.size() > access_index + 1) return "too many arguments in binary source: " + source;
+
+            Access access = kind == "default" ? Access::READ_WRITE : Access::READ;
+            if (fields.size() == access_index + 1)
+            {
+                const auto maybe_access = parse_access(fields.at(access_index));
+                if (const auto a = maybe_access.get())
+                    access = *a;
+                else
+                    return Strings::format("invalid access '%s' in binary source '%s', expected one of: %s",
+                                           fields.at(access_index),
+                                           source,
+                                           "read, write, readwrite");
+            }
+
+            if (kind == "default")
+                ret.providers.push_back(make_directory_provider(fs, default_dir, access));
+            else if (kind == "files")
+                ret.providers.push_back(make_directory_provider(fs, fs::u8path(fields.at(1)), access));
+            else if (kind == "http")
+                ret.providers.push_back(make_http_provider(fields.at(1), access));
+            else
+                return Strings::format("unknown binary source kind '%s' in '%s'", kind, source);
+        }
+
+        return std::move(ret);
+    }
+
+    const BinaryProviders& get_binary_providers(const VcpkgPaths& paths)
+    {
+        static const BinaryProviders s_providers = [&]() {
+            const auto sources = System::get_environment_variable("VCPKG_BINARY_SOURCES").value_or("");
+            auto maybe_providers = parse_binary_sources(paths.get_filesystem(), paths.root / "archives", sources);
+            if (const auto providers = maybe_providers.get()) return std::move(*providers);
+
+            Checks::exit_with_message(
+                VCPKG_LINE_INFO, "Error: invalid VCPKG_BINARY_SOURCES: %s", maybe_providers.error());
+        }();
+        return s_providers;
+    }
+
+    namespace
+    {
+        struct StoreJob
+        {
+            const BinaryProviders* providers;
+            Files::Filesystem* fs;
+            std::string abi;
+            fs::path package_dir;
+            fs::path archive_path;
+        };
+
+        struct StoreStats
+        {
+            size_t stored = 0;
+            size_t failed = 0;
+            std::uintmax_t bytes = 0;
+        };
+
+        // Compression of each archive is already spread over all cores, so a couple of workers are enough to keep
+        // one archive compressing while another uploads.
+        constexpr size_t MAX_STORE_WORKERS = 2;
+        constexpr size_t MAX_QUEUED_STORES = 4;
+
+        thread_local bool t_is_store_worker = false;
+
+        struct StoreQueue : Util::ResourceBase
+        {
+            void enqueue(StoreJob&& job)
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                space_available.wait(lock, [&]() { return queued.size() < MAX_QUEUED_STORES; });
+
+                busy_dirs.insert(job.package_dir);
+                queued.push_back(std::move(job));
+                if (idle_workers == 0 && workers < MAX_STORE_WORKERS)
+                {
+                    ++workers;
+                    std::thread([this]() { work(); }).detach();
+                }
+                work_available.notify_one();
+            }
+
+            void remove_package_dir(Files::Filesystem& fs, const fs::path& package_dir)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (Util::Sets::contains(busy_dirs, package_dir))
+                    {
+                        remove_after_store.insert(package_dir);
+                        return;
+                    }
+                }
+
+                std::error_code ec;
+                fs.remove_all(package_dir, ec);
+            }
+
+            bool is_pending(const fs::path& package_dir)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                return Util::Sets::contains(busy_dirs, package_dir);
+            }
+
+            void flush()
+            {
+                // A worker exiting the process must not wait for itself.
+                if (t_is_store_worker) return;
+
+                StoreStats finished;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    if (!queued.empty() || running != 0)
+                    {
+                        System::println("Waiting for %zu binary cache stores to finish...", queued.size() + running);
+                        idle.wait(lock, [&]() { return queued.empty() && running == 0; });
+                    }
+                    std::swap(finished, stats);
+                }
+
+                if (finished.stored != 0)
+                {
+                    System::println("Stored %zu binary packages (%.1f MiB) in the background",
+                                    finished.stored,
+                                    finished.bytes / (1024.0 * 1024.0));
+                }
+                if (finished.failed != 0)
+                {
+                    System::println(System::Color::warning, "Failed to store %zu binary packages", finished.failed);
+                }
+            }
+
+        private:
+            void work()
+            {
+                t_is_store_worker = true;
+                std::unique_lock<std::mutex> lock(mutex);
+                while (true)
+                {
+                    ++idle_workers;
+                    work_available.wait(lock, [&]() { return !queued.empty(); });
+                    --idle_workers;
+
+                    StoreJob job = std::move(queued.front());
+                    queued.pop_front();
+                    ++running;
+                    space_available.notify_one();
+
+                    lock.unlock();
+                    const auto size = run(job);
+                    lock.lock();
+
+                    if (size == 0)
+                    {
+                        ++stats.failed;
+                    }
+                    else
+                    {
+                        ++stats.stored;
+                        stats.bytes += size;
+                    }
+
+                    busy_dirs.erase(job.package_dir);
+                    if (remove_after_store.erase(job.package_dir) != 0)
+                    {
+                        std::error_code ec;
+                        job.fs->remove_all(job.package_dir, ec);
+                    }
+
+                    --running;
+                    if (queued.empty() && running == 0) idle.notify_all();
+                }
+            }
+
+            // Returns the size of the stored archive, or 0 if no provider accepted it.
+            static std::uintmax_t run(const StoreJob& job)
+            {
+                const Trace::Span span("binary cache store", job.abi);
+                auto& fs = *job.fs;
+
+                std::error_code ec;
+                fs.remove(job.archive_path, ec);
+                Checks::check_exit(VCPKG_LINE_INFO,
+                                   !fs.exists(job.archive_path),
+                                   "Could not remove file: %s",
+                                   job.archive_path.u8string());
+
+                Archives::compress_directory_to_zip(fs, job.package_dir, job.archive_path);
+                const auto size = fs::stdfs::file_size(job.archive_path, ec);
+
+                const auto locations = job.providers->store(job.abi, job.archive_path);
+                for (auto&& location : locations)
+                {
+                    System::println("Stored binary cache: %s", location);
+                }
+
+                fs.remove(job.archive_path, ec);
+                return locations.empty() ? 0 : size;
+            }
+
+            std::mutex mutex;
+            std::condition_variable work_available;
+            std::condition_variable space_available;
+            std::condition_variable idle;
+
+            std::deque<StoreJob> queued;
+            size_t workers = 0;
+            size_t idle_workers = 0;
+            size_t running = 0;
+            std::set<fs::path> busy_dirs;
+            std::set<fs::path> remove_after_store;
+            StoreStats stats;
+        };
+
+        StoreQueue& get_store_queue()
+        {
+            // Workers are detached and may still be running during static destruction, so the queue is never
+            // destroyed. Instead, the pending stores are waited for and reported on when the tool exits.
+            static StoreQueue* queue = [] {
+                Checks::register_exit_hook([] { get_store_queue().flush(); });
+                return new StoreQueue();
+            }();
+            return *queue;
+        }
+    }
+
+    void enqueue_store(const VcpkgPaths& paths,
+                       const std::string& abi,
+                       const fs::path& package_dir,
+                       const fs::path& tmp_archive_path)
+    {
+        get_store_queue().enqueue(
+            StoreJob{&get_binary_providers(paths), &paths.get_filesystem(), abi, package_dir, tmp_archive_path});
+    }
+
+    void remove_package_dir(Files::Filesystem& fs, const fs::path& package_dir)
+    {
+        get_store_queue().remove_package_dir(fs, package_dir);
+    }
+
+    bool is_store_pending(const fs::path& package_dir) { return get_store_queue().is_pending(package_dir); }
+
+    namespace
+    {
+        enum class PrefetchState
+        {
+            QUEUED,
+            RUNNING,
+            DONE,
+        };
+
+        struct PrefetchJob
+        {
+            PrefetchRequest request;
+            std::string abi;
+            PrefetchState state = PrefetchState::QUEUED;
+            Optional<std::string> location;
+        };
+
+        // Extracting an archive is already spread over all cores; a few workers keep downloads overlapped with it.
+        constexpr size_t MAX_PREFETCH_WORKERS = 4;
+
+        struct Prefetcher : Util::ResourceBase
+        {
+            void start(const VcpkgPaths& paths, std::vector<PrefetchRequest>&& requests)
+            {
+                finish(paths);
+                if (requests.empty()) return;
+
+                std::lock_guard<std::mutex> lock(mutex);
+                for (auto&& request : requests)
+                {
+                    auto job = std::make_shared<PrefetchJob>();
+                    job->request = std::move(request);
+                    jobs[job->request.spec] = job;
+                    queued.push_back(std::move(job));
+                }
+
+                const size_t worker_count = std::min(MAX_PREFETCH_WORKERS, queued.size());
+                for (size_t i = 0; i < worker_count; ++i)
+                {
+                    ++workers;
+                    std::thread([this, &paths]() { work(paths); }).detach();
+                }
+            }
+
+            Optional<std::string> claim(const VcpkgPaths& paths, const PackageSpec& spec, const std::string& abi)
+            {
+                std::shared_ptr<PrefetchJob> job;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    const auto it = jobs.find(spec);
+                    if (it == jobs.end()) return nullopt;
+
+                    job = std::move(it->second);
+                    jobs.erase(it);
+
+                    // Workers skip jobs that are no longer in `jobs`.
+                    if (job->state == PrefetchState::QUEUED) return nullopt;
+                    done.wait(lock, [&]() { return job->state == PrefetchState::DONE; });
+                }
+
+                auto& fs = paths.get_filesystem();
+                const auto staging = staging_dir(paths, spec);
+                std::error_code ec;
+
+                const auto location = job->location.get();
+                if (location && job->abi == abi)
+                {
+                    const auto package_dir = paths.package_dir(spec);
+                    fs.remove_all(package_dir, ec);
+                    fs.create_directories(package_dir.parent_path(), ec);
+                    fs.rename(staging, package_dir, ec);
+                    if (!ec) return *location;
+                }
+
+                fs.remove_all(staging, ec);
+                return nullopt;
+            }
+
+            void finish(const VcpkgPaths& paths)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    jobs.clear();
+                    queued.clear();
+                    done.wait(lock, [&]() { return workers == 0; });
+                }
+
+                std::error_code ec;
+                paths.get_filesystem().remove_all(staging_root(paths), ec);
+            }
+
+        private:
+            static fs::path staging_root(const VcpkgPaths& paths) { return paths.packages / ".prefetch"; }
+            static fs::path staging_dir(const VcpkgPaths& paths, const PackageSpec& spec)
+            {
+                return staging_root(paths) / spec.dir();
+            }
+
+            void work(const VcpkgPaths& paths)
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                while (!queued.empty())
+                {
+                    auto job = std::move(queued.front());
+                    queued.pop_front();
+
+                    const auto it = jobs.find(job->request.spec);
+                    if (it == jobs.end() || it->second != job) continue;
+
+                    job->state = PrefetchState::RUNNING;
+                    lock.unlock();
+                    auto abi = job->request.get_abi();
+                    auto location = abi.empty() ? nullopt : run(paths, job->request.spec, abi);
+                    lock.lock();
+
+                    job->abi = std::move(abi);
+                    job->location = std::move(location);
+                    job->state = PrefetchState::DONE;
+                    done.notify_all();
+                }
+
+                --workers;
+                done.notify_all();
+            }
+
+            static Optional<std::string> run(const VcpkgPaths& paths, const PackageSpec& spec, const std::string& abi)
+            {
+                auto& fs = paths.get_filesystem();
+                const auto staging = staging_dir(paths, spec);
+                const auto scratch_path = staging_root(paths) / (spec.dir() + ".zip");
+
+                auto maybe_fetched = get_binary_providers(paths).fetch(abi, scratch_path);
+                const auto fetched = maybe_fetched.get();
+                if (!fetched) return nullopt;
+
+                std::error_code ec;
+                fs.remove_all(staging, ec);
+                fs.create_directories(staging, ec);
+                Archives::extract_zip(fs, fetched->archive_path, staging);
+                if (fetched->archive_path == scratch_path) fs.remove(scratch_path, ec);
+
+                return std::move(fetched->location);
+            }
+
+            std::mutex mutex;
+            std::condition_variable done;
+            std::deque<std::shared_ptr<PrefetchJob>> queued;
+            std::unordered_map<PackageSpec, std::shared_ptr<PrefetchJob>> jobs;
+            size_t workers = 0;
+        };
+
+        Prefetcher& get_prefetcher()
+        {
+            // Like the store queue, never destroyed because its workers are detached.
+            static Prefetcher* prefetcher = new Prefetcher();
+            return *prefetcher;
+        }
+    }
+
+    void start_prefetch(const VcpkgPaths& paths, std::vector<PrefetchRequest> requests)
+    {
+        get_prefetcher().start(paths, std::move(requests));
+    }
+
+    Optional<std::string> claim_prefetched_package(const VcpkgPaths& paths,
+                                                   const PackageSpec& spec,
+                                                   const std::string& abi)
+    {
+        return get_prefetcher().claim(paths, spec, abi);
+    }
+
+    void finish_prefetch(const VcpkgPaths& paths) { get_prefetcher().finish(paths); }
+}
@@ -1,12 +1,17 @@
 #include "pch.h"
 
+#include <vcpkg/archives.h>
+#include <vcpkg/binarycaching.h>
 #include <vcpkg/base/checks.h>
 #include <vcpkg/base/chrono.h>
+#include <vcpkg/base/downloads.h>
 #include <vcpkg/base/enums.h>
 #include <vcpkg/base/hash.h>
 #include <vcpkg/base/optional.h>
+#include <vcpkg/base/stats.h>
 #include <vcpkg/base/stringliteral.h>
 #include <vcpkg/base/system.h>
+#include <vcpkg/base/trace.h>
 
 #include <vcpkg/build.h>
 #include <vcpkg/commands.h>
@@ -337,12 +342,51 @@ namespace vcpkg::Build
         return ret;
     }
 
+    // vcpkg_download_distfile reads the sources back in the form parse_asset_sources accepts, with explicit access.
+    static std::string asset_sources_for_cmake()
+    {
+        return Strings::join(";", Downloads::get_asset_sources(), [](const Downloads::AssetSource& source) {
+            return source.to_string();
+        });
+    }
+
+    // Both the build and the download-only evaluation of a portfile get the same variables, since portfile helpers such
+    // as vcpkg_configure_cmake check them before anything is downloaded.
+    static std::vector<System::CMakeVariable> get_portfile_variables(const VcpkgPaths& paths,
+                                                                     const BuildPackageConfig& config,
+                                                                     const Toolset& toolset,
+                                                                     const std::string& cmd)
+    {
+        std::string all_features;
+        for (auto& feature : config.scf.feature_paragraphs)
+        {
+            all_features.append(feature->name + ";");
+        }
+
+        return {
+            {"CMD", cmd},
+            {"PORT", config.scf.core_paragraph->name},
+            {"CURRENT_PORT_DIR", config.port_dir},
+            {"TARGET_TRIPLET", config.triplet.canonical_name()},
+            {"VCPKG_PLATFORM_TOOLSET", toolset.version.c_str()},
+            {"VCPKG_USE_HEAD_VERSION", Util::Enum::to_bool(config.build_package_options.use_head_version) ? "1" : "0"},
+            {"_VCPKG_NO_DOWNLOADS", !Util::Enum::to_bool(config.build_package_options.allow_downloads) ? "1" : "0"},
+            {"_VCPKG_DOWNLOAD_TOOL", to_string(config.build_package_options.download_tool)},
+            {"_VCPKG_ASSET_SOURCES", asset_sources_for_cmake()},
+            {"GIT", paths.get_tool_exe(Tools::GIT)},
+            {"FEATURES", Strings::join(";", config.feature_list)},
+            {"ALL_FEATURES", all_features},
+        };
+    }
+
     static ExtendedBuildResult do_build_package(const VcpkgPaths& paths,
                                                 const PreBuildInfo& pre_build_info,
                                                 const PackageSpec& spec,
                                                 const std::string& abi_tag,
                                                 const BuildPackageConfig& config)
     {
+        const Trace::Span span("build", spec.to_string());
+
         auto& fs = paths.get_filesystem();
         const Triplet& triplet = spec.triplet();
 
@@ -353,49 +397,45 @@ namespace vcpkg::Build
 #endif
 
         const fs::path& cmake_exe_path = paths.get_tool_exe(Tools::CMAKE);
-        const fs::path& git_exe_path = paths.get_tool_exe(Tools::GIT);
-
-        std::string all_features;
-        for (auto& feature : config.scf.feature_paragraphs)
-        {
-            all_features.append(feature->name + ";");
-        }
 
         const Toolset& toolset = paths.get_toolset(pre_build_info);
-        const std::string cmd_launch_cmake = System::make_cmake_cmd(
-            cmake_exe_path,
-            paths.ports_cmake,
-            {
-                {"CMD", "BUILD"},
-                {"PORT", config.scf.core_paragraph->name},
-                {"CURRENT_PORT_DIR", config.port_dir},
-                {"TARGET_TRIPLET", spec.triplet().canonical_name()},
-                {"VCPKG_PLATFORM_TOOLSET", toolset.version.c_str()},
-                {"VCPKG_USE_HEAD_VERSION",
-                 Util::Enum::to_bool(config.build_package_options.use_head_version) ? "1" : "0"},
-                {"_VCPKG_NO_DOWNLOADS", !Util::Enum::to_bool(config.build_package_options.allow_downloads) ? "1" : "0"},
-                {"_VCPKG_DOWNLOAD_TOOL", to_string(config.build_package_options.download_tool)},
-                {"GIT", git_exe_path},
-                {"FEATURES", Strings::join(";", config.feature_list)},
-                {"ALL_FEATURES", all_features},
-            });
+        const std::vector<System::CMakeVariable> variables = get_portfile_variables(paths, config, toolset, "BUILD");
 
-        auto command = make_build_env_cmd(pre_build_info, toolset);
-        if (!command.empty())
-        {
-#ifdef _WIN32
-            command.append(" & ");
+        const auto env_cmd = make_build_env_cmd(pre_build_info, toolset);
+        const auto cmake_cmd = System::make_cmake_cmd(cmake_exe_path, paths.ports_cmake, variables);
+        const auto timer = Chrono::ElapsedTimer::create_started();
+
+        Optional<System::ResourceUsage> resource_usage;
+#if defined(_WIN32)
+        const int return_code = System::cmd_execute_clean(env_cmd.empty() ? cmake_cmd : env_cmd + " & " + cmake_cmd);
 #else
-            command.append(" && ");
-#endif
+        // A build running on a worker thread joins the rest of the job's output instead of writing to the console.
+        System::ProcessOptions options;
+        if (const auto buffer = System::OutputBuffer::current())
+        {
+            options.output = System::ProcessOutput::CAPTURE;
+            options.redirect_errors = true;
+            options.on_output = [buffer](const char* data, size_t size) { buffer->append(data, size); };
         }
-        command.append(cmd_launch_cmake);
-        const auto timer = Chrono::ElapsedTimer::create_started();
 
-        const int return_code = System::cmd_execute_clean(command);
+        // Without a toolchain environment to set up first, cmake is started directly rather than through a shell. The
+        // shell is spawned the same way, so either way wait4 reports what the whole build used.
+        auto process =
+            env_cmd.empty()
+                ? System::spawn(System::make_cmake_argv(cmake_exe_path, paths.ports_cmake, variables), options)
+                : System::spawn({"/bin/sh", "-c", env_cmd + " && " + cmake_cmd}, options);
+        const int return_code = process.wait().exit_code;
+        resource_usage = process.resource_usage();
+#endif
         const auto buildtimeus = timer.microseconds();
         const auto spec_string = spec.to_string();
 
+        // Failed builds are as worth measuring as successful ones, so every result from here on carries the usage.
+        const auto with_usage = [&](ExtendedBuildResult&& result) {
+            result.resource_usage = resource_usage;
+            return std::move(result);
+        };
+
         {
             auto locked_metrics = Metrics::g_metrics.lock();
             locked_metrics->track_buildtime(spec.to_string() + ":[" + Strings::join(",", config.feature_list) + "]",
@@ -404,7 +444,7 @@ namespace vcpkg::Build
             {
                 locked_metrics->track_property("error", "build failed");
                 locked_metrics->track_property("build_error", spec_string);
-                return BuildResult::BUILD_FAILED;
+                return with_usage(BuildResult::BUILD_FAILED);
             }
         }
 
@@ -415,7 +455,7 @@ namespace vcpkg::Build
 
         if (error_count != 0)
         {
-            return BuildResult::POST_BUILD_CHECKS_FAILED;
+            return with_usage(BuildResult::POST_BUILD_CHECKS_FAILED);
         }
         for (auto&& feature : config.feature_list)
         {
@@ -428,9 +468,197 @@ namespace vcpkg::Build
         }
 
         write_binary_control_file(paths, *bcf);
-        return {BuildResult::SUCCEEDED, std::move(bcf)};
+        return with_usage({BuildResult::SUCCEEDED, std::move(bcf)});
+    }
+
+    bool download_sources(const VcpkgPaths& paths, const BuildPackageConfig& config)
+    {
+        auto& fs = paths.get_filesystem();
+        const std::string& name = config.scf.core_paragraph->name;
+
+        const auto pre_build_info = PreBuildInfo::from_triplet_file(paths, config.triplet);
+        const auto cmake_argv = System::make_cmake_argv(
+            paths.get_tool_exe(Tools::CMAKE),
+            paths.ports_cmake,
+            get_portfile_variables(paths, config, paths.get_toolset(pre_build_info), "DOWNLOAD"));
+
+        const auto result = System::spawn_and_capture_output(cmake_argv);
+        if (GlobalState::debugging)
+        {
+            System::println("[DEBUG] Downloading sources for %s:%s exited with %d:\n%s",
+                            name,
+                            config.triplet,
+                            result.exit_code,
+                            result.output);
+        }
+
+        // ports.cmake points the portfile's buildtree and package directories here in download mode.
+        std::error_code ec;
+        fs.remove_all(paths.buildtrees / name / ("download-" + config.triplet.canonical_name()), ec);
+
+        return result.exit_code == 0;
     }
 
+    namespace
+    {
+        enum class SourcePrefetchState
+        {
+            QUEUED,
+            RUNNING,
+            DONE,
+        };
+
+        struct SourcePrefetchJob
+        {
+            SourcePrefetchJob(PackageSpec&& spec, SourcePrefetchRequest&& request)
+                : spec(std::move(spec)), request(std::move(request))
+            {
+            }
+
+            PackageSpec spec;
+            SourcePrefetchRequest request;
+            SourcePrefetchState state = SourcePrefetchState::QUEUED;
+        };
+
+        constexpr size_t MAX_SOURCE_PREFETCH_WORKERS = 4;
+
+        struct SourcePrefetcher : Util::ResourceBase
+        {
+            void start(const VcpkgPaths& paths, std::vector<SourcePrefetchRequest>&& requests)
+            {
+                finish();
+                if (requests.empty()) return;
+
+                // Resolve the tools, triplet settings and toolsets here so that the workers only read from those
+                // caches.
+                Util::unused(paths.get_tool_exe(Tools::CMAKE));
+                Util::unused(paths.get_tool_exe(Tools::GIT));
+                for (auto&& request : requests)
+                {
+                    Util::unused(paths.get_toolset(PreBuildInfo::from_triplet_file(paths, request.config.triplet)));
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+                for (auto&& request : requests)
+                {
+                    auto spec = PackageSpec::from_name_and_triplet(request.config.scf.core_paragraph->name,
+                                                                   request.config.triplet)
+                                    .value_or_exit(VCPKG_LINE_INFO);
+                    auto job = std::make_shared<SourcePrefetchJob>(std::move(spec), std::move(request));
+                    jobs[job->spec] = job;
+                    queued.push_back(std::move(job));
+                }
+
+                const size_t worker_count = std::min(MAX_SOURCE_PREFETCH_WORKERS, queued.size());
+                for (size_t i = 0; i < worker_count; ++i)
+                {
+                    ++workers;
+                    std::thread([this, &paths]() { work(paths); }).detach();
+                }
+            }
+
+            void wait_for(const PackageSpec& spec)
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                const auto it = jobs.find(spec);
+                if (it == jobs.end()) return;
+
+                auto job = std::move(it->second);
+                jobs.erase(it);
+
+                // Workers skip jobs that are no longer in `jobs`.
+                done.wait(lock, [&]() { return job->state != SourcePrefetchState::RUNNING; });
+            }
+
+            void finish()
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobs.clear();
+                queued.clear();
+                done.wait(lock, [&]() { return workers == 0; });
+            }
+
+            // Waits for the downloads of `port` in progress and keeps others from starting until release_port.
+            void hold_port(const std::string& port)
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                done.wait(lock, [&]() { return running_ports.count(port) == 0 && held_ports.count(port) == 0; });
+                held_ports.insert(port);
+            }
+
+            void release_port(const std::string& port)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                held_ports.erase(port);
+                done.notify_all();
+            }
+
+        private:
+            void work(const VcpkgPaths& paths)
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                while (!queued.empty())
+                {
+                    auto job = std::move(queued.front());
+                    queued.pop_front();
+
+                    const std::string& port = job->spec.name();
+                    done.wait(lock, [&]() { return held_ports.count(port) == 0; });
+
+                    const auto it = jobs.find(job->spec);
+                    if (it == jobs.end() || it->second != job) continue;
+
+                    job->state = SourcePrefetchState::RUNNING;
+                    running_ports.insert(port);
+                    lock.unlock();
+                    const auto abi = job->request.get_abi();
+                    if (abi.empty() || vcpkg::BinaryCaching::get_binary_providers(paths).lookup(abi) !=
+                                           vcpkg::BinaryCaching::CacheStatus::AVAILABLE)
+                    {
+                        if (!download_sources(paths, job->request.config))
+                        {
+                            Stats::add(Stats::Counter::SOURCE_PREFETCH_FAILURES);
+                            System::println(System::Color::warning,
+                                            "Warning: could not prefetch the sources for %s; they will be downloaded "
+                                            "when it is built",
+                                            job->spec);
+                        }
+                    }
+                    lock.lock();
+
+                    running_ports.erase(running_ports.find(port));
+                    job->state = SourcePrefetchState::DONE;
+                    done.notify_all();
+                }
+
+                --workers;
+                done.notify_all();
+            }
+
+            std::mutex mutex;
+            std::condition_variable done;
+            std::deque<std::shared_ptr<SourcePrefetchJob>> queued;
+            std::unordered_map<PackageSpec, std::shared_ptr<SourcePrefetchJob>> jobs;
+            std::unordered_multiset<std::string> running_ports;
+            std::unordered_set<std::string> held_ports;
+            size_t workers = 0;
+        };
+
+        SourcePrefetcher& get_source_prefetcher()
+        {
+            // Never destroyed because its workers are detached.
+            static SourcePrefetcher* prefetcher = new SourcePrefetcher();
+            return *prefetcher;
+        }
+    }
+
+    void start_source_prefetch(const VcpkgPaths& paths, std::vector<SourcePrefetchRequest> requests)
+    {
+        get_source_prefetcher().start(paths, std::move(requests));
+    }
+
+    void finish_source_prefetch() { get_source_prefetcher().finish(); }
+
     static ExtendedBuildResult do_build_package_and_clean_buildtrees(const VcpkgPaths& paths,
                                                                      const PreBuildInfo& pre_build_info,
                                                                      const PackageSpec& spec,
@@ -442,7 +670,11 @@ namespace vcpkg::Build
         if (config.build_package_options.clean_buildtrees == CleanBuildtrees::YES)
         {
             auto& fs = paths.get_filesystem();
-            const fs::path buildtrees_dir = paths.buildtrees / config.scf.core_paragraph->name;
+            const std::string& name = config.scf.core_paragraph->name;
+            const fs::path buildtrees_dir = paths.buildtrees / name;
+
+            // A prefetch of this port for another triplet writes to its own directory under the same buildtree.
+            get_source_prefetcher().hold_port(name);
             auto buildtree_files = fs.get_files_non_recursive(buildtrees_dir);
             for (auto&& file : buildtree_files)
             {
@@ -452,6 +684,7 @@ namespace vcpkg::Build
                     fs.remove_all(file, ec);
                 }
             }
+            get_source_prefetcher().release_port(name);
         }
 
         return result;
@@ -467,6 +700,7 @@ namespace vcpkg::Build
         auto& fs = paths.get_filesystem();
         const Triplet& triplet = config.triplet;
         const std::string& name = config.scf.core_paragraph->name;
+        const Trace::Span span("abi hash", Strings::format("%s:%s", name, triplet));
 
         std::vector<AbiEntry> abi_tag_entries(dependency_abis.begin(), dependency_abis.end());
 
@@ -533,44 +767,12 @@ namespace vcpkg::Build
         auto files = fs.get_files_non_recursive(pkg_path);
         Checks::check_exit(VCPKG_LINE_INFO, files.empty(), "unable to clear path: %s", pkg_path.u8string());
 
-#if defined(_WIN32)
-        auto&& seven_zip_exe = paths.get_tool_exe(Tools::SEVEN_ZIP);
-
-        System::cmd_execute_clean(Strings::format(
-            R"("%s" x "%s" -o"%s" -y >nul)", seven_zip_exe.u8string(), archive_path.u8string(), pkg_path.u8string()));
-#else
-        System::cmd_execute_clean(
-            Strings::format(R"(unzip -qq "%s" "-d%s")", archive_path.u8string(), pkg_path.u8string()));
-#endif
-    }
-
-    static void compress_archive(const VcpkgPaths& paths, const PackageSpec& spec, const fs::path& tmp_archive_path)
-    {
-        auto& fs = paths.get_filesystem();
-
-        std::error_code ec;
-
-        fs.remove(tmp_archive_path, ec);
-        Checks::check_exit(
-            VCPKG_LINE_INFO, !fs.exists(tmp_archive_path), "Could not remove file: %s", tmp_archive_path.u8string());
-#if defined(_WIN32)
-        auto&& seven_zip_exe = paths.get_tool_exe(Tools::SEVEN_ZIP);
-
-        System::cmd_execute_clean(Strings::format(R"("%s" a "%s" "%s\*" >nul)",
-                                                  seven_zip_exe.u8string(),
-                                                  tmp_archive_path.u8string(),
-                                                  paths.package_dir(spec).u8string()));
-#else
-        System::cmd_execute_clean(Strings::format(
-            R"(cd '%s' && zip --quiet -r '%s' *)", paths.package_dir(spec).u8string(), tmp_archive_path.u8string()));
-#endif
+        Archives::extract_zip(fs, archive_path, pkg_path);
     }
 
-    ExtendedBuildResult build_package(const VcpkgPaths& paths,
-                                      const BuildPackageConfig& config,
-                                      const StatusParagraphs& status_db)
+    ExpectedT<std::vector<AbiEntry>, std::vector<FeatureSpec>> compute_dependency_abis(
+        const BuildPackageConfig& config, const StatusParagraphs& status_db)
     {
-        auto& fs = paths.get_filesystem();
         const Triplet& triplet = config.triplet;
         const std::string& name = config.scf.core_paragraph->name;
 
@@ -587,7 +789,7 @@ namespace vcpkg::Build
 
         if (!required_fspecs.empty())
         {
-            return {BuildResult::CASCADED_DUE_TO_MISSING_DEPENDENCIES, std::move(required_fspecs)};
+            return std::move(required_fspecs);
         }
 
         const PackageSpec spec =
@@ -605,7 +807,34 @@ namespace vcpkg::Build
                 AbiEntry {status_it->get()->package.spec.name(), status_it->get()->package.abi});
         }
 
-        const auto pre_build_info = PreBuildInfo::from_triplet_file(paths, triplet);
+        return std::move(dependency_abis);
+    }
+
+    ExtendedBuildResult build_package(const VcpkgPaths& paths,
+                                      const BuildPackageConfig& config,
+                                      const StatusParagraphs& status_db)
+    {
+        auto maybe_dependency_abis = compute_dependency_abis(config, status_db);
+        if (!maybe_dependency_abis.has_value())
+        {
+            return {BuildResult::CASCADED_DUE_TO_MISSING_DEPENDENCIES, std::move(maybe_dependency_abis).error()};
+        }
+
+        const auto pre_build_info = PreBuildInfo::from_triplet_file(paths, config.triplet);
+
+        return build_package(paths, config, pre_build_info, *maybe_dependency_abis.get());
+    }
+
+    ExtendedBuildResult build_package(const VcpkgPaths& paths,
+                                      const BuildPackageConfig& config,
+                                      const PreBuildInfo& pre_build_info,
+                                      Span<const AbiEntry> dependency_abis)
+    {
+        auto& fs = paths.get_filesystem();
+        const Triplet& triplet = config.triplet;
+
+        const PackageSpec spec =
+            PackageSpec::from_name_and_triplet(config.scf.core_paragraph->name, triplet).value_or_exit(VCPKG_LINE_INFO);
 
         auto maybe_abi_tag_and_file = compute_abi_tag(paths, config, pre_build_info, dependency_abis);
 
@@ -613,40 +842,56 @@ namespace vcpkg::Build
 
         if (config.build_package_options.binary_caching == BinaryCaching::YES && abi_tag_and_file)
         {
-            const fs::path archives_root_dir = paths.root / "archives";
-            const std::string archive_name = abi_tag_and_file->tag + ".zip";
-            const fs::path archive_subpath = fs::u8path(abi_tag_and_file->tag.substr(0, 2)) / archive_name;
-            const fs::path archive_path = archives_root_dir / archive_subpath;
-            const fs::path archive_tombstone_path = archives_root_dir / "fail" / archive_subpath;
+            const auto& binary_providers = vcpkg::BinaryCaching::get_binary_providers(paths);
+            const std::string& abi = abi_tag_and_file->tag;
+            const auto tmp_archive_path = paths.buildtrees / spec.name() / (spec.triplet().to_string() + ".zip");
 
-            if (fs.exists(archive_path))
+            bool restored = false;
+            auto maybe_prefetched = vcpkg::BinaryCaching::claim_prefetched_package(paths, spec, abi);
+            if (const auto location = maybe_prefetched.get())
+            {
+                System::println("Using cached binary package: %s", *location);
+                restored = true;
+            }
+            else
             {
-                System::println("Using cached binary package: %s", archive_path.u8string());
+                auto maybe_fetched = binary_providers.fetch(abi, tmp_archive_path);
+                if (const auto fetched = maybe_fetched.get())
+                {
+                    System::println("Using cached binary package: %s", fetched->location);
 
-                decompress_archive(paths, spec, archive_path);
+                    decompress_archive(paths, spec, fetched->archive_path);
 
+                    std::error_code ec;
+                    if (fetched->archive_path == tmp_archive_path) fs.remove(tmp_archive_path, ec);
+                    restored = true;
+                }
+            }
+
+            if (restored)
+            {
                 auto maybe_bcf = Paragraphs::try_load_cached_package(paths, spec);
                 std::unique_ptr<BinaryControlFile> bcf =
                     std::make_unique<BinaryControlFile>(std::move(maybe_bcf).value_or_exit(VCPKG_LINE_INFO));
                 return {BuildResult::SUCCEEDED, std::move(bcf)};
             }
 
-            if (fs.exists(archive_tombstone_path))
+            if (binary_providers.lookup(abi) == vcpkg::BinaryCaching::CacheStatus::FAILED)
             {
                 if (config.build_package_options.fail_on_tombstone == FailOnTombstone::YES)
                 {
-                    System::println("Found failure tombstone: %s", archive_tombstone_path.u8string());
+                    System::println("Found failure tombstone for %s", abi);
                     return BuildResult::BUILD_FAILED;
                 }
                 else
                 {
-                    System::println(
-                        System::Color::warning, "Found failure tombstone: %s", archive_tombstone_path.u8string());
+                    System::println(System::Color::warning, "Found failure tombstone for %s", abi);
                 }
             }
 
-            System::println("Could not locate cached archive: %s", archive_path.u8string());
+            System::println("Could not locate cached archive for %s", abi);
 
+            get_source_prefetcher().wait_for(spec);
             ExtendedBuildResult result = do_build_package_and_clean_buildtrees(
                 paths, pre_build_info, spec, maybe_abi_tag_and_file.value_or(AbiTagAndFile {}).tag, config);
 
@@ -658,32 +903,18 @@ namespace vcpkg::Build
 
             if (result.code == BuildResult::SUCCEEDED)
             {
-                const auto tmp_archive_path = paths.buildtrees / spec.name() / (spec.triplet().to_string() + ".zip");
-
-                compress_archive(paths, spec, tmp_archive_path);
-
-                fs.create_directories(archive_path.parent_path(), ec);
-                fs.rename_or_copy(tmp_archive_path, archive_path, ".tmp", ec);
-                if (ec)
-                {
-                    System::println(System::Color::warning,
-                                    "Failed to store binary cache %s: %s",
-                                    archive_path.u8string(),
-                                    ec.message());
-                }
-                else
-                    System::println("Stored binary cache: %s", archive_path.u8string());
+                vcpkg::BinaryCaching::enqueue_store(paths, abi, paths.package_dir(spec), tmp_archive_path);
             }
             else if (result.code == BuildResult::BUILD_FAILED || result.code == BuildResult::POST_BUILD_CHECKS_FAILED)
             {
                 // Build failed, so store tombstone archive
-                fs.create_directories(archive_tombstone_path.parent_path(), ec);
-                fs.write_contents(archive_tombstone_path, "", ec);
+                binary_providers.store_failure(abi);
             }
 
             return result;
         }
 
+        get_source_prefetcher().wait_for(spec);
         return do_build_package_and_clean_buildtrees(
             paths, pre_build_info, spec, maybe_abi_tag_and_file.value_or(AbiTagAndFile {}).tag, config);
     }
@@ -791,33 +1022,133 @@ namespace vcpkg::Build
         return inner_create_buildinfo(*pghs.get());
     }
 
-    PreBuildInfo PreBuildInfo::from_triplet_file(const VcpkgPaths& paths, const Triplet& triplet)
+    static std::vector<std::string> capture_triplet_environment(const VcpkgPaths& paths,
+                                                                const fs::path& triplet_file_path)
     {
         static constexpr CStringView FLAG_GUID = "c35112b6-d1ba-415b-aa5d-81de856ef8eb";
 
         const fs::path& cmake_exe_path = paths.get_tool_exe(Tools::CMAKE);
         const fs::path ports_cmake_script_path = paths.scripts / "get_triplet_environment.cmake";
-        const fs::path triplet_file_path = paths.triplets / (triplet.canonical_name() + ".cmake");
 
-        const auto cmd_launch_cmake = System::make_cmake_cmd(cmake_exe_path,
-                                                             ports_cmake_script_path,
-                                                             {
-                                                                 {"CMAKE_TRIPLET_FILE", triplet_file_path},
-                                                             });
-        const auto ec_data = System::cmd_execute_and_capture_output(cmd_launch_cmake);
+        const auto cmake_argv = System::make_cmake_argv(cmake_exe_path,
+                                                        ports_cmake_script_path,
+                                                        {
+                                                            {"CMAKE_TRIPLET_FILE", triplet_file_path},
+                                                        });
+        const auto ec_data = System::spawn_and_capture_output(cmake_argv);
         Checks::check_exit(VCPKG_LINE_INFO, ec_data.exit_code == 0, ec_data.output);
 
         const std::vector<std::string> lines = Strings::split(ec_data.output, "\n");
 
-        PreBuildInfo pre_build_info;
+        auto cur = std::find(lines.cbegin(), lines.cend(), FLAG_GUID);
+        if (cur != lines.cend()) ++cur;
+        return std::vector<std::string>(cur, lines.cend());
+    }
+
+    static constexpr StringLiteral TRIPLET_INCLUDE_PREFIX = "VCPKG_TRIPLET_INCLUDE=";
+    static constexpr StringLiteral CHAINLOAD_TOOLCHAIN_PREFIX = "VCPKG_CHAINLOAD_TOOLCHAIN_FILE=";
+
+    // Hashes what a capture depends on besides the triplet file and the capture script: every file the triplet
+    // included, the chainloaded toolchain, and the value of each `ENV{<name>}` that any of these files mention.
+    static std::string hash_triplet_dependencies(const Files::Filesystem& fs,
+                                                 const fs::path& triplet_file_path,
+                                                 const std::vector<std::string>& lines)
+    {
+        std::vector<fs::path> files{triplet_file_path};
+        for (auto&& line : lines)
+        {
+            for (auto&& prefix : {TRIPLET_INCLUDE_PREFIX, CHAINLOAD_TOOLCHAIN_PREFIX})
+            {
+                if (line.size() > prefix.size() && line.compare(0, prefix.size(), prefix.c_str()) == 0)
+                    files.push_back(fs::u8path(line.substr(prefix.size())));
+            }
+        }
+
+        std::string dependencies;
+        std::set<std::string> variables;
+        for (auto&& file : files)
+        {
+            auto maybe_contents = fs.read_contents(file);
+            const auto contents = maybe_contents.get();
+            if (!contents)
+            {
+                dependencies += Strings::format("%s missing\n", file.u8string());
+                continue;
+            }
+            dependencies += Strings::format("%s %s\n", file.u8string(), Hash::get_string_hash(*contents, "SHA1"));
+
+            for (auto begin = contents->find("ENV{"); begin != std::string::npos; begin = contents->find("ENV{", begin))
+            {
+                begin += 4;
+                const auto end = contents->find('}', begin);
+                if (end == std::string::npos) break;
+                // Names computed from variables cannot be known here; their files still have to stay the same.
+                const auto name = contents->substr(begin, end - begin);
+                if (name.find('$') == std::string::npos) variables.insert(name);
+            }
+        }
+
+        for (auto&& variable : variables)
+        {
+            const auto value = System::get_environment_variable(variable);
+            dependencies += value ? Strings::format("ENV{%s}=%s\n", variable, *value.get())
+                                  : Strings::format("ENV{%s} unset\n", variable);
+        }
+        return Hash::get_string_hash(dependencies, "SHA1");
+    }
+
+    // With the "tripletcache" feature flag, the captured variables are kept in buildtrees next to the key they were
+    // captured for, so that later vcpkg invocations do not need to run CMake either. The saved capture is only used
+    // while the files the triplet included and the environment variables they read are unchanged as well.
+    static std::vector<std::string> load_triplet_environment(const VcpkgPaths& paths,
+                                                             const Triplet& triplet,
+                                                             const fs::path& triplet_file_path,
+                                                             const std::string& key)
+    {
+        if (!GlobalState::g_triplet_cache) return capture_triplet_environment(paths, triplet_file_path);
+
+        auto& fs = paths.get_filesystem();
+        const fs::path cache_file = paths.buildtrees / ".triplet-environments" / (triplet.canonical_name() + ".txt");
 
-        const auto e = lines.cend();
-        auto cur = std::find(lines.cbegin(), e, FLAG_GUID);
-        if (cur != e) ++cur;
+        // The file holds the key, the hash of the other dependencies, then the captured lines.
+        auto maybe_cached = fs.read_lines(cache_file);
+        if (auto cached = maybe_cached.get())
+        {
+            if (cached->size() >= 2 && (*cached)[0] == key)
+            {
+                std::vector<std::string> lines(cached->begin() + 2, cached->end());
+                if ((*cached)[1] == hash_triplet_dependencies(fs, triplet_file_path, lines)) return lines;
+            }
+        }
+
+        auto lines = capture_triplet_environment(paths, triplet_file_path);
+
+        std::string contents = key + "\n" + hash_triplet_dependencies(fs, triplet_file_path, lines) + "\n";
+        for (auto&& line : lines)
+        {
+            contents += line + "\n";
+        }
+
+        // Other vcpkg processes may be saving the same capture.
+        const auto tmp = Files::unique_temporary_path(cache_file);
+        std::error_code ec;
+        fs.create_directories(cache_file.parent_path(), ec);
+        fs.write_contents(tmp, contents, ec);
+        if (!ec) fs.rename(tmp, cache_file, ec);
+        if (ec) fs.remove(tmp, ec);
+
+        return lines;
+    }
+
+    static PreBuildInfo parse_triplet_environment(const VcpkgPaths& paths,
+                                                  const fs::path& triplet_file_path,
+                                                  const std::vector<std::string>& lines)
+    {
+        PreBuildInfo pre_build_info;
 
-        for (; cur != e; ++cur)
+        for (auto&& line : lines)
         {
-            auto&& line = *cur;
+            if (line.compare(0, TRIPLET_INCLUDE_PREFIX.size(), TRIPLET_INCLUDE_PREFIX.c_str()) == 0) continue;
 
             const std::vector<std::string> s = Strings::split(line, "=");
             Checks::check_exit(VCPKG_LINE_INFO,
@@ -887,8 +1218,10 @@ namespace vcpkg::Build
 
         pre_build_info.triplet_abi_tag = [&]() {
             const auto& fs = paths.get_filesystem();
+            static std::mutex s_hash_cache_mutex;
             static std::map<fs::path, std::string> s_hash_cache;
 
+            std::lock_guard<std::mutex> lock(s_hash_cache_mutex);
             auto it_hash = s_hash_cache.find(triplet_file_path);
             if (it_hash != s_hash_cache.end())
             {
@@ -928,6 +1261,32 @@ namespace vcpkg::Build
 
         return pre_build_info;
     }
+
+    PreBuildInfo PreBuildInfo::from_triplet_file(const VcpkgPaths& paths, const Triplet& triplet)
+    {
+        static Util::LockGuarded<std::map<std::string, PreBuildInfo>> s_pre_build_info_cache;
+        const Trace::Span span("pre-build info", triplet.canonical_name());
+
+        const auto& fs = paths.get_filesystem();
+        const fs::path triplet_file_path = paths.triplets / (triplet.canonical_name() + ".cmake");
+
+        // Keyed by contents so that edits to the triplet file or to the capture script are picked up.
+        const std::string key = Hash::get_file_hash(fs, triplet_file_path, "SHA1") + "-" +
+                                Hash::get_file_hash(fs, paths.scripts / "get_triplet_environment.cmake", "SHA1");
+
+        {
+            auto cache = s_pre_build_info_cache.lock();
+            const auto it = cache->find(key);
+            if (it != cache->end()) return it->second;
+        }
+
+        // CMake runs without the lock so that other triplets are not held up; a thread that loses the race to
+        // capture the same triplet just discards its result.
+        const auto lines = load_triplet_environment(paths, triplet, triplet_file_path, key);
+        auto pre_build_info = parse_triplet_environment(paths, triplet_file_path, lines);
+        auto cache = s_pre_build_info_cache.lock();
+        return cache->emplace(key, std::move(pre_build_info)).first->second;
+    }
     ExtendedBuildResult::ExtendedBuildResult(BuildResult code) : code(code) {}
     ExtendedBuildResult::ExtendedBuildResult(BuildResult code, std::unique_ptr<BinaryControlFile>&& bcf)
         : code(code), binary_control_file(std::move(bcf))
@@ -18,7 +18,7 @@ namespace vcpkg::Commands::Cache
                 Paragraphs::get_single_paragraph(paths.get_filesystem(), path / "CONTROL");
             if (const auto p = pghs.get())
             {
-                const BinaryParagraph binary_paragraph = BinaryParagraph(*p);
+                const BinaryParagraph binary_paragraph = BinaryParagraph(Parse::to_paragraph_view(*p));
                 output.push_back(binary_paragraph);
             }
         }
@@ -5,6 +5,7 @@
 #include <vcpkg/base/stringliteral.h>
 #include <vcpkg/base/system.h>
 #include <vcpkg/base/util.h>
+#include <vcpkg/binarycaching.h>
 #include <vcpkg/build.h>
 #include <vcpkg/commands.h>
 #include <vcpkg/dependencies.h>
@@ -30,15 +31,19 @@ namespace vcpkg::Commands::CI
     static constexpr StringLiteral OPTION_EXCLUDE = "--exclude";
     static constexpr StringLiteral OPTION_PURGE_TOMBSTONES = "--purge-tombstones";
     static constexpr StringLiteral OPTION_XUNIT = "--x-xunit";
+    static constexpr StringLiteral OPTION_JOBS = "--jobs";
+    static constexpr StringLiteral OPTION_PREFETCH_SOURCES = "--prefetch-sources";
 
-    static constexpr std::array<CommandSetting, 2> CI_SETTINGS = {{
+    static constexpr std::array<CommandSetting, 3> CI_SETTINGS = {{
         {OPTION_EXCLUDE, "Comma separated list of ports to skip"},
         {OPTION_XUNIT, "File to output results in XUnit format (internal)"},
+        {OPTION_JOBS, "Number of packages to build concurrently"},
     }};
 
-    static constexpr std::array<CommandSwitch, 2> CI_SWITCHES = {{
+    static constexpr std::array<CommandSwitch, 3> CI_SWITCHES = {{
         {OPTION_DRY_RUN, "Print out plan without execution"},
         {OPTION_PURGE_TOMBSTONES, "Purge failure tombstones and retry building the ports"},
+        {OPTION_PREFETCH_SOURCES, "Download the sources of later packages while building earlier ones"},
     }};
 
     const CommandStructure COMMAND_STRUCTURE = {
@@ -64,7 +69,7 @@ namespace vcpkg::Commands::CI
     {
         UnknownCIPortsResults ret;
 
-        auto& fs = paths.get_filesystem();
+        const auto& binary_providers = vcpkg::BinaryCaching::get_binary_providers(paths);
 
         std::map<PackageSpec, std::string> abi_tag_map;
         std::set<PackageSpec> will_fail;
@@ -79,8 +84,6 @@ namespace vcpkg::Commands::CI
             Build::FailOnTombstone::YES,
         };
 
-        vcpkg::Cache<Triplet, Build::PreBuildInfo> pre_build_info_cache;
-
         auto action_plan = Dependencies::create_feature_install_plan(provider, fspecs, StatusParagraphs {});
 
         for (auto&& action : action_plan)
@@ -105,8 +108,7 @@ namespace vcpkg::Commands::CI
                             else
                                 return {spec.name(), it->second};
                         });
-                    const auto& pre_build_info = pre_build_info_cache.get_lazy(
-                        triplet, [&]() { return Build::PreBuildInfo::from_triplet_file(paths, triplet); });
+                    const auto pre_build_info = Build::PreBuildInfo::from_triplet_file(paths, triplet);
 
                     auto maybe_tag_and_file =
                         Build::compute_abi_tag(paths, build_config, pre_build_info, dependency_abis);
@@ -124,16 +126,11 @@ namespace vcpkg::Commands::CI
 
                 std::string state;
 
-                auto archives_root_dir = paths.root / "archives";
-                auto archive_name = abi + ".zip";
-                auto archive_subpath = fs::u8path(abi.substr(0, 2)) / archive_name;
-                auto archive_path = archives_root_dir / archive_subpath;
-                auto archive_tombstone_path = archives_root_dir / "fail" / archive_subpath;
-
-                if (purge_tombstones)
+                auto cache_status = vcpkg::BinaryCaching::CacheStatus::MISSING;
+                if (!abi.empty())
                 {
-                    std::error_code ec;
-                    fs.remove(archive_tombstone_path, ec); // Ignore error
+                    if (purge_tombstones) binary_providers.clear_failure(abi);
+                    cache_status = binary_providers.lookup(abi);
                 }
 
                 bool b_will_build = false;
@@ -153,12 +150,12 @@ namespace vcpkg::Commands::CI
                     ret.known.emplace(p->spec, BuildResult::CASCADED_DUE_TO_MISSING_DEPENDENCIES);
                     will_fail.emplace(p->spec);
                 }
-                else if (fs.exists(archive_path))
+                else if (cache_status == vcpkg::BinaryCaching::CacheStatus::AVAILABLE)
                 {
                     state += "pass";
                     ret.known.emplace(p->spec, BuildResult::SUCCEEDED);
                 }
-                else if (fs.exists(archive_tombstone_path))
+                else if (cache_status == vcpkg::BinaryCaching::CacheStatus::FAILED)
                 {
                     state += "fail";
                     ret.known.emplace(p->spec, BuildResult::BUILD_FAILED);
@@ -196,6 +193,8 @@ namespace vcpkg::Commands::CI
 
         const auto is_dry_run = Util::Sets::contains(options.switches, OPTION_DRY_RUN);
         const auto purge_tombstones = Util::Sets::contains(options.switches, OPTION_PURGE_TOMBSTONES);
+        const auto prefetch_sources =
+            Install::to_prefetch_sources(Util::Sets::contains(options.switches, OPTION_PREFETCH_SOURCES));
 
         std::vector<Triplet> triplets;
         for (const std::string& triplet : args.command_arguments)
@@ -278,7 +277,12 @@ namespace vcpkg::Commands::CI
             }
             else
             {
-                auto summary = Install::perform(action_plan, Install::KeepGoing::YES, paths, status_db);
+                auto summary = Install::perform(action_plan,
+                                                Install::KeepGoing::YES,
+                                                paths,
+                                                status_db,
+                                                Install::parse_jobs_setting(options),
+                                                prefetch_sources);
                 for (auto&& result : summary.results)
                     split_specs.known.erase(result.spec);
                 results.push_back({triplet, std::move(summary)});
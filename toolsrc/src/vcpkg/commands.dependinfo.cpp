@@ -120,7 +120,7 @@ namespace vcpkg::Commands::DependInfo
     {
         const ParsedArguments options = args.parse_arguments(COMMAND_STRUCTURE);
 
-        auto source_control_files = Paragraphs::load_all_ports(paths.get_filesystem(), paths.ports);
+        auto source_control_files = Paragraphs::load_all_ports(paths);
 
         if (args.command_arguments.size() == 1)
         {
@@ -117,7 +117,7 @@ namespace vcpkg::Commands::Import
                            control_file_path.generic_string());
 
         StatusParagraph spgh;
-        spgh.package = BinaryParagraph(*pghs.get());
+        spgh.package = BinaryParagraph(Parse::to_paragraph_view(*pghs.get()));
         auto& control_file_data = spgh.package;
 
         do_import(paths, include_directory, project_directory, control_file_data);
@@ -3,6 +3,7 @@
 #include <vcpkg/base/files.h>
 #include <vcpkg/base/graphs.h>
 #include <vcpkg/base/strings.h>
+#include <vcpkg/base/trace.h>
 #include <vcpkg/base/util.h>
 #include <vcpkg/dependencies.h>
 #include <vcpkg/packagespec.h>
@@ -624,6 +625,7 @@ namespace vcpkg::Dependencies
                                                        const std::vector<FeatureSpec>& specs,
                                                        const StatusParagraphs& status_db)
     {
+        const Trace::Span span("create plan");
         std::unordered_set<std::string> prevent_default_features;
         for (auto&& spec : specs)
         {
@@ -681,6 +683,7 @@ namespace vcpkg::Dependencies
 
     std::vector<AnyAction> PackageGraph::serialize() const
     {
+        const Trace::Span span("serialize plan");
         auto remove_vertex_list = m_graph_plan->remove_graph.vertex_list();
         auto remove_toposort = Graphs::topological_sort(remove_vertex_list, m_graph_plan->remove_graph);
 
@@ -10,6 +10,7 @@ namespace vcpkg
     std::atomic<bool> GlobalState::debugging(false);
     std::atomic<bool> GlobalState::feature_packages(true);
     std::atomic<bool> GlobalState::g_binary_caching(false);
+    std::atomic<bool> GlobalState::g_triplet_cache(false);
 
     std::atomic<int> GlobalState::g_init_console_cp(0);
     std::atomic<int> GlobalState::g_init_console_output_cp(0);
@@ -17,44 +18,48 @@ namespace vcpkg
 
     GlobalState::CtrlCStateMachine GlobalState::g_ctrl_c_state;
 
-    GlobalState::CtrlCStateMachine::CtrlCStateMachine() : m_state(CtrlCState::normal) {}
+    GlobalState::CtrlCStateMachine::CtrlCStateMachine() : m_children(0) {}
 
     void GlobalState::CtrlCStateMachine::transition_to_spawn_process() noexcept
     {
-        auto expected = CtrlCState::normal;
-        auto transitioned = m_state.compare_exchange_strong(expected, CtrlCState::blocked_on_child);
-        if (!transitioned)
+        int expected = m_children.load();
+        do
         {
-            // Ctrl-C was hit and is asynchronously executing on another thread
-            Checks::exit_fail(VCPKG_LINE_INFO);
-        }
+            if (expected == EXIT_REQUESTED)
+            {
+                // Ctrl-C was hit and is asynchronously executing on another thread
+                Checks::exit_fail(VCPKG_LINE_INFO);
+            }
+        } while (!m_children.compare_exchange_weak(expected, expected + 1));
     }
     void GlobalState::CtrlCStateMachine::transition_from_spawn_process() noexcept
     {
-        auto expected = CtrlCState::blocked_on_child;
-        auto transitioned = m_state.compare_exchange_strong(expected, CtrlCState::normal);
-        if (!transitioned)
+        int expected = m_children.load();
+        do
         {
-            // Ctrl-C was hit while blocked on the child process
-            Checks::exit_fail(VCPKG_LINE_INFO);
-        }
+            if (expected == EXIT_REQUESTED)
+            {
+                // Ctrl-C was hit while blocked on the child process
+                Checks::exit_fail(VCPKG_LINE_INFO);
+            }
+        } while (!m_children.compare_exchange_weak(expected, expected - 1));
     }
     void GlobalState::CtrlCStateMachine::transition_handle_ctrl_c() noexcept
     {
-        auto prev_state = m_state.exchange(CtrlCState::exit_requested);
+        auto prev_children = m_children.exchange(EXIT_REQUESTED);
 
-        if (prev_state == CtrlCState::normal)
+        if (prev_children == 0)
         {
             // Not currently blocked on a child process and Ctrl-C has not been hit.
             Checks::exit_fail(VCPKG_LINE_INFO);
         }
-        else if (prev_state == CtrlCState::exit_requested)
+        else if (prev_children == EXIT_REQUESTED)
         {
             // Ctrl-C was hit previously
         }
         else
         {
-            // This is the case where we are currently blocked on a child process
+            // This is the case where we are currently blocked on one or more child processes
         }
     }
 }
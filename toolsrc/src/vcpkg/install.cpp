@@ -2,7 +2,9 @@
 
 #include <vcpkg/base/files.h>
 #include <vcpkg/base/system.h>
+#include <vcpkg/base/trace.h>
 #include <vcpkg/base/util.h>
+#include <vcpkg/binarycaching.h>
 #include <vcpkg/build.h>
 #include <vcpkg/commands.h>
 #include <vcpkg/dependencies.h>
@@ -36,10 +38,12 @@ namespace vcpkg::Install
 
     const fs::path& InstallDir::listfile() const { return this->m_listfile; }
 
-    void install_files_and_write_listfile(Files::Filesystem& fs,
-                                          const fs::path& source_dir,
-                                          const InstallDir& destination_dir)
+    std::vector<std::string> install_files_and_write_listfile(Files::Filesystem& fs,
+                                                              const fs::path& source_dir,
+                                                              const InstallDir& destination_dir,
+                                                              const MoveFiles move_files)
     {
+        const Trace::Span span("install files", source_dir.filename().u8string());
         std::vector<std::string> output;
         std::error_code ec;
 
@@ -47,6 +51,7 @@ namespace vcpkg::Install
         const fs::path& destination = destination_dir.destination();
         const std::string& destination_subdirectory = destination_dir.destination_subdirectory();
         const fs::path& listfile = destination_dir.listfile();
+        const bool move = move_files == MoveFiles::YES;
 
         Checks::check_exit(
             VCPKG_LINE_INFO, fs.exists(source_dir), "Source directory %s does not exist", source_dir.generic_string());
@@ -59,35 +64,66 @@ namespace vcpkg::Install
             VCPKG_LINE_INFO, !ec, "Could not create directory for listfile %s", listfile.generic_string());
 
         output.push_back(Strings::format(R"(%s/)", destination_subdirectory));
-        auto files = fs.get_files_recursive(source_dir);
-        for (auto&& file : files)
-        {
-            const auto status = fs.symlink_status(file, ec);
-            if (ec)
+        const auto files = fs.get_files_recursive(source_dir);
+
+        // Large ports have tens of thousands of files, so the file system calls are spread over several threads. Only
+        // the directories are created serially, parents first, before any file is copied into them.
+        std::vector<fs::file_status> statuses(files.size());
+        Util::parallel_for_each_n(files.size(), [&](size_t i) {
+            std::error_code status_ec;
+            statuses[i] = fs.symlink_status(files[i], status_ec);
+            if (status_ec)
             {
-                System::println(System::Color::error, "failed: %s: %s", file.u8string(), ec.message());
-                continue;
+                System::println(System::Color::error, "failed: %s: %s", files[i].u8string(), status_ec.message());
+                statuses[i] = fs::file_status(fs::file_type::not_found);
             }
+        });
+
+        // Indices into `files` of the regular files and symlinks, and where they go.
+        std::vector<std::pair<size_t, fs::path>> to_copy;
+        // When moving, a directory with no counterpart in the destination is renamed into place as a whole. `files`
+        // lists each directory right before its contents, so these are still listed but need no file system calls,
+        // except to take back the files a copy would have skipped.
+        std::string moved_prefix;
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            const auto& file = files[i];
+            const auto& status = statuses[i];
+            if (status.type() == fs::file_type::not_found) continue;
+
+            const std::string suffix = file.generic_u8string().substr(prefix_length + 1);
+            fs::path target = destination / suffix;
+            const bool already_moved =
+                !moved_prefix.empty() && suffix.compare(0, moved_prefix.size(), moved_prefix) == 0;
 
             const std::string filename = file.filename().u8string();
             if (fs::is_regular_file(status) && (Strings::case_insensitive_ascii_equals(filename, "CONTROL") ||
                                                 Strings::case_insensitive_ascii_equals(filename, "BUILD_INFO")))
             {
                 // Do not copy the control file
+                if (already_moved) fs.remove(target, ec);
                 continue;
             }
 
-            const std::string suffix = file.generic_u8string().substr(prefix_length + 1);
-            const fs::path target = destination / suffix;
-
             switch (status.type())
             {
                 case fs::file_type::directory:
                 {
-                    fs.create_directory(target, ec);
-                    if (ec)
+                    if (!already_moved)
                     {
-                        System::println(System::Color::error, "failed: %s: %s", target.u8string(), ec.message());
+                        if (move && !fs.exists(target) && (fs.rename(file, target, ec), !ec))
+                        {
+                            moved_prefix = suffix + "/";
+                        }
+                        else
+                        {
+                            fs.create_directory(target, ec);
+                            if (ec)
+                            {
+                                System::println(
+                                    System::Color::error, "failed: %s: %s", target.u8string(), ec.message());
+                            }
+                        }
                     }
 
                     // Trailing backslash for directories
@@ -95,73 +131,51 @@ namespace vcpkg::Install
                     break;
                 }
                 case fs::file_type::regular:
-                {
-                    if (fs.exists(target))
-                    {
-                        System::println(System::Color::warning,
-                                        "File %s was already present and will be overwritten",
-                                        target.u8string(),
-                                        ec.message());
-                    }
-                    fs.copy_file(file, target, fs::copy_options::overwrite_existing, ec);
-                    if (ec)
-                    {
-                        System::println(System::Color::error, "failed: %s: %s", target.u8string(), ec.message());
-                    }
-                    output.push_back(Strings::format(R"(%s/%s)", destination_subdirectory, suffix));
-                    break;
-                }
                 case fs::file_type::symlink:
                 {
-                    if (fs.exists(target))
-                    {
-                        System::println(System::Color::warning,
-                                        "File %s was already present and will be overwritten",
-                                        target.u8string(),
-                                        ec.message());
-                    }
-                    fs.copy_symlink(file, target, ec);
-                    if (ec)
-                    {
-                        System::println(System::Color::error, "failed: %s: %s", target.u8string(), ec.message());
-                    }
+                    if (!already_moved) to_copy.emplace_back(i, std::move(target));
                     output.push_back(Strings::format(R"(%s/%s)", destination_subdirectory, suffix));
                     break;
                 }
                 default:
                     System::println(System::Color::error, "failed: %s: cannot handle file type", file.u8string());
+                    if (already_moved) fs.remove(target, ec);
                     break;
             }
         }
 
-        std::sort(output.begin(), output.end());
+        Util::parallel_for_each_n(to_copy.size(), [&](size_t i) {
+            const fs::path& file = files[to_copy[i].first];
+            const fs::path& target = to_copy[i].second;
+            std::error_code copy_ec;
+            if (fs.exists(target))
+            {
+                System::println(
+                    System::Color::warning, "File %s was already present and will be overwritten", target.u8string());
+            }
 
-        fs.write_lines(listfile, output);
-    }
+            // A rename fails across file systems, in which case the file is copied instead.
+            if (move)
+            {
+                fs.rename(file, target, copy_ec);
+                if (!copy_ec) return;
+                copy_ec.clear();
+            }
 
-    static void remove_first_n_chars(std::vector<std::string>* strings, const size_t n)
-    {
-        for (std::string& s : *strings)
-        {
-            s.erase(0, n);
-        }
-    };
+            if (fs::is_symlink(statuses[to_copy[i].first]))
+                fs.copy_symlink(file, target, copy_ec);
+            else
+                fs.copy_file(file, target, fs::copy_options::overwrite_existing, copy_ec);
 
-    static std::vector<std::string> extract_files_in_triplet(
-        const std::vector<StatusParagraphAndAssociatedFiles>& pgh_and_files, const Triplet& triplet)
-    {
-        std::vector<std::string> output;
-        for (const StatusParagraphAndAssociatedFiles& t : pgh_and_files)
-        {
-            if (t.pgh.package.spec.triplet() != triplet)
+            if (copy_ec)
             {
-                continue;
+                System::println(System::Color::error, "failed: %s: %s", target.u8string(), copy_ec.message());
             }
-
-            Util::Vectors::concatenate(&output, t.files);
-        }
+        });
 
         std::sort(output.begin(), output.end());
+
+        fs.write_lines(listfile, output);
         return output;
     }
 
@@ -179,32 +193,27 @@ namespace vcpkg::Install
         return SortedVector<std::string>(std::move(package_files));
     }
 
-    static SortedVector<std::string> build_list_of_installed_files(
-        const std::vector<StatusParagraphAndAssociatedFiles>& pgh_and_files, const Triplet& triplet)
-    {
-        std::vector<std::string> installed_files = extract_files_in_triplet(pgh_and_files, triplet);
-        const size_t installed_remove_char_count = triplet.canonical_name().size() + 1; // +1 for the slash
-        remove_first_n_chars(&installed_files, installed_remove_char_count);
-
-        return SortedVector<std::string>(std::move(installed_files));
-    }
-
-    InstallResult install_package(const VcpkgPaths& paths, const BinaryControlFile& bcf, StatusParagraphs* status_db)
+    InstallResult install_package(const VcpkgPaths& paths,
+                                  const BinaryControlFile& bcf,
+                                  StatusParagraphs* status_db,
+                                  const MoveFiles move_files)
     {
         const fs::path package_dir = paths.package_dir(bcf.core_paragraph.spec);
         const Triplet& triplet = bcf.core_paragraph.spec.triplet();
-        const std::vector<StatusParagraphAndAssociatedFiles> pgh_and_files = get_installed_files(paths, *status_db);
 
         const SortedVector<std::string> package_files =
             build_list_of_package_files(paths.get_filesystem(), package_dir);
-        const SortedVector<std::string> installed_files = build_list_of_installed_files(pgh_and_files, triplet);
 
         std::vector<std::string> intersection;
-        std::set_intersection(package_files.begin(),
-                              package_files.end(),
-                              installed_files.begin(),
-                              installed_files.end(),
-                              std::back_inserter(intersection));
+        {
+            auto& installed_files = status_db->installed_file_index();
+            installed_files.ensure_loaded(paths, *status_db);
+            const std::string triplet_prefix = triplet.canonical_name() + "/";
+            for (auto&& file : package_files)
+            {
+                if (installed_files.find_owner(triplet_prefix + file)) intersection.push_back(file);
+            }
+        }
 
         if (!intersection.empty())
         {
@@ -244,7 +253,10 @@ namespace vcpkg::Install
         const InstallDir install_dir = InstallDir::from_destination_root(
             paths.installed, triplet.to_string(), paths.listfile_path(bcf.core_paragraph));
 
-        install_files_and_write_listfile(paths.get_filesystem(), package_dir, install_dir);
+        auto installed_files =
+            install_files_and_write_listfile(paths.get_filesystem(), package_dir, install_dir, move_files);
+        Util::erase_remove_if(installed_files, [](const std::string& file) { return file.back() == '/'; });
+        status_db->installed_file_index().add_package(bcf.core_paragraph.spec, std::move(installed_files));
 
         source_paragraph.state = InstallState::INSTALLED;
         write_update(paths, source_paragraph);
@@ -263,14 +275,89 @@ namespace vcpkg::Install
     using Build::BuildResult;
     using Build::ExtendedBuildResult;
 
+    static BuildResult install_and_print(const VcpkgPaths& paths,
+                                         const std::string& name,
+                                         const BinaryControlFile& bcf,
+                                         StatusParagraphs& status_db,
+                                         const MoveFiles move_files)
+    {
+        System::println("Installing package %s... ", name);
+        const auto install_result = install_package(paths, bcf, &status_db, move_files);
+        switch (install_result)
+        {
+            case InstallResult::SUCCESS:
+                System::println(System::Color::success, "Installing package %s... done", name);
+                return BuildResult::SUCCEEDED;
+            case InstallResult::FILE_CONFLICTS: return BuildResult::FILE_CONFLICTS;
+            default: Checks::unreachable(VCPKG_LINE_INFO);
+        }
+    }
+
+    static std::string display_name_with_features(const InstallPlanAction& action)
+    {
+        return GlobalState::feature_packages ? action.displayname() : action.spec.to_string();
+    }
+
+    static void print_building_package(const InstallPlanAction& action)
+    {
+        if (Util::Enum::to_bool(action.build_options.use_head_version))
+            System::println("Building package %s from HEAD... ", display_name_with_features(action));
+        else
+            System::println("Building package %s... ", display_name_with_features(action));
+    }
+
+    static Build::BuildPackageConfig make_build_config(const VcpkgPaths& paths, const InstallPlanAction& action)
+    {
+        return Build::BuildPackageConfig{action.source_control_file.value_or_exit(VCPKG_LINE_INFO),
+                                         action.spec.triplet(),
+                                         paths.port_dir(action.spec),
+                                         action.build_options,
+                                         action.feature_list};
+    }
+
+    /// <summary>
+    /// Commits a finished build of a BUILD_AND_INSTALL action into the installed tree and the status database.
+    /// </summary>
+    static ExtendedBuildResult install_built_package(const VcpkgPaths& paths,
+                                                     const InstallPlanAction& action,
+                                                     ExtendedBuildResult&& result,
+                                                     StatusParagraphs& status_db)
+    {
+        if (result.code != Build::BuildResult::SUCCEEDED)
+        {
+            System::println(System::Color::error, Build::create_error_message(result.code, action.spec));
+            return std::move(result);
+        }
+
+        System::println("Building package %s... done", display_name_with_features(action));
+
+        auto bcf = std::make_unique<BinaryControlFile>(
+            Paragraphs::try_load_cached_package(paths, action.spec).value_or_exit(VCPKG_LINE_INFO));
+
+        // The package directory is deleted right after, so its files can be moved into the installed tree rather than
+        // copied, unless a binary cache store still has to compress them.
+        const fs::path package_dir = paths.package_dir(action.spec);
+        const bool clean_packages = action.build_options.clean_packages == Build::CleanPackages::YES;
+        const auto move_files = clean_packages && !BinaryCaching::is_store_pending(package_dir) ? MoveFiles::YES
+                                                                                                : MoveFiles::NO;
+        auto code = install_and_print(paths, display_name_with_features(action), *bcf, status_db, move_files);
+
+        if (clean_packages)
+        {
+            BinaryCaching::remove_package_dir(paths.get_filesystem(), package_dir);
+        }
+
+        result.code = code;
+        result.binary_control_file = std::move(bcf);
+        return std::move(result);
+    }
+
     ExtendedBuildResult perform_install_plan_action(const VcpkgPaths& paths,
                                                     const InstallPlanAction& action,
                                                     StatusParagraphs& status_db)
     {
         const InstallPlanType& plan_type = action.plan_type;
         const std::string display_name = action.spec.to_string();
-        const std::string display_name_with_features =
-            GlobalState::feature_packages ? action.displayname() : display_name;
 
         const bool is_user_requested = action.request_type == RequestType::USER_REQUESTED;
         const bool use_head_version = Util::Enum::to_bool(action.build_options.use_head_version);
@@ -285,56 +372,13 @@ namespace vcpkg::Install
             return BuildResult::SUCCEEDED;
         }
 
-        auto aux_install = [&](const std::string& name, const BinaryControlFile& bcf) -> BuildResult {
-            System::println("Installing package %s... ", name);
-            const auto install_result = install_package(paths, bcf, &status_db);
-            switch (install_result)
-            {
-                case InstallResult::SUCCESS:
-                    System::println(System::Color::success, "Installing package %s... done", name);
-                    return BuildResult::SUCCEEDED;
-                case InstallResult::FILE_CONFLICTS: return BuildResult::FILE_CONFLICTS;
-                default: Checks::unreachable(VCPKG_LINE_INFO);
-            }
-        };
-
         if (plan_type == InstallPlanType::BUILD_AND_INSTALL)
         {
-            if (use_head_version)
-                System::println("Building package %s from HEAD... ", display_name_with_features);
-            else
-                System::println("Building package %s... ", display_name_with_features);
-
-            auto result = [&]() -> Build::ExtendedBuildResult {
-                const Build::BuildPackageConfig build_config{action.source_control_file.value_or_exit(VCPKG_LINE_INFO),
-                                                             action.spec.triplet(),
-                                                             paths.port_dir(action.spec),
-                                                             action.build_options,
-                                                             action.feature_list};
-                return Build::build_package(paths, build_config, status_db);
-            }();
-
-            if (result.code != Build::BuildResult::SUCCEEDED)
-            {
-                System::println(System::Color::error, Build::create_error_message(result.code, action.spec));
-                return result;
-            }
-
-            System::println("Building package %s... done", display_name_with_features);
+            print_building_package(action);
 
-            auto bcf = std::make_unique<BinaryControlFile>(
-                Paragraphs::try_load_cached_package(paths, action.spec).value_or_exit(VCPKG_LINE_INFO));
-            auto code = aux_install(display_name_with_features, *bcf);
+            auto result = Build::build_package(paths, make_build_config(paths, action), status_db);
 
-            if (action.build_options.clean_packages == Build::CleanPackages::YES)
-            {
-                auto& fs = paths.get_filesystem();
-                const fs::path package_dir = paths.package_dir(action.spec);
-                std::error_code ec;
-                fs.remove_all(package_dir, ec);
-            }
-
-            return {code, std::move(bcf)};
+            return install_built_package(paths, action, std::move(result), status_db);
         }
 
         if (plan_type == InstallPlanType::EXCLUDED)
@@ -346,13 +390,40 @@ namespace vcpkg::Install
         Checks::unreachable(VCPKG_LINE_INFO);
     }
 
+    static std::string format_mib(const std::uint64_t bytes)
+    {
+        return Strings::format("%.1f MiB", bytes / (1024.0 * 1024.0));
+    }
+
+    static std::string format_resource_usage(const System::ResourceUsage& usage)
+    {
+        return Strings::format("user %.1f s, system %.1f s, peak RSS %s, read %s, written %s",
+                               usage.user_microseconds / 1e6,
+                               usage.system_microseconds / 1e6,
+                               format_mib(usage.peak_rss_bytes),
+                               format_mib(usage.read_bytes),
+                               format_mib(usage.written_bytes));
+    }
+
     void InstallSummary::print() const
     {
         System::println("RESULTS");
 
         for (const SpecSummary& result : this->results)
         {
-            System::println("    %s: %s: %s", result.spec, Build::to_string(result.build_result.code), result.timing);
+            if (const auto usage = result.build_result.resource_usage.get())
+            {
+                System::println("    %s: %s: %s (%s)",
+                                result.spec,
+                                Build::to_string(result.build_result.code),
+                                result.timing,
+                                format_resource_usage(*usage));
+            }
+            else
+            {
+                System::println(
+                    "    %s: %s: %s", result.spec, Build::to_string(result.build_result.code), result.timing);
+            }
         }
 
         std::map<BuildResult, int> summary;
@@ -373,14 +444,453 @@ namespace vcpkg::Install
         }
     }
 
+    namespace
+    {
+        struct QueuedBuild
+        {
+            size_t action_index;
+            Build::PreBuildInfo pre_build_info;
+            std::vector<Build::AbiEntry> dependency_abis;
+        };
+
+        struct FinishedBuild
+        {
+            size_t action_index;
+            ExtendedBuildResult result;
+
+            /// <summary>
+            /// Everything the build printed, shown once it has finished so that concurrent builds do not interleave.
+            /// </summary>
+            std::string output;
+
+            /// <summary>
+            /// Whether the build hit a check that exits the tool.
+            /// </summary>
+            bool exit_requested;
+        };
+
+        /// <summary>
+        /// Runs the builds of an install plan on a pool of up to `jobs` worker threads. A BUILD_AND_INSTALL action is
+        /// queued as soon as all of its dependencies from the plan have finished. Only the main thread touches the
+        /// status database: dependency resolution before a build and the install step after it are serialized there.
+        /// A build that would exit the tool fails instead, and the main thread exits once the other builds are done.
+        /// </summary>
+        struct ParallelInstallScheduler : Util::ResourceBase
+        {
+            ParallelInstallScheduler(const std::vector<AnyAction>& action_plan,
+                                     const KeepGoing keep_going,
+                                     const VcpkgPaths& paths,
+                                     StatusParagraphs& status_db,
+                                     const size_t jobs)
+                : action_plan(action_plan)
+                , keep_going(keep_going)
+                , paths(paths)
+                , status_db(status_db)
+                , jobs(jobs)
+                , states(action_plan.size(), ActionState::PENDING)
+                , timers(action_plan.size())
+            {
+                results.reserve(action_plan.size());
+                for (size_t i = 0; i < action_plan.size(); ++i)
+                {
+                    results.emplace_back(action_plan[i].spec(), &action_plan[i]);
+                    if (action_plan[i].install_action.has_value()) plan_index.emplace(action_plan[i].spec(), i);
+                }
+            }
+
+            std::vector<SpecSummary> run()
+            {
+                const size_t build_count = std::count_if(action_plan.begin(), action_plan.end(), [](auto&& action) {
+                    const auto p = action.install_action.get();
+                    return p && p->plan_type == InstallPlanType::BUILD_AND_INSTALL;
+                });
+                for (size_t i = 0; i < std::min(jobs, build_count); ++i)
+                {
+                    workers.emplace_back([this]() { work(); });
+                }
+
+                while (true)
+                {
+                    while (start_ready_actions())
+                    {
+                    }
+
+                    if (running == 0) break;
+
+                    std::vector<FinishedBuild> finished;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        finished_cv.wait(lock, [&]() { return !finished_builds.empty(); });
+                        finished.swap(finished_builds);
+                    }
+
+                    for (auto&& build : finished)
+                    {
+                        --running;
+                        System::print(build.output);
+
+                        const auto& install_action = action_plan[build.action_index].install_action.value_or_exit(
+                            VCPKG_LINE_INFO);
+                        finish(build.action_index,
+                               install_built_package(paths, install_action, std::move(build.result), status_db));
+                        if (build.exit_requested && !failed_spec) failed_spec = results[build.action_index].spec;
+                    }
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stopping = true;
+                }
+                queued_cv.notify_all();
+                for (auto&& worker : workers)
+                {
+                    worker.join();
+                }
+
+                if (auto p_failed = failed_spec.get())
+                {
+                    System::println(Build::create_user_troubleshooting_message(*p_failed));
+                    Checks::exit_fail(VCPKG_LINE_INFO);
+                }
+
+                return std::move(results);
+            }
+
+        private:
+            enum class ActionState
+            {
+                PENDING,
+                RUNNING,
+                DONE,
+            };
+
+            bool dependencies_finished(const InstallPlanAction& action) const
+            {
+                return std::all_of(
+                    action.computed_dependencies.begin(), action.computed_dependencies.end(), [&](auto&& dep) {
+                        const auto it = plan_index.find(dep);
+                        return it == plan_index.end() || states[it->second] == ActionState::DONE;
+                    });
+            }
+
+            void print_starting(const size_t action_index)
+            {
+                ++counter;
+                timers[action_index] = Chrono::ElapsedTimer::create_started();
+                System::println(
+                    "Starting package %zd/%zd: %s", counter, action_plan.size(), results[action_index].spec);
+            }
+
+            void finish(const size_t action_index, ExtendedBuildResult&& result)
+            {
+                states[action_index] = ActionState::DONE;
+                auto& summary = results[action_index];
+                summary.timing = timers[action_index].elapsed();
+                System::println("Elapsed time for package %s: %s", summary.spec, summary.timing.to_string());
+
+                if (result.code != BuildResult::SUCCEEDED && keep_going == KeepGoing::NO && !failed_spec)
+                {
+                    failed_spec = summary.spec;
+                }
+                summary.build_result = std::move(result);
+            }
+
+            /// <returns>`true` if any action changed state</returns>
+            bool start_ready_actions()
+            {
+                if (failed_spec) return false;
+
+                bool progress = false;
+                for (size_t i = 0; i < action_plan.size(); ++i)
+                {
+                    if (states[i] == ActionState::DONE) continue;
+
+                    if (const auto remove_action = action_plan[i].remove_action.get())
+                    {
+                        // Removals act as barriers: they run alone and in plan order.
+                        if (running != 0 || !all_done_before(i)) return progress;
+
+                        print_starting(i);
+                        Remove::perform_remove_plan_action(paths, *remove_action, Remove::Purge::YES, &status_db);
+                        finish(i, BuildResult::NULLVALUE);
+                        return true;
+                    }
+
+                    if (states[i] != ActionState::PENDING) continue;
+
+                    const auto& install_action = action_plan[i].install_action.value_or_exit(VCPKG_LINE_INFO);
+                    if (install_action.plan_type != InstallPlanType::BUILD_AND_INSTALL)
+                    {
+                        print_starting(i);
+                        finish(i, perform_install_plan_action(paths, install_action, status_db));
+                        progress = true;
+                    }
+                    else if (running < jobs && dependencies_finished(install_action))
+                    {
+                        start_build(i, install_action);
+                        progress = true;
+                    }
+
+                    if (failed_spec) return true;
+                }
+                return progress;
+            }
+
+            bool all_done_before(const size_t action_index) const
+            {
+                return std::all_of(states.begin(), states.begin() + action_index, [](ActionState s) {
+                    return s == ActionState::DONE;
+                });
+            }
+
+            void start_build(const size_t action_index, const InstallPlanAction& action)
+            {
+                print_starting(action_index);
+                print_building_package(action);
+
+                const auto build_config = make_build_config(paths, action);
+                auto maybe_dependency_abis = Build::compute_dependency_abis(build_config, status_db);
+                if (!maybe_dependency_abis.has_value())
+                {
+                    finish(action_index,
+                           install_built_package(paths,
+                                                 action,
+                                                 {BuildResult::CASCADED_DUE_TO_MISSING_DEPENDENCIES,
+                                                  std::move(maybe_dependency_abis).error()},
+                                                 status_db));
+                    return;
+                }
+
+                // Resolve the triplet settings and toolset here so that the workers only read from those caches.
+                auto pre_build_info = Build::PreBuildInfo::from_triplet_file(paths, action.spec.triplet());
+                Util::unused(paths.get_toolset(pre_build_info));
+
+                states[action_index] = ActionState::RUNNING;
+                ++running;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    queued_builds.push_back(
+                        {action_index, std::move(pre_build_info), std::move(*maybe_dependency_abis.get())});
+                }
+                queued_cv.notify_one();
+            }
+
+            void work()
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                while (true)
+                {
+                    queued_cv.wait(lock, [&]() { return stopping || !queued_builds.empty(); });
+                    if (queued_builds.empty()) return;
+
+                    auto build = std::move(queued_builds.front());
+                    queued_builds.pop_front();
+                    lock.unlock();
+                    auto finished = run_build(build);
+                    lock.lock();
+
+                    finished_builds.push_back(std::move(finished));
+                    finished_cv.notify_one();
+                }
+            }
+
+            FinishedBuild run_build(const QueuedBuild& build)
+            {
+                const auto& action = action_plan[build.action_index].install_action.value_or_exit(VCPKG_LINE_INFO);
+
+                System::OutputBuffer output;
+                const Checks::ThrowOnExit throw_on_exit;
+                try
+                {
+                    auto result = Build::build_package(
+                        paths, make_build_config(paths, action), build.pre_build_info, build.dependency_abis);
+                    return {build.action_index, std::move(result), output.take(), false};
+                }
+                catch (const Checks::ExitRequested&)
+                {
+                    return {build.action_index, BuildResult::BUILD_FAILED, output.take(), true};
+                }
+            }
+
+            const std::vector<AnyAction>& action_plan;
+            const KeepGoing keep_going;
+            const VcpkgPaths& paths;
+            StatusParagraphs& status_db;
+            const size_t jobs;
+
+            std::vector<SpecSummary> results;
+            std::unordered_map<PackageSpec, size_t> plan_index;
+            std::vector<ActionState> states;
+            std::vector<Chrono::ElapsedTimer> timers;
+            std::vector<std::thread> workers;
+            size_t running = 0;
+            size_t counter = 0;
+            Optional<PackageSpec> failed_spec;
+
+            std::mutex mutex;
+            std::condition_variable queued_cv;
+            std::condition_variable finished_cv;
+            std::deque<QueuedBuild> queued_builds;
+            std::vector<FinishedBuild> finished_builds;
+            bool stopping = false;
+        };
+    }
+
+    namespace
+    {
+        /// <summary>
+        /// Computes the ABI tags of the packages of an install plan when first asked for them, from the ABI tags of
+        /// the plan's other packages, so that the prefetch workers rather than the main thread pay for evaluating the
+        /// triplets and hashing the ports. Packages whose ABI tag cannot be known before they are built get an empty
+        /// tag.
+        /// </summary>
+        struct PlanAbiTags
+        {
+            PlanAbiTags(const VcpkgPaths& paths, const std::vector<AnyAction>& action_plan) : paths(paths)
+            {
+                for (auto&& action : action_plan)
+                {
+                    if (const auto p = action.install_action.get()) actions.emplace(p->spec, p);
+                }
+            }
+
+            std::string get(const PackageSpec& spec)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                return compute(spec);
+            }
+
+        private:
+            const std::string& compute(const PackageSpec& spec)
+            {
+                const auto it = tags.find(spec);
+                if (it != tags.end()) return it->second;
+
+                std::string tag;
+                // Dependencies outside the plan are skipped too: only the plan knows which installed packages it
+                // will keep.
+                const auto action_it = actions.find(spec);
+                if (action_it != actions.end())
+                {
+                    const InstallPlanAction& action = *action_it->second;
+                    if (const auto ipv = action.installed_package.get())
+                    {
+                        tag = ipv->core->package.abi;
+                    }
+                    else if (action.plan_type == InstallPlanType::BUILD_AND_INSTALL &&
+                             action.build_options.binary_caching == Build::BinaryCaching::YES)
+                    {
+                        tag = compute_build_tag(action);
+                    }
+                }
+
+                return tags.emplace(spec, std::move(tag)).first->second;
+            }
+
+            std::string compute_build_tag(const InstallPlanAction& action)
+            {
+                std::vector<Build::AbiEntry> dependency_abis;
+                for (auto&& dep : action.computed_dependencies)
+                {
+                    const std::string& abi = compute(dep);
+                    // Without the ABI of every dependency, neither this package nor its dependents can be known.
+                    if (abi.empty()) return std::string();
+                    dependency_abis.push_back({dep.name(), abi});
+                }
+
+                // This runs on a prefetch worker, which must not exit the tool; the build reports any error again.
+                const Checks::ThrowOnExit throw_on_exit;
+                try
+                {
+                    const auto triplet = action.spec.triplet();
+                    auto pre_build_info = pre_build_infos.find(triplet);
+                    if (pre_build_info == pre_build_infos.end())
+                    {
+                        pre_build_info =
+                            pre_build_infos.emplace(triplet, Build::PreBuildInfo::from_triplet_file(paths, triplet))
+                                .first;
+                    }
+
+                    auto maybe_tag_and_file = Build::compute_abi_tag(
+                        paths, make_build_config(paths, action), pre_build_info->second, dependency_abis);
+                    if (const auto tag_and_file = maybe_tag_and_file.get()) return std::move(tag_and_file->tag);
+                }
+                catch (const Checks::ExitRequested&)
+                {
+                }
+                return std::string();
+            }
+
+            const VcpkgPaths& paths;
+            std::mutex mutex;
+            std::unordered_map<PackageSpec, const InstallPlanAction*> actions;
+            std::unordered_map<PackageSpec, std::string> tags;
+            std::unordered_map<Triplet, Build::PreBuildInfo> pre_build_infos;
+        };
+    }
+
+    /// <summary>
+    /// Starts restoring the plan's cached packages in the background so that extraction overlaps with installing
+    /// earlier packages. build_package only uses a prefetched package if the ABI tag it computes matches.
+    /// </summary>
+    static void start_binary_prefetch(const VcpkgPaths& paths,
+                                      const std::vector<AnyAction>& action_plan,
+                                      const std::shared_ptr<PlanAbiTags>& abi_tags)
+    {
+        std::vector<BinaryCaching::PrefetchRequest> requests;
+        for (auto&& action : action_plan)
+        {
+            const auto p = action.install_action.get();
+            if (!p || p->plan_type != InstallPlanType::BUILD_AND_INSTALL ||
+                p->build_options.binary_caching != Build::BinaryCaching::YES)
+                continue;
+
+            const PackageSpec& spec = p->spec;
+            requests.push_back({spec, [abi_tags, spec]() { return abi_tags->get(spec); }});
+        }
+
+        BinaryCaching::start_prefetch(paths, std::move(requests));
+    }
+
+    static void start_source_prefetch(const VcpkgPaths& paths,
+                                      const std::vector<AnyAction>& action_plan,
+                                      const std::shared_ptr<PlanAbiTags>& abi_tags)
+    {
+        std::vector<Build::SourcePrefetchRequest> requests;
+        for (auto&& action : action_plan)
+        {
+            const auto p = action.install_action.get();
+            if (!p || p->plan_type != InstallPlanType::BUILD_AND_INSTALL) continue;
+
+            const PackageSpec& spec = p->spec;
+            requests.push_back({make_build_config(paths, *p), [abi_tags, spec]() { return abi_tags->get(spec); }});
+        }
+
+        Build::start_source_prefetch(paths, std::move(requests));
+    }
+
     InstallSummary perform(const std::vector<AnyAction>& action_plan,
                            const KeepGoing keep_going,
                            const VcpkgPaths& paths,
-                           StatusParagraphs& status_db)
+                           StatusParagraphs& status_db,
+                           const size_t jobs,
+                           const PrefetchSources prefetch_sources)
     {
-        std::vector<SpecSummary> results;
-
         const auto timer = Chrono::ElapsedTimer::create_started();
+
+        const auto abi_tags = std::make_shared<PlanAbiTags>(paths, action_plan);
+        start_binary_prefetch(paths, action_plan, abi_tags);
+        if (prefetch_sources == PrefetchSources::YES) start_source_prefetch(paths, action_plan, abi_tags);
+
+        if (jobs > 1)
+        {
+            auto results = ParallelInstallScheduler(action_plan, keep_going, paths, status_db, jobs).run();
+            Build::finish_source_prefetch();
+            BinaryCaching::finish_prefetch(paths);
+            return InstallSummary{std::move(results), timer.to_string()};
+        }
+
+        std::vector<SpecSummary> results;
         size_t counter = 0;
         const size_t package_count = action_plan.size();
 
@@ -420,6 +930,8 @@ namespace vcpkg::Install
             System::println("Elapsed time for package %s: %s", display_name, results.back().timing.to_string());
         }
 
+        Build::finish_source_prefetch();
+        BinaryCaching::finish_prefetch(paths);
         return InstallSummary{std::move(results), timer.to_string()};
     }
 
@@ -430,22 +942,54 @@ namespace vcpkg::Install
     static constexpr StringLiteral OPTION_KEEP_GOING = "--keep-going";
     static constexpr StringLiteral OPTION_XUNIT = "--x-xunit";
     static constexpr StringLiteral OPTION_USE_ARIA2 = "--x-use-aria2";
+    static constexpr StringLiteral OPTION_JOBS = "--jobs";
+    static constexpr StringLiteral OPTION_PREFETCH_SOURCES = "--prefetch-sources";
 
-    static constexpr std::array<CommandSwitch, 6> INSTALL_SWITCHES = {{
+    static constexpr std::array<CommandSwitch, 7> INSTALL_SWITCHES = {{
         {OPTION_DRY_RUN, "Do not actually build or install"},
         {OPTION_USE_HEAD_VERSION, "Install the libraries on the command line using the latest upstream sources"},
         {OPTION_NO_DOWNLOADS, "Do not download new sources"},
         {OPTION_RECURSE, "Allow removal of packages as part of installation"},
         {OPTION_KEEP_GOING, "Continue installing packages on failure"},
         {OPTION_USE_ARIA2, "Use aria2 to perform download tasks"},
+        {OPTION_PREFETCH_SOURCES, "Download the sources of later packages while building earlier ones"},
     }};
-    static constexpr std::array<CommandSetting, 1> INSTALL_SETTINGS = {{
+    static constexpr std::array<CommandSetting, 2> INSTALL_SETTINGS = {{
         {OPTION_XUNIT, "File to output results in XUnit format (Internal use)"},
+        {OPTION_JOBS, "Number of packages to build concurrently"},
     }};
 
+    size_t parse_jobs_setting(const ParsedArguments& options)
+    {
+        const auto it = options.settings.find(OPTION_JOBS);
+        if (it == options.settings.end()) return 1;
+
+        const std::string& value = it->second;
+        // stoul also accepts leading whitespace and a sign, so the first character must already be a digit.
+        size_t end = 0;
+        unsigned long jobs = 0;
+        if (!value.empty() && value[0] >= '0' && value[0] <= '9')
+        {
+            try
+            {
+                jobs = std::stoul(value, &end);
+            }
+            catch (const std::out_of_range&)
+            {
+                end = 0;
+            }
+        }
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           end == value.size() && jobs > 0 && jobs < 100000,
+                           "Error: %s must be a positive integer, got '%s'",
+                           OPTION_JOBS,
+                           value);
+        return static_cast<size_t>(jobs);
+    }
+
     std::vector<std::string> get_all_port_names(const VcpkgPaths& paths)
     {
-        auto sources_and_errors = Paragraphs::try_load_all_ports(paths.get_filesystem(), paths.ports);
+        auto sources_and_errors = Paragraphs::try_load_all_ports(paths);
 
         return Util::fmap(sources_and_errors.paragraphs,
                           [](auto&& pgh) -> std::string { return pgh->core_paragraph->name; });
@@ -592,6 +1136,7 @@ namespace vcpkg::Install
         const bool no_downloads = Util::Sets::contains(options.switches, (OPTION_NO_DOWNLOADS));
         const bool is_recursive = Util::Sets::contains(options.switches, (OPTION_RECURSE));
         const bool use_aria2 = Util::Sets::contains(options.switches, (OPTION_USE_ARIA2));
+        const bool prefetch_sources = Util::Sets::contains(options.switches, OPTION_PREFETCH_SOURCES);
         const KeepGoing keep_going = to_keep_going(Util::Sets::contains(options.switches, OPTION_KEEP_GOING));
 
         // create the plan
@@ -610,7 +1155,7 @@ namespace vcpkg::Install
             Build::FailOnTombstone::NO,
         };
 
-        auto all_ports = Paragraphs::load_all_ports(paths.get_filesystem(), paths.ports);
+        auto all_ports = Paragraphs::load_all_ports(paths);
         std::unordered_map<std::string, SourceControlFile> scf_map;
         for (auto&& port : all_ports)
             scf_map[port->core_paragraph->name] = std::move(*port);
@@ -665,7 +1210,12 @@ namespace vcpkg::Install
             Checks::exit_success(VCPKG_LINE_INFO);
         }
 
-        const InstallSummary summary = perform(action_plan, keep_going, paths, status_db);
+        const InstallSummary summary = perform(action_plan,
+                                               keep_going,
+                                               paths,
+                                               status_db,
+                                               parse_jobs_setting(options),
+                                               to_prefetch_sources(prefetch_sources));
 
         System::println("\nTotal elapsed time: %s\n", summary.total_elapsed_time);
 
@@ -719,7 +1269,10 @@ namespace vcpkg::Install
         return nullptr;
     }
 
-    std::string InstallSummary::xunit_result(const PackageSpec& spec, Chrono::ElapsedTime time, BuildResult code)
+    std::string InstallSummary::xunit_result(const PackageSpec& spec,
+                                             Chrono::ElapsedTime time,
+                                             BuildResult code,
+                                             const Optional<System::ResourceUsage>& resource_usage)
     {
         std::string inner_block;
         const char* result_string = "";
@@ -740,6 +1293,22 @@ namespace vcpkg::Install
             default: Checks::exit_fail(VCPKG_LINE_INFO);
         }
 
+        // xUnit expects the traits before the failure or skip reason.
+        if (const auto usage = resource_usage.get())
+        {
+            inner_block = Strings::format(R"(<traits><trait name="user_seconds" value="%.3f" />)"
+                                          R"(<trait name="system_seconds" value="%.3f" />)"
+                                          R"(<trait name="peak_rss_bytes" value="%llu" />)"
+                                          R"(<trait name="read_bytes" value="%llu" />)"
+                                          R"(<trait name="written_bytes" value="%llu" /></traits>)",
+                                          usage->user_microseconds / 1e6,
+                                          usage->system_microseconds / 1e6,
+                                          static_cast<unsigned long long>(usage->peak_rss_bytes),
+                                          static_cast<unsigned long long>(usage->read_bytes),
+                                          static_cast<unsigned long long>(usage->written_bytes)) +
+                          inner_block;
+        }
+
         return Strings::format(R"(<test name="%s" method="%s" time="%lld" result="%s">%s</test>)"
                                "\n",
                                spec,
@@ -754,7 +1323,8 @@ namespace vcpkg::Install
         std::string xunit_doc;
         for (auto&& result : results)
         {
-            xunit_doc += xunit_result(result.spec, result.timing, result.build_result.code);
+            xunit_doc += xunit_result(
+                result.spec, result.timing, result.build_result.code, result.build_result.resource_usage);
         }
         return xunit_doc;
     }
@@ -1,21 +1,30 @@
 #include "pch.h"
 
 #include <vcpkg/base/files.h>
+#include <vcpkg/base/stats.h>
+#include <vcpkg/base/stringrange.h>
+#include <vcpkg/base/trace.h>
 #include <vcpkg/base/util.h>
 #include <vcpkg/globalstate.h>
 #include <vcpkg/paragraphparseresult.h>
 #include <vcpkg/paragraphs.h>
 
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#endif
+
 using namespace vcpkg::Parse;
 
 namespace vcpkg::Paragraphs
 {
+    // Parses paragraphs in place: each field is a view into the text, and a value that spans several lines is
+    // normalized by moving its lines together within the text it was read from, so no field is copied.
     struct Parser
     {
-        Parser(const char* c, const char* e) : cur(c), end(e) {}
+        Parser(char* c, const char* e) : cur(c), end(e) {}
 
     private:
-        const char* cur;
+        char* cur;
         const char* const end;
 
         void peek(char& ch) const
@@ -37,10 +46,16 @@ namespace vcpkg::Paragraphs
             }
         }
 
+        void skip_to_lineend(char& ch)
+        {
+            while (cur != end && !is_lineend(*cur))
+                ++cur;
+            peek(ch);
+        }
+
         void skip_comment(char& ch)
         {
-            while (ch != '\r' && ch != '\n' && ch != '\0')
-                next(ch);
+            skip_to_lineend(ch);
             if (ch == '\r') next(ch);
             if (ch == '\n') next(ch);
         }
@@ -60,18 +75,20 @@ namespace vcpkg::Paragraphs
 
         static bool is_lineend(char ch) { return ch == '\r' || ch == '\n' || ch == 0; }
 
-        void get_fieldvalue(char& ch, std::string& fieldvalue)
+        std::string_view get_fieldvalue(char& ch)
         {
-            fieldvalue.clear();
+            char* const value_begin = cur;
+            // The normalized value is written at `out`, which never passes the line being read.
+            char* out = cur;
 
             auto beginning_of_line = cur;
             do
             {
                 // scan to end of current line (it is part of the field value)
-                while (!is_lineend(ch))
-                    next(ch);
+                skip_to_lineend(ch);
 
-                fieldvalue.append(beginning_of_line, cur);
+                if (out != beginning_of_line) std::memmove(out, beginning_of_line, cur - beginning_of_line);
+                out += cur - beginning_of_line;
 
                 if (ch == '\r') next(ch);
                 if (ch == '\n') next(ch);
@@ -79,7 +96,7 @@ namespace vcpkg::Paragraphs
                 if (is_alphanum(ch) || is_comment(ch))
                 {
                     // Line begins a new field.
-                    return;
+                    break;
                 }
 
                 beginning_of_line = cur;
@@ -93,33 +110,33 @@ namespace vcpkg::Paragraphs
                     // Line was whitespace or empty.
                     // This terminates the field and the paragraph.
                     // We leave the blank line's whitespace consumed, because it doesn't matter.
-                    return;
+                    break;
                 }
 
                 // First nonspace is not a newline. This continues the current field value.
                 // We forcibly convert all newlines into single '\n' for ease of text handling later on.
-                fieldvalue.push_back('\n');
+                *out++ = '\n';
             } while (true);
+
+            return std::string_view(value_begin, out - value_begin);
         }
 
-        void get_fieldname(char& ch, std::string& fieldname)
+        std::string_view get_fieldname(char& ch)
         {
             auto begin_fieldname = cur;
             while (is_alphanum(ch) || ch == '-')
                 next(ch);
             Checks::check_exit(VCPKG_LINE_INFO, ch == ':', "Expected ':'");
-            fieldname = std::string(begin_fieldname, cur);
+            std::string_view fieldname(begin_fieldname, cur - begin_fieldname);
 
             // skip ': '
             next(ch);
             skip_spaces(ch);
+            return fieldname;
         }
 
-        void get_paragraph(char& ch, std::unordered_map<std::string, std::string>& fields)
+        void get_paragraph(char& ch, ParagraphView& fields)
         {
-            fields.clear();
-            std::string fieldname;
-            std::string fieldvalue;
             do
             {
                 if (is_comment(ch))
@@ -128,21 +145,21 @@ namespace vcpkg::Paragraphs
                     continue;
                 }
 
-                get_fieldname(ch, fieldname);
-
-                auto it = fields.find(fieldname);
-                Checks::check_exit(VCPKG_LINE_INFO, it == fields.end(), "Duplicate field");
+                const auto fieldname = get_fieldname(ch);
+                Checks::check_exit(VCPKG_LINE_INFO,
+                                   Util::find_if(fields, [&](auto&& field) { return field.first == fieldname; }) ==
+                                       fields.end(),
+                                   "Duplicate field");
 
-                get_fieldvalue(ch, fieldvalue);
-
-                fields.emplace(fieldname, fieldvalue);
+                fields.emplace_back(fieldname, get_fieldvalue(ch));
             } while (!is_lineend(ch));
         }
 
     public:
-        std::vector<std::unordered_map<std::string, std::string>> get_paragraphs()
+        std::vector<ParagraphView> get_paragraphs()
         {
-            std::vector<std::unordered_map<std::string, std::string>> paragraphs;
+            Stats::add(Stats::Counter::PARAGRAPH_PARSES);
+            std::vector<ParagraphView> paragraphs;
 
             char ch;
             peek(ch);
@@ -163,6 +180,25 @@ namespace vcpkg::Paragraphs
         }
     };
 
+    std::vector<ParagraphView> parse_paragraph_views(std::string& text)
+    {
+        return Parser(text.data(), text.data() + text.size()).get_paragraphs();
+    }
+
+    Expected<std::vector<ParagraphView>> get_paragraph_views(const Files::Filesystem& fs,
+                                                             const fs::path& control_path,
+                                                             std::string& text)
+    {
+        Expected<std::string> contents = fs.read_contents(control_path);
+        if (auto spgh = contents.get())
+        {
+            text = std::move(*spgh);
+            return parse_paragraph_views(text);
+        }
+
+        return contents.error();
+    }
+
     Expected<std::unordered_map<std::string, std::string>> get_single_paragraph(const Files::Filesystem& fs,
                                                                                 const fs::path& control_path)
     {
@@ -189,12 +225,12 @@ namespace vcpkg::Paragraphs
 
     Expected<std::unordered_map<std::string, std::string>> parse_single_paragraph(const std::string& str)
     {
-        const std::vector<std::unordered_map<std::string, std::string>> p =
-            Parser(str.c_str(), str.c_str() + str.size()).get_paragraphs();
+        std::string text = str;
+        const std::vector<ParagraphView> p = parse_paragraph_views(text);
 
         if (p.size() == 1)
         {
-            return p.at(0);
+            return to_raw_paragraph(p.at(0));
         }
 
         return std::error_code(ParagraphParseResult::EXPECTED_ONE_PARAGRAPH);
@@ -202,23 +238,27 @@ namespace vcpkg::Paragraphs
 
     Expected<std::vector<std::unordered_map<std::string, std::string>>> parse_paragraphs(const std::string& str)
     {
-        return Parser(str.c_str(), str.c_str() + str.size()).get_paragraphs();
+        std::string text = str;
+        return Util::fmap(parse_paragraph_views(text), [](auto&& p) { return to_raw_paragraph(p); });
     }
 
-    ParseExpected<SourceControlFile> try_load_port(const Files::Filesystem& fs, const fs::path& path)
+    static void remove_features_unless_enabled(SourceControlFile& scf)
+    {
+        if (GlobalState::feature_packages) return;
+        scf.core_paragraph->default_features.clear();
+        scf.feature_paragraphs.clear();
+    }
+
+    static ParseExpected<SourceControlFile> parse_port(const fs::path& path,
+                                                       const Expected<std::vector<ParagraphView>>& pghs)
     {
-        Expected<std::vector<std::unordered_map<std::string, std::string>>> pghs = get_paragraphs(fs, path / "CONTROL");
         if (auto vector_pghs = pghs.get())
         {
-            auto csf = SourceControlFile::parse_control_file(std::move(*vector_pghs));
-            if (!GlobalState::feature_packages)
+            auto csf = SourceControlFile::parse_control_file(*vector_pghs);
+            if (auto ptr = csf.get())
             {
-                if (auto ptr = csf.get())
-                {
-                    Checks::check_exit(VCPKG_LINE_INFO, ptr->get() != nullptr);
-                    ptr->get()->core_paragraph->default_features.clear();
-                    ptr->get()->feature_paragraphs.clear();
-                }
+                Checks::check_exit(VCPKG_LINE_INFO, ptr->get() != nullptr);
+                remove_features_unless_enabled(**ptr);
             }
             return csf;
         }
@@ -228,10 +268,18 @@ namespace vcpkg::Paragraphs
         return error_info;
     }
 
+    ParseExpected<SourceControlFile> try_load_port(const Files::Filesystem& fs, const fs::path& path)
+    {
+        const Trace::Span span("load port", path.filename().u8string());
+        std::string text;
+        return parse_port(path, get_paragraph_views(fs, path / "CONTROL", text));
+    }
+
     Expected<BinaryControlFile> try_load_cached_package(const VcpkgPaths& paths, const PackageSpec& spec)
     {
-        Expected<std::vector<std::unordered_map<std::string, std::string>>> pghs =
-            get_paragraphs(paths.get_filesystem(), paths.package_dir(spec) / "CONTROL");
+        std::string text;
+        Expected<std::vector<ParagraphView>> pghs =
+            get_paragraph_views(paths.get_filesystem(), paths.package_dir(spec) / "CONTROL", text);
 
         if (auto p = pghs.get())
         {
@@ -248,18 +296,345 @@ namespace vcpkg::Paragraphs
         return pghs.error();
     }
 
-    LoadResults try_load_all_ports(const Files::Filesystem& fs, const fs::path& ports_dir)
+    // The ports snapshot holds the parsed SourceControlFile of every port that loaded, keyed by port directory name
+    // and validated against the CONTROL file's size and last write time, so an unchanged port costs one stat.
+    namespace PortsSnapshot
     {
+        static constexpr StringLiteral MAGIC = "vcpkg-ports-snapshot-2\n";
+
+        struct FileStamp
+        {
+            uint64_t size;
+            int64_t mtime;
+
+            bool operator==(const FileStamp& other) const { return size == other.size && mtime == other.mtime; }
+        };
+
+        struct Entry
+        {
+            FileStamp control_stamp;
+            std::unique_ptr<SourceControlFile> scf;
+            // Where the entry is serialized in the snapshot, so it can be copied over if the snapshot is rewritten.
+            size_t offset;
+            size_t length;
+            bool reused = false;
+        };
+
+        struct Snapshot
+        {
+            std::string data;
+            std::map<std::string, Entry> entries;
+        };
+
+        static Optional<FileStamp> stat_file(const fs::path& path)
+        {
+#if defined(_WIN32)
+            WIN32_FILE_ATTRIBUTE_DATA info;
+            if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &info)) return nullopt;
+            return FileStamp{(uint64_t(info.nFileSizeHigh) << 32) | info.nFileSizeLow,
+                             (int64_t(info.ftLastWriteTime.dwHighDateTime) << 32) | info.ftLastWriteTime.dwLowDateTime};
+#else
+            struct stat info;
+            if (::stat(path.c_str(), &info) != 0) return nullopt;
+#if defined(__APPLE__)
+            const auto& mtime = info.st_mtimespec;
+#else
+            const auto& mtime = info.st_mtim;
+#endif
+            return FileStamp{static_cast<uint64_t>(info.st_size),
+                             int64_t(mtime.tv_sec) * 1000000000 + int64_t(mtime.tv_nsec)};
+#endif
+        }
+
+        static void write_u64(std::string& out, uint64_t value)
+        {
+            for (int i = 0; i < 8; ++i)
+            {
+                out.push_back(static_cast<char>(value >> (8 * i)));
+            }
+        }
+
+        static void write_string(std::string& out, const std::string& value)
+        {
+            write_u64(out, value.size());
+            out.append(value);
+        }
+
+        static void write_strings(std::string& out, const std::vector<std::string>& values)
+        {
+            write_u64(out, values.size());
+            for (auto&& value : values)
+            {
+                write_string(out, value);
+            }
+        }
+
+        static void write_dependencies(std::string& out, const std::vector<Dependency>& dependencies)
+        {
+            write_u64(out, dependencies.size());
+            for (auto&& dependency : dependencies)
+            {
+                write_string(out, dependency.depend.name);
+                write_strings(out, dependency.depend.features);
+                write_string(out, dependency.qualifier);
+            }
+        }
+
+        static void write_control_file(std::string& out, const SourceControlFile& scf)
+        {
+            const SourceParagraph& core = *scf.core_paragraph;
+            write_string(out, core.name);
+            write_string(out, core.version);
+            write_string(out, core.description);
+            write_string(out, core.maintainer);
+            write_strings(out, core.supports);
+            write_dependencies(out, core.depends);
+            write_strings(out, core.default_features);
+
+            write_u64(out, scf.feature_paragraphs.size());
+            for (auto&& feature : scf.feature_paragraphs)
+            {
+                write_string(out, feature->name);
+                write_string(out, feature->description);
+                write_dependencies(out, feature->depends);
+            }
+        }
+
+        struct Reader
+        {
+            explicit Reader(const std::string& data) : data(data) {}
+
+            uint64_t read_u64()
+            {
+                if (data.size() - pos < 8)
+                {
+                    ok = false;
+                    return 0;
+                }
+                uint64_t value = 0;
+                for (int i = 0; i < 8; ++i)
+                {
+                    value |= uint64_t(static_cast<unsigned char>(data[pos + i])) << (8 * i);
+                }
+                pos += 8;
+                return value;
+            }
+
+            std::string read_string()
+            {
+                const auto size = read_u64();
+                if (!ok || data.size() - pos < size)
+                {
+                    ok = false;
+                    return std::string();
+                }
+                std::string value = data.substr(pos, static_cast<size_t>(size));
+                pos += static_cast<size_t>(size);
+                return value;
+            }
+
+            std::vector<std::string> read_strings()
+            {
+                std::vector<std::string> values;
+                for (auto count = read_u64(); ok && count != 0; --count)
+                {
+                    values.push_back(read_string());
+                }
+                return values;
+            }
+
+            std::vector<Dependency> read_dependencies()
+            {
+                std::vector<Dependency> dependencies;
+                for (auto count = read_u64(); ok && count != 0; --count)
+                {
+                    Dependency dependency;
+                    dependency.depend.name = read_string();
+                    dependency.depend.features = read_strings();
+                    dependency.qualifier = read_string();
+                    dependencies.push_back(std::move(dependency));
+                }
+                return dependencies;
+            }
+
+            std::unique_ptr<SourceControlFile> read_control_file()
+            {
+                auto scf = std::make_unique<SourceControlFile>();
+                scf->core_paragraph = std::make_unique<SourceParagraph>();
+                SourceParagraph& core = *scf->core_paragraph;
+                core.name = read_string();
+                core.version = read_string();
+                core.description = read_string();
+                core.maintainer = read_string();
+                core.supports = read_strings();
+                core.depends = read_dependencies();
+                core.default_features = read_strings();
+
+                for (auto count = read_u64(); ok && count != 0; --count)
+                {
+                    auto feature = std::make_unique<FeatureParagraph>();
+                    feature->name = read_string();
+                    feature->description = read_string();
+                    feature->depends = read_dependencies();
+                    scf->feature_paragraphs.push_back(std::move(feature));
+                }
+                return scf;
+            }
+
+            const std::string& data;
+            size_t pos = 0;
+            bool ok = true;
+        };
+
+        static Snapshot load(const Files::Filesystem& fs, const fs::path& snapshot_file, const fs::path& ports_dir)
+        {
+            Snapshot snapshot;
+            auto maybe_data = fs.read_contents(snapshot_file);
+            const auto data = maybe_data.get();
+            if (!data || data->compare(0, MAGIC.size(), MAGIC.c_str()) != 0) return snapshot;
+            snapshot.data = std::move(*data);
+
+            Reader reader(snapshot.data);
+            reader.pos = MAGIC.size();
+            if (reader.read_string() != ports_dir.generic_u8string()) return {};
+
+            for (auto entry_count = reader.read_u64(); reader.ok && entry_count != 0; --entry_count)
+            {
+                std::string port_name = reader.read_string();
+                Entry entry;
+                entry.offset = reader.pos;
+                entry.control_stamp.size = reader.read_u64();
+                entry.control_stamp.mtime = static_cast<int64_t>(reader.read_u64());
+                entry.scf = reader.read_control_file();
+                entry.length = reader.pos - entry.offset;
+                snapshot.entries.emplace(std::move(port_name), std::move(entry));
+            }
+
+            if (!reader.ok || reader.pos != snapshot.data.size()) return {};
+            return snapshot;
+        }
+
+        static std::string serialize_entry(const FileStamp& control_stamp, const SourceControlFile& scf)
+        {
+            std::string out;
+            write_u64(out, control_stamp.size);
+            write_u64(out, static_cast<uint64_t>(control_stamp.mtime));
+            write_control_file(out, scf);
+            return out;
+        }
+
+        struct Update
+        {
+            Snapshot& cached;
+            std::mutex mutex;
+            // The serialized entries of ports that were parsed again.
+            std::map<std::string, std::string> parsed;
+        };
+
+        /// <summary>
+        /// Rewrites the snapshot if a port was parsed again or removed. Reused entries are copied over as they are.
+        /// </summary>
+        static void store(Files::Filesystem& fs,
+                          const fs::path& snapshot_file,
+                          const fs::path& ports_dir,
+                          Update& update)
+        {
+            const auto& entries = update.cached.entries;
+            const auto reused_count =
+                std::count_if(entries.begin(), entries.end(), [](auto&& entry) { return entry.second.reused; });
+            if (update.parsed.empty() && static_cast<size_t>(reused_count) == entries.size()) return;
+
+            std::map<std::string, StringRange> serialized_entries;
+            for (auto&& entry : entries)
+            {
+                if (!entry.second.reused) continue;
+                const auto begin = update.cached.data.cbegin() + entry.second.offset;
+                serialized_entries.emplace(entry.first, StringRange(begin, begin + entry.second.length));
+            }
+            for (auto&& entry : update.parsed)
+            {
+                serialized_entries.emplace(entry.first, StringRange(entry.second));
+            }
+
+            std::string out = MAGIC;
+            write_string(out, ports_dir.generic_u8string());
+            write_u64(out, serialized_entries.size());
+            for (auto&& entry : serialized_entries)
+            {
+                write_string(out, entry.first);
+                out.append(entry.second.begin, entry.second.end);
+            }
+
+            // The snapshot is only a cache; failing to write it is not an error.
+            std::error_code ec;
+            const fs::path tmp_file = Files::unique_temporary_path(snapshot_file);
+            fs.create_directories(snapshot_file.parent_path(), ec);
+            fs.write_contents(tmp_file, out, ec);
+            if (!ec) fs.rename(tmp_file, snapshot_file, ec);
+            if (ec) fs.remove(tmp_file, ec);
+        }
+
+        static ParseExpected<SourceControlFile> load_port(const Files::Filesystem& fs,
+                                                         const fs::path& path,
+                                                         Update* update)
+        {
+            const fs::path control_file = path / "CONTROL";
+            auto maybe_stamp = stat_file(control_file);
+            const auto stamp = maybe_stamp.get();
+            if (!stamp) return try_load_port(fs, path);
+
+            std::string port_name = path.filename().u8string();
+            const auto it = update->cached.entries.find(port_name);
+            if (it != update->cached.entries.end() && it->second.control_stamp == *stamp)
+            {
+                // Each port directory is loaded by one thread only, so its entry can be taken without the lock.
+                it->second.reused = true;
+                std::unique_ptr<SourceControlFile> scf = std::move(it->second.scf);
+                remove_features_unless_enabled(*scf);
+                return std::move(scf);
+            }
+
+            const Trace::Span span("load port", path.filename().u8string());
+            std::string text;
+            auto pghs = get_paragraph_views(fs, control_file, text);
+            auto p = pghs.get();
+            if (!p) return parse_port(path, pghs);
+
+            auto csf = SourceControlFile::parse_control_file(*p);
+            if (auto scf = csf.get())
+            {
+                std::string serialized = serialize_entry(*stamp, **scf);
+                std::lock_guard<std::mutex> lock(update->mutex);
+                update->parsed.emplace(std::move(port_name), std::move(serialized));
+                remove_features_unless_enabled(**scf);
+            }
+            return csf;
+        }
+    }
+
+    static LoadResults try_load_all_ports(const Files::Filesystem& fs,
+                                          const fs::path& ports_dir,
+                                          PortsSnapshot::Update* snapshot)
+    {
+        const Trace::Span span("load ports");
         LoadResults ret;
         auto port_dirs = fs.get_files_non_recursive(ports_dir);
         Util::sort(port_dirs);
         Util::erase_remove_if(port_dirs, [&](auto&& port_dir_entry) {
-            return fs.is_regular_file(port_dir_entry) && port_dir_entry.filename() == ".DS_Store";
+            return port_dir_entry.filename() == ".DS_Store" && fs.is_regular_file(port_dir_entry);
+        });
+
+        // Loading is dominated by file system latency, so read and parse the ports concurrently and then collect the
+        // results in directory order.
+        std::vector<Optional<ParseExpected<SourceControlFile>>> loaded(port_dirs.size());
+        Util::parallel_for_each_n(port_dirs.size(), [&](const size_t i) {
+            const fs::path& path = port_dirs[i];
+            loaded[i] = snapshot ? PortsSnapshot::load_port(fs, path, snapshot) : try_load_port(fs, path);
         });
 
-        for (auto&& path : port_dirs)
+        for (auto&& maybe_loaded : loaded)
         {
-            auto maybe_spgh = try_load_port(fs, path);
+            auto maybe_spgh = std::move(maybe_loaded).value_or_exit(VCPKG_LINE_INFO);
             if (const auto spgh = maybe_spgh.get())
             {
                 ret.paragraphs.emplace_back(std::move(*spgh));
@@ -272,10 +647,24 @@ namespace vcpkg::Paragraphs
         return ret;
     }
 
-    std::vector<std::unique_ptr<SourceControlFile>> load_all_ports(const Files::Filesystem& fs,
-                                                                   const fs::path& ports_dir)
+    LoadResults try_load_all_ports(const Files::Filesystem& fs, const fs::path& ports_dir)
+    {
+        return try_load_all_ports(fs, ports_dir, nullptr);
+    }
+
+    LoadResults try_load_all_ports(const VcpkgPaths& paths)
+    {
+        auto& fs = paths.get_filesystem();
+        PortsSnapshot::Snapshot cached = PortsSnapshot::load(fs, paths.ports_snapshot_file, paths.ports);
+        PortsSnapshot::Update snapshot{cached};
+
+        auto ret = try_load_all_ports(fs, paths.ports, &snapshot);
+        PortsSnapshot::store(fs, paths.ports_snapshot_file, paths.ports, snapshot);
+        return ret;
+    }
+
+    static std::vector<std::unique_ptr<SourceControlFile>> warn_on_errors(LoadResults&& results)
     {
-        auto results = try_load_all_ports(fs, ports_dir);
         if (!results.errors.empty())
         {
             if (GlobalState::debugging)
@@ -295,4 +684,15 @@ namespace vcpkg::Paragraphs
         }
         return std::move(results.paragraphs);
     }
+
+    std::vector<std::unique_ptr<SourceControlFile>> load_all_ports(const Files::Filesystem& fs,
+                                                                   const fs::path& ports_dir)
+    {
+        return warn_on_errors(try_load_all_ports(fs, ports_dir));
+    }
+
+    std::vector<std::unique_ptr<SourceControlFile>> load_all_ports(const VcpkgPaths& paths)
+    {
+        return warn_on_errors(try_load_all_ports(paths));
+    }
 }
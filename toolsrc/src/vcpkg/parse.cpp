@@ -6,18 +6,38 @@
 
 namespace vcpkg::Parse
 {
-    static Optional<std::string> remove_field(std::unordered_map<std::string, std::string>* fields,
-                                              const std::string& fieldname)
+    ParagraphView to_paragraph_view(const RawParagraph& fields)
     {
-        auto it = fields->find(fieldname);
+        ParagraphView view;
+        view.reserve(fields.size());
+        for (auto&& field : fields)
+        {
+            view.emplace_back(field.first, field.second);
+        }
+        return view;
+    }
+
+    RawParagraph to_raw_paragraph(const ParagraphView& fields)
+    {
+        RawParagraph pgh;
+        for (auto&& field : fields)
+        {
+            pgh.emplace(std::string(field.first), std::string(field.second));
+        }
+        return pgh;
+    }
+
+    static Optional<std::string> remove_field(ParagraphView* fields, const std::string& fieldname)
+    {
+        auto it = Util::find_if(*fields, [&](auto&& field) { return field.first == fieldname; });
         if (it == fields->end())
         {
             return nullopt;
         }
 
-        const std::string value = std::move(it->second);
+        std::string value(it->second);
         fields->erase(it);
-        return value;
+        return std::move(value);
     }
 
     void ParagraphParser::required_field(const std::string& fieldname, std::string& out)
@@ -28,9 +48,11 @@ namespace vcpkg::Parse
         else
             missing_fields.push_back(fieldname);
     }
-    std::string ParagraphParser::optional_field(const std::string& fieldname) const
+    std::string ParagraphParser::optional_field(const std::string& fieldname)
     {
-        return remove_field(&fields, fieldname).value_or("");
+        auto maybe_field = remove_field(&fields, fieldname);
+        if (const auto field = maybe_field.get()) return std::move(*field);
+        return std::string();
     }
     std::unique_ptr<ParseControlErrorInfo> ParagraphParser::error_info(const std::string& name) const
     {
@@ -38,7 +60,7 @@ namespace vcpkg::Parse
         {
             auto err = std::make_unique<ParseControlErrorInfo>();
             err->name = name;
-            err->extra_fields = Util::extract_keys(fields);
+            err->extra_fields = Util::fmap(fields, [](auto&& field) { return std::string(field.first); });
             err->missing_fields = std::move(missing_fields);
             return err;
         }
@@ -3,6 +3,7 @@
 #include <vcpkg/base/cofffilereader.h>
 #include <vcpkg/base/files.h>
 #include <vcpkg/base/system.h>
+#include <vcpkg/base/trace.h>
 #include <vcpkg/base/util.h>
 #include <vcpkg/build.h>
 #include <vcpkg/packagespec.h>
@@ -852,6 +853,7 @@ namespace vcpkg::PostBuildLint
                               const PreBuildInfo& pre_build_info,
                               const BuildInfo& build_info)
     {
+        const Trace::Span span("post-build lint", spec.to_string());
         System::println("-- Performing post-build validation");
         const size_t error_count = perform_all_checks_and_return_error_count(spec, paths, pre_build_info, build_info);
 
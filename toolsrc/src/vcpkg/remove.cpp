@@ -113,6 +113,8 @@ namespace vcpkg::Remove
             fs.remove(paths.listfile_path(ipv.core->package));
         }
 
+        status_db->installed_file_index().remove_package(spec);
+
         for (auto&& spgh : spghs)
         {
             spgh.state = InstallState::NOT_INSTALLED;
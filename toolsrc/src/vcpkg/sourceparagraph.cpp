@@ -86,7 +86,7 @@ namespace vcpkg
         }
     }
 
-    static ParseExpected<SourceParagraph> parse_source_paragraph(RawParagraph&& fields)
+    static ParseExpected<SourceParagraph> parse_source_paragraph(ParagraphView fields)
     {
         ParagraphParser parser(std::move(fields));
 
@@ -109,7 +109,7 @@ namespace vcpkg
             return std::move(spgh);
     }
 
-    static ParseExpected<FeatureParagraph> parse_feature_paragraph(RawParagraph&& fields)
+    static ParseExpected<FeatureParagraph> parse_feature_paragraph(ParagraphView fields)
     {
         ParagraphParser parser(std::move(fields));
 
@@ -130,6 +130,12 @@ namespace vcpkg
 
     ParseExpected<SourceControlFile> SourceControlFile::parse_control_file(
         std::vector<std::unordered_map<std::string, std::string>>&& control_paragraphs)
+    {
+        return parse_control_file(Util::fmap(control_paragraphs, [](auto&& p) { return to_paragraph_view(p); }));
+    }
+
+    ParseExpected<SourceControlFile> SourceControlFile::parse_control_file(
+        const std::vector<ParagraphView>& control_paragraphs)
     {
         if (control_paragraphs.size() == 0)
         {
@@ -138,17 +144,15 @@ namespace vcpkg
 
         auto control_file = std::make_unique<SourceControlFile>();
 
-        auto maybe_source = parse_source_paragraph(std::move(control_paragraphs.front()));
+        auto maybe_source = parse_source_paragraph(control_paragraphs.front());
         if (const auto source = maybe_source.get())
             control_file->core_paragraph = std::move(*source);
         else
             return std::move(maybe_source).error();
 
-        control_paragraphs.erase(control_paragraphs.begin());
-
-        for (auto&& feature_pgh : control_paragraphs)
+        for (auto it = control_paragraphs.begin() + 1; it != control_paragraphs.end(); ++it)
         {
-            auto maybe_feature = parse_feature_paragraph(std::move(feature_pgh));
+            auto maybe_feature = parse_feature_paragraph(*it);
             if (const auto feature = maybe_feature.get())
                 control_file->feature_paragraphs.emplace_back(std::move(*feature));
             else
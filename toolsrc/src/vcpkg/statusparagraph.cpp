@@ -25,11 +25,16 @@ namespace vcpkg
     }
 
     StatusParagraph::StatusParagraph(std::unordered_map<std::string, std::string>&& fields)
-        : want(Want::ERROR_STATE), state(InstallState::ERROR_STATE)
+        : StatusParagraph(to_paragraph_view(fields))
     {
-        auto status_it = fields.find(BinaryParagraphRequiredField::STATUS);
+    }
+
+    StatusParagraph::StatusParagraph(ParagraphView fields) : want(Want::ERROR_STATE), state(InstallState::ERROR_STATE)
+    {
+        auto status_it =
+            Util::find_if(fields, [](auto&& field) { return field.first == BinaryParagraphRequiredField::STATUS; });
         Checks::check_exit(VCPKG_LINE_INFO, status_it != fields.end(), "Expected 'Status' field in status paragraph");
-        std::string status_field = std::move(status_it->second);
+        const std::string status_field(status_it->second);
         fields.erase(status_it);
 
         this->package = BinaryParagraph(std::move(fields));
@@ -7,42 +7,91 @@ namespace vcpkg
 {
     StatusParagraphs::StatusParagraphs() = default;
 
-    StatusParagraphs::StatusParagraphs(std::vector<std::unique_ptr<StatusParagraph>>&& ps)
-        : paragraphs(std::move(ps)){};
+    StatusParagraphs::StatusParagraphs(std::vector<std::unique_ptr<StatusParagraph>>&& ps) : paragraphs(std::move(ps))
+    {
+        for (size_t i = 0; i < paragraphs.size(); ++i)
+        {
+            index_paragraph(i);
+        }
+    }
+
+    size_t StatusParagraphs::IndexKeyHash::operator()(const IndexKey& key) const
+    {
+        size_t hash = 17;
+        hash = hash * 31 + std::hash<std::string>()(key.name);
+        hash = hash * 31 + std::hash<Triplet>()(key.triplet);
+        return hash;
+    }
+
+    void StatusParagraphs::index_paragraph(const size_t position)
+    {
+        const PackageSpec& spec = paragraphs[position]->package.spec;
+        index[IndexKey{spec.name(), spec.triplet()}].push_back(position);
+    }
+
+    const std::vector<size_t>* StatusParagraphs::find_positions(const std::string& name, const Triplet& triplet) const
+    {
+        const auto it = index.find(IndexKey{name, triplet});
+        return it == index.end() ? nullptr : &it->second;
+    }
+
+    Optional<size_t> StatusParagraphs::find_position(const std::string& name,
+                                                     const Triplet& triplet,
+                                                     const std::string& feature) const
+    {
+        if (feature == "core")
+        {
+            // The core feature maps to .feature == ""
+            return find_position(name, triplet, "");
+        }
+
+        const auto positions = find_positions(name, triplet);
+        if (positions == nullptr) return nullopt;
+
+        // Later paragraphs shadow earlier ones, matching reverse iteration order.
+        for (auto it = positions->rbegin(); it != positions->rend(); ++it)
+        {
+            if (paragraphs[*it]->package.feature == feature) return *it;
+        }
+        return nullopt;
+    }
 
     std::vector<std::unique_ptr<StatusParagraph>*> StatusParagraphs::find_all(const std::string& name,
                                                                               const Triplet& triplet)
     {
         std::vector<std::unique_ptr<StatusParagraph>*> spghs;
-        for (auto&& p : *this)
+        const auto positions = find_positions(name, triplet);
+        if (positions == nullptr) return spghs;
+
+        for (auto it = positions->rbegin(); it != positions->rend(); ++it)
         {
-            if (p->package.spec.name() == name && p->package.spec.triplet() == triplet)
-            {
-                if (p->package.feature.empty())
-                    spghs.emplace(spghs.begin(), &p);
-                else
-                    spghs.emplace_back(&p);
-            }
+            auto& p = paragraphs[*it];
+            if (p->package.feature.empty())
+                spghs.emplace(spghs.begin(), &p);
+            else
+                spghs.emplace_back(&p);
         }
         return spghs;
     }
 
     Optional<InstalledPackageView> StatusParagraphs::find_all_installed(const PackageSpec& spec) const
     {
+        const auto positions = find_positions(spec.name(), spec.triplet());
+        if (positions == nullptr) return nullopt;
+
         InstalledPackageView ipv;
-        for (auto&& p : *this)
+        for (auto it = positions->rbegin(); it != positions->rend(); ++it)
         {
-            if (p->package.spec.name() == spec.name() && p->package.spec.triplet() == spec.triplet() &&
-                p->is_installed())
+            auto& p = paragraphs[*it];
+            if (!p->is_installed()) continue;
+
+            if (p->package.feature.empty())
             {
-                if (p->package.feature.empty())
-                {
-                    Checks::check_exit(VCPKG_LINE_INFO, ipv.core == nullptr);
-                    ipv.core = p.get();
-                }
-                else
-                    ipv.features.emplace_back(p.get());
+                Checks::check_exit(VCPKG_LINE_INFO, ipv.core == nullptr);
+                ipv.core = p.get();
             }
+            else
+                ipv.features.emplace_back(p.get());
         }
         if (ipv.core != nullptr)
             return std::move(ipv);
@@ -54,30 +103,18 @@ namespace vcpkg
                                                       const Triplet& triplet,
                                                       const std::string& feature)
     {
-        if (feature == "core")
-        {
-            // The core feature maps to .feature == ""
-            return find(name, triplet, "");
-        }
-        return std::find_if(begin(), end(), [&](const std::unique_ptr<StatusParagraph>& pgh) {
-            const PackageSpec& spec = pgh->package.spec;
-            return spec.name() == name && spec.triplet() == triplet && pgh->package.feature == feature;
-        });
+        const auto position = find_position(name, triplet, feature);
+        if (const auto p = position.get()) return iterator(paragraphs.begin() + *p + 1);
+        return end();
     }
 
     StatusParagraphs::const_iterator StatusParagraphs::find(const std::string& name,
                                                             const Triplet& triplet,
                                                             const std::string& feature) const
     {
-        if (feature == "core")
-        {
-            // The core feature maps to .feature == ""
-            return find(name, triplet, "");
-        }
-        return std::find_if(begin(), end(), [&](const std::unique_ptr<StatusParagraph>& pgh) {
-            const PackageSpec& spec = pgh->package.spec;
-            return spec.name() == name && spec.triplet() == triplet && pgh->package.feature == feature;
-        });
+        const auto position = find_position(name, triplet, feature);
+        if (const auto p = position.get()) return const_iterator(paragraphs.cbegin() + *p + 1);
+        return end();
     }
 
     StatusParagraphs::const_iterator StatusParagraphs::find_installed(const PackageSpec& spec) const
@@ -126,6 +163,7 @@ namespace vcpkg
         if (ptr == end())
         {
             paragraphs.push_back(std::move(pgh));
+            index_paragraph(paragraphs.size() - 1);
             return paragraphs.rbegin();
         }
 
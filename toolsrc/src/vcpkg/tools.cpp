@@ -484,11 +484,14 @@ namespace vcpkg
 
     struct ToolCacheImpl final : ToolCache
     {
+        // Tools may be requested concurrently by parallel builds; acquisition happens at most once per tool.
+        mutable std::recursive_mutex mutex;
         vcpkg::Cache<std::string, fs::path> path_only_cache;
         vcpkg::Cache<std::string, PathAndVersion> path_version_cache;
 
         virtual const fs::path& get_tool_path(const VcpkgPaths& paths, const std::string& tool) const override
         {
+            std::lock_guard<std::recursive_mutex> lock(mutex);
             return path_only_cache.get_lazy(tool, [&]() {
                 // First deal with specially handled tools.
                 // For these we may look in locations like Program Files, the PATH etc as well as the auto-downloaded
@@ -514,6 +517,7 @@ namespace vcpkg
 
         const PathAndVersion& get_tool_pathversion(const VcpkgPaths& paths, const std::string& tool) const
         {
+            std::lock_guard<std::recursive_mutex> lock(mutex);
             return path_version_cache.get_lazy(tool, [&]() {
                 if (tool == Tools::CMAKE) return CMake::get_path(paths);
                 if (tool == Tools::GIT) return Git::get_path(paths);
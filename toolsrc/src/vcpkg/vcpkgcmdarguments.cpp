@@ -142,6 +142,11 @@ namespace vcpkg
                     parse_switch(false, "printmetrics", args.printmetrics);
                     continue;
                 }
+                if (arg == "--x-stats")
+                {
+                    parse_switch(true, "x-stats", args.stats);
+                    continue;
+                }
                 if (arg == "--featurepackages")
                 {
                     parse_switch(true, "featurepackages", args.featurepackages);
@@ -163,6 +168,13 @@ namespace vcpkg
                     continue;
                 }
 
+                if (Strings::case_insensitive_ascii_starts_with(arg, "--x-trace-file="))
+                {
+                    // Keep the path as given rather than lowercased
+                    args.trace_file = std::make_unique<std::string>(arg_begin->substr(arg.find('=') + 1));
+                    continue;
+                }
+
                 const auto eq_pos = arg.find('=');
                 if (eq_pos != std::string::npos)
                 {
@@ -1,5 +1,6 @@
 #include "pch.h"
 
+#include <vcpkg/base/compression.h>
 #include <vcpkg/base/files.h>
 #include <vcpkg/base/strings.h>
 #include <vcpkg/base/util.h>
@@ -24,9 +25,11 @@ namespace vcpkg
             fs.rename(vcpkg_dir_status_file_old, vcpkg_dir_status_file);
         }
 
-        auto pghs = Paragraphs::get_paragraphs(fs, vcpkg_dir_status_file).value_or_exit(VCPKG_LINE_INFO);
+        std::string text;
+        auto pghs = Paragraphs::get_paragraph_views(fs, vcpkg_dir_status_file, text).value_or_exit(VCPKG_LINE_INFO);
 
         std::vector<std::unique_ptr<StatusParagraph>> status_pghs;
+        status_pghs.reserve(pghs.size());
         for (auto&& p : pghs)
         {
             status_pghs.push_back(std::make_unique<StatusParagraph>(std::move(p)));
@@ -35,6 +38,49 @@ namespace vcpkg
         return StatusParagraphs(std::move(status_pghs));
     }
 
+    // The status journal is a sequence of records, each a header line "<payload size> <payload crc32>\n" followed by
+    // the payload: one serialized status paragraph. A record that is cut short or fails its checksum can only be the
+    // tail of an interrupted append, so replay stops there.
+    static constexpr std::uintmax_t JOURNAL_COMPACTION_THRESHOLD = 1024 * 1024;
+
+    static std::string make_journal_record(const std::string& payload)
+    {
+        const auto crc = Compression::crc32(0, reinterpret_cast<const unsigned char*>(payload.data()), payload.size());
+        return Strings::format("%zu %08x\n", payload.size(), crc) + payload;
+    }
+
+    // Returns false if the journal ends with a damaged record.
+    static bool replay_journal(const std::string& journal, StatusParagraphs* status_db)
+    {
+        size_t pos = 0;
+        while (pos < journal.size())
+        {
+            const auto eol = journal.find('\n', pos);
+            if (eol == std::string::npos) return false;
+
+            const char* const header = journal.c_str() + pos;
+            char* size_end;
+            const auto size = static_cast<size_t>(strtoull(header, &size_end, 10));
+            char* crc_end;
+            const auto crc = static_cast<uint32_t>(strtoul(size_end, &crc_end, 16));
+            if (size_end == header || crc_end == size_end || crc_end != journal.c_str() + eol) return false;
+
+            const size_t payload_begin = eol + 1;
+            if (journal.size() - payload_begin < size) return false;
+
+            const auto payload = reinterpret_cast<const unsigned char*>(journal.data()) + payload_begin;
+            if (Compression::crc32(0, payload, size) != crc) return false;
+
+            std::string text = journal.substr(payload_begin, size);
+            for (auto&& p : Paragraphs::parse_paragraph_views(text))
+            {
+                status_db->insert(std::make_unique<StatusParagraph>(std::move(p)));
+            }
+            pos = payload_begin + size;
+        }
+        return true;
+    }
+
     StatusParagraphs database_load_check(const VcpkgPaths& paths)
     {
         auto& fs = paths.get_filesystem();
@@ -45,37 +91,53 @@ namespace vcpkg
         fs.create_directory(paths.installed, ec);
         fs.create_directory(paths.vcpkg_dir, ec);
         fs.create_directory(paths.vcpkg_dir_info, ec);
-        fs.create_directory(updates_dir, ec);
 
         const fs::path& status_file = paths.vcpkg_dir_status_file;
         const fs::path status_file_old = status_file.parent_path() / "status-old";
         const fs::path status_file_new = status_file.parent_path() / "status-new";
+        const fs::path& journal_file = paths.vcpkg_dir_status_journal;
 
         StatusParagraphs current_status_db = load_current_database(fs, status_file, status_file_old);
 
-        auto update_files = fs.get_files_non_recursive(updates_dir);
-        Util::sort(update_files);
-        if (update_files.empty())
+        bool needs_compaction = false;
+        if (fs.exists(journal_file))
         {
-            // updates directory is empty, control file is up-to-date.
-            return current_status_db;
+            const std::string journal = fs.read_contents(journal_file).value_or_exit(VCPKG_LINE_INFO);
+
+            // A damaged tail must be dropped before anything else is appended after it.
+            const bool journal_intact = replay_journal(journal, &current_status_db);
+            needs_compaction = !journal_intact || journal.size() > JOURNAL_COMPACTION_THRESHOLD;
         }
+
+        // Older versions of vcpkg wrote one file per update to the updates directory.
+        std::vector<fs::path> update_files;
+        if (fs.exists(updates_dir)) update_files = fs.get_files_non_recursive(updates_dir);
+        Util::sort(update_files);
         for (auto&& file : update_files)
         {
             if (!fs.is_regular_file(file)) continue;
             if (file.filename() == "incomplete") continue;
 
-            auto pghs = Paragraphs::get_paragraphs(fs, file).value_or_exit(VCPKG_LINE_INFO);
+            std::string text;
+            auto pghs = Paragraphs::get_paragraph_views(fs, file, text).value_or_exit(VCPKG_LINE_INFO);
             for (auto&& p : pghs)
             {
                 current_status_db.insert(std::make_unique<StatusParagraph>(std::move(p)));
             }
         }
 
+        if (!needs_compaction && update_files.empty())
+        {
+            // the journal is small enough to replay, control file is up-to-date.
+            return current_status_db;
+        }
+
         fs.write_contents(status_file_new, Strings::serialize(current_status_db));
 
         fs.rename(status_file_new, status_file);
 
+        // Replaying a journal over the status file it was compacted into is harmless, so a crash here is safe.
+        fs.remove(journal_file, ec);
         for (auto&& file : update_files)
         {
             if (!fs.is_regular_file(file)) continue;
@@ -88,15 +150,8 @@ namespace vcpkg
 
     void write_update(const VcpkgPaths& paths, const StatusParagraph& p)
     {
-        static int update_id = 0;
-        auto& fs = paths.get_filesystem();
-
-        const auto my_update_id = update_id++;
-        const auto tmp_update_filename = paths.vcpkg_dir_updates / "incomplete";
-        const auto update_filename = paths.vcpkg_dir_updates / Strings::format("%010d", my_update_id);
-
-        fs.write_contents(tmp_update_filename, Strings::serialize(p));
-        fs.rename(tmp_update_filename, update_filename);
+        paths.get_filesystem().append_contents(paths.vcpkg_dir_status_journal,
+                                               make_journal_record(Strings::serialize(p)));
     }
 
     static void upgrade_to_slash_terminated_sorted_format(Files::Filesystem& fs,
@@ -197,11 +252,24 @@ namespace vcpkg
         return Util::fmap(ipv_map, [](auto&& p) -> InstalledPackageView { return std::move(p.second); });
     }
 
-    std::vector<StatusParagraphAndAssociatedFiles> get_installed_files(const VcpkgPaths& paths,
-                                                                       const StatusParagraphs& status_db)
+    std::vector<std::string> read_installed_files_of(const VcpkgPaths& paths, const StatusParagraph& pgh)
     {
         auto& fs = paths.get_filesystem();
 
+        const fs::path listfile_path = paths.listfile_path(pgh.package);
+        std::vector<std::string> installed_files = fs.read_lines(listfile_path).value_or_exit(VCPKG_LINE_INFO);
+        Strings::trim_all_and_remove_whitespace_strings(&installed_files);
+        upgrade_to_slash_terminated_sorted_format(fs, &installed_files, listfile_path);
+
+        // Remove the directories
+        Util::erase_remove_if(installed_files, [](const std::string& file) { return file.back() == '/'; });
+
+        return installed_files;
+    }
+
+    std::vector<StatusParagraphAndAssociatedFiles> get_installed_files(const VcpkgPaths& paths,
+                                                                       const StatusParagraphs& status_db)
+    {
         std::vector<StatusParagraphAndAssociatedFiles> installed_files;
 
         for (const std::unique_ptr<StatusParagraph>& pgh : status_db)
@@ -211,24 +279,56 @@ namespace vcpkg
                 continue;
             }
 
-            const fs::path listfile_path = paths.listfile_path(pgh->package);
-            std::vector<std::string> installed_files_of_current_pgh =
-                fs.read_lines(listfile_path).value_or_exit(VCPKG_LINE_INFO);
-            Strings::trim_all_and_remove_whitespace_strings(&installed_files_of_current_pgh);
-            upgrade_to_slash_terminated_sorted_format(fs, &installed_files_of_current_pgh, listfile_path);
-
-            // Remove the directories
-            Util::erase_remove_if(installed_files_of_current_pgh,
-                                  [](const std::string& file) { return file.back() == '/'; });
-
             StatusParagraphAndAssociatedFiles pgh_and_files = {
-                *pgh, SortedVector<std::string>(std::move(installed_files_of_current_pgh))};
+                *pgh, SortedVector<std::string>(read_installed_files_of(paths, *pgh))};
             installed_files.push_back(std::move(pgh_and_files));
         }
 
         return installed_files;
     }
 
+    void InstalledFileIndex::ensure_loaded(const VcpkgPaths& paths, const StatusParagraphs& status_db)
+    {
+        if (m_loaded) return;
+
+        for (const std::unique_ptr<StatusParagraph>& pgh : status_db)
+        {
+            if (!pgh->is_installed() || !pgh->package.feature.empty()) continue;
+
+            add_package(pgh->package.spec, read_installed_files_of(paths, *pgh));
+        }
+        m_loaded = true;
+    }
+
+    const PackageSpec* InstalledFileIndex::find_owner(const std::string& file) const
+    {
+        const auto it = m_owners.find(file);
+        return it == m_owners.end() ? nullptr : &it->second;
+    }
+
+    void InstalledFileIndex::add_package(const PackageSpec& spec, std::vector<std::string>&& files)
+    {
+        remove_package(spec);
+        for (auto&& file : files)
+        {
+            m_owners.emplace(file, spec);
+        }
+        m_files.emplace(spec, std::move(files));
+    }
+
+    void InstalledFileIndex::remove_package(const PackageSpec& spec)
+    {
+        const auto it = m_files.find(spec);
+        if (it == m_files.end()) return;
+
+        for (auto&& file : it->second)
+        {
+            const auto owner = m_owners.find(file);
+            if (owner != m_owners.end() && owner->second == spec) m_owners.erase(owner);
+        }
+        m_files.erase(it);
+    }
+
     std::string shorten_text(const std::string& desc, const size_t length)
     {
         Checks::check_exit(VCPKG_LINE_INFO, length >= 3);
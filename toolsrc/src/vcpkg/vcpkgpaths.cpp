@@ -36,21 +36,26 @@ namespace vcpkg
         paths.buildtrees = paths.root / "buildtrees";
         paths.downloads = paths.root / "downloads";
         paths.ports = paths.root / "ports";
+        paths.ports_snapshot_file = paths.buildtrees / "ports.snapshot";
         paths.installed = paths.root / "installed";
         paths.triplets = paths.root / "triplets";
         paths.scripts = paths.root / "scripts";
 
         paths.tools = paths.downloads / "tools";
+        paths.file_hash_cache = paths.downloads / "file-hashes.txt";
         paths.buildsystems = paths.scripts / "buildsystems";
         paths.buildsystems_msbuild_targets = paths.buildsystems / "msbuild" / "vcpkg.targets";
 
         paths.vcpkg_dir = paths.installed / "vcpkg";
         paths.vcpkg_dir_status_file = paths.vcpkg_dir / "status";
+        paths.vcpkg_dir_status_journal = paths.vcpkg_dir / "status-journal";
         paths.vcpkg_dir_info = paths.vcpkg_dir / "info";
         paths.vcpkg_dir_updates = paths.vcpkg_dir / "updates";
 
         paths.ports_cmake = paths.scripts / "ports.cmake";
 
+        paths.m_tool_cache = get_tool_cache();
+
         return paths;
     }
 
@@ -93,12 +98,10 @@ namespace vcpkg
 
     const fs::path& VcpkgPaths::get_tool_exe(const std::string& tool) const
     {
-        if (!m_tool_cache) m_tool_cache = get_tool_cache();
         return m_tool_cache->get_tool_path(*this, tool);
     }
     const std::string& VcpkgPaths::get_tool_version(const std::string& tool) const
     {
-        if (!m_tool_cache) m_tool_cache = get_tool_cache();
         return m_tool_cache->get_tool_version(*this, tool);
     }
 